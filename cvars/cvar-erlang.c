@@ -8,11 +8,13 @@
  */
 
 #include <stdio.h>
+#include <math.h>
 #include "mtwist/mtwist.h"
 #include "mtwist/randistrs.h"
 #include "cvar.h"
 #include "cvar_trace.h"
 #include "cvar_tokens.h"
+#include "cvar_batch.h"
 #include "cvar-erlang.h"
 
 void *cvar_alloc_handle(const char *cvar_parameters,
@@ -98,6 +100,25 @@ int cvar_revalidate_handle(void *cvar_handle)
 	return 0;
 }
 
+void *cvar_clone_handle(void *cvar_handle, unsigned int stream,
+		void *(*cvar_malloc)(size_t size), void (*cvar_free)(void *cvar_ptr))
+{
+	handle_t *h = (handle_t *) cvar_handle;
+	handle_t *clone;
+
+	clone = (handle_t *) cvar_malloc(sizeof(handle_t));
+	if (!clone) {
+		cvar_log_error("Out of memory");
+		return NULL;
+	}
+
+	/* Same parameters, own Mersenne Twister stream. */
+	*clone = *h;
+	mts_seed32new(&clone->state, stream);
+
+	return clone;
+}
+
 int cvar_next_value(void *cvar_handle, double *value)
 {
 	handle_t *h = (handle_t *) cvar_handle;
@@ -117,6 +138,40 @@ int cvar_next_value(void *cvar_handle, double *value)
 	return 0;
 }
 
+int cvar_next_values(void *cvar_handle, double *values, int count)
+{
+	handle_t *h = (handle_t *) cvar_handle;
+	int shape, order;
+	int i;
+
+	if (!h) {
+		cvar_trace("NULL cvar_handle");
+		return -1;
+	}
+
+	if (!values || count < 0) {
+		cvar_trace("NULL values or negative count");
+		return -1;
+	}
+
+	shape = h->shape > 1 ? h->shape : 1;
+
+	fill_uniform(&h->state, values, count);
+	for (i = 0; i < count; i++)
+		values[i] = 1.0 - values[i];
+
+	/* Multiply in the remaining shape - 1 uniforms, all on (0, 1]. */
+	for (order = 1; order < shape; order++) {
+		for (i = 0; i < count; i++)
+			values[i] *= 1.0 - mts_drand(&h->state);
+	}
+
+	for (i = 0; i < count; i++)
+		values[i] = -h->rate * log(values[i]) / shape;
+
+	return 0;
+}
+
 void cvar_free_handle(void *handle, void (*cvar_free)(void *ptr))
 {
 	cvar_free(handle);
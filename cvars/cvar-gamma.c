@@ -29,6 +29,7 @@ typedef struct handle {
 	double mean;
 	double scaledmean;
 	double gamma;
+	unsigned short xi[3];	/* erand48() state */
 } handle_t;
 
 /******* Part from the original FB distribution ****************/
@@ -107,27 +108,13 @@ A1:
 }
 
 /*
- * fetch a uniformly distributed random number using the drand48 generator
+ * fetch a uniformly distributed random number using the erand48 generator
+ * with the state of a handle
  */
-/* ARGSUSED */
 static double
-default_src(unsigned short *xi)
+handle_src(unsigned short *xi)
 {
-	return (drand48());
-}
-
-/*
- * Sample the gamma distributed random variable with gamma 'a' and
- * result mulitplier 'b', which is usually mean/gamma. Uses the default
- * drand48 random number generator as input
- */
-static double
-gamma_dist_knuth(double a, double b)
-{
-	if (a <= 1.0)
-		return (b * gamma_dist_knuth_algG(a, default_src, NULL));
-	else
-		return (b * gamma_dist_knuth_algA(a, default_src, NULL));
+	return (erand48(xi));
 }
 
 /*
@@ -189,6 +176,11 @@ void *cvar_alloc_handle(const char *cvar_parameters,
 
 	handle.scaledmean = handle.mean / handle.gamma;
 
+	/* Start where an unseeded drand48() does. */
+	handle.xi[0] = 0x330e;
+	handle.xi[1] = 0xabcd;
+	handle.xi[2] = 0x1234;
+
 	cvar_trace("mean = %lf, gamma = %lf", handle.mean, handle.gamma);
 
 	t = unused_tokens(list_head);
@@ -221,6 +213,27 @@ int cvar_revalidate_handle(void *cvar_handle)
 	return 0;
 }
 
+void *cvar_clone_handle(void *cvar_handle, unsigned int stream,
+		void *(*cvar_malloc)(size_t size), void (*cvar_free)(void *cvar_ptr))
+{
+	handle_t *h = (handle_t *) cvar_handle;
+	handle_t *clone;
+
+	clone = (handle_t *) cvar_malloc(sizeof(handle_t));
+	if (!clone) {
+		cvar_log_error("Out of memory");
+		return NULL;
+	}
+
+	/* Same parameters, own erand48() stream. */
+	*clone = *h;
+	clone->xi[0] = 0x330e;
+	clone->xi[1] = stream & 0xffff;
+	clone->xi[2] = stream >> 16;
+
+	return clone;
+}
+
 int cvar_next_value(void *cvar_handle, double *value)
 {
 	handle_t *h = (handle_t *) cvar_handle;
@@ -235,7 +248,34 @@ int cvar_next_value(void *cvar_handle, double *value)
 		return -1;
 	}
 
-	*value = gamma_dist_knuth(h->gamma, h->scaledmean);
+	*value = gamma_dist_knuth_src(h->gamma, h->scaledmean, handle_src,
+			h->xi);
+
+	return 0;
+}
+
+/*
+ * The rejection methods of Knuth's algorithms draw a varying number of
+ * uniform numbers per sample, so values are generated one at a time.
+ */
+int cvar_next_values(void *cvar_handle, double *values, int count)
+{
+	handle_t *h = (handle_t *) cvar_handle;
+	int i;
+
+	if (!h) {
+		cvar_log_error("NULL cvar_handle");
+		return -1;
+	}
+
+	if (!values || count < 0) {
+		cvar_log_error("NULL values or negative count");
+		return -1;
+	}
+
+	for (i = 0; i < count; i++)
+		values[i] = gamma_dist_knuth_src(h->gamma, h->scaledmean,
+				handle_src, h->xi);
 
 	return 0;
 }
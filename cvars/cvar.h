@@ -50,6 +50,23 @@ void *cvar_alloc_handle(const char *cvar_parameters,
 
 int cvar_revalidate_handle(void *cvar_handle);
 
+/*
+ * Allocate a copy of a handle that generates values from its own random
+ * stream, so that a thread can use it without serializing with the users of
+ * the original handle. Copies with the same stream number must generate the
+ * same values, and copies with different stream numbers independent ones.
+ * Memory for the copy must be allocated using argument cvar_malloc only; the
+ * copy is destroyed with cvar_free_handle.
+ *
+ * Implementation: Optional. If it is missing, Filebench serializes all calls
+ * to cvar_next_value on a handle.
+ *
+ * Return a non NULL handle on success and a NULL handle on error.
+ */
+
+void *cvar_clone_handle(void *cvar_handle, unsigned int stream,
+		void *(*cvar_malloc)(size_t size), void (*cvar_free)(void *ptr));
+
 /*
  * Called every time a new value of the custom variable is required.
  *
@@ -61,6 +78,22 @@ int cvar_revalidate_handle(void *cvar_handle);
 
 int cvar_next_value(void *cvar_handle, double *value);
 
+/*
+ * Called to generate count values of the custom variable at once, which lets
+ * the library amortize the call and vectorize its transforms. The values need
+ * not be the ones count calls to cvar_next_value would return, but must
+ * follow the same distribution.
+ *
+ * Implementation: Optional. If it is missing, Filebench calls cvar_next_value
+ * once per value.
+ *
+ * Return 0 on success and non zero on error. On success, values[0] to
+ * values[count - 1] are initialized to the next values of the variable whose
+ * state is in handle.
+ */
+
+int cvar_next_values(void *cvar_handle, double *values, int count);
+
 /*
  * Called when an existing custom variable has to be destroyed. Use function
  * cvar_free to free up memory allocated for cvar_handle.
@@ -0,0 +1,44 @@
+/*
+ * cvar_batch.c
+ *
+ * Helpers for generating many samples at once in cvar_next_values.
+ */
+
+#include <math.h>
+#include "cvar_batch.h"
+
+#define TWO_PI	6.28318530717958647692
+
+void fill_uniform(mt_state *state, double *values, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		values[i] = mts_drand(state);
+}
+
+void fill_normal(mt_state *state, double *values, int count, double mean,
+		double sigma)
+{
+	double u[2];
+	double r, theta;
+	int half = count / 2;
+	int i;
+
+	/* values[i] holds the radius and values[half + i] the angle of pair i. */
+	fill_uniform(state, values, 2 * half);
+
+	for (i = 0; i < half; i++) {
+		r = sigma * sqrt(-2.0 * log(1.0 - values[i]));
+		theta = TWO_PI * values[half + i];
+		values[i] = mean + r * cos(theta);
+		values[half + i] = mean + r * sin(theta);
+	}
+
+	/* An odd count leaves one value over; its pair is dropped. */
+	if (count & 1) {
+		fill_uniform(state, u, 2);
+		values[count - 1] = mean + sigma * sqrt(-2.0 * log(1.0 - u[0])) *
+				cos(TWO_PI * u[1]);
+	}
+}
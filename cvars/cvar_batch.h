@@ -0,0 +1,32 @@
+/*
+ * cvar_batch.h
+ *
+ * Helpers for generating many samples at once in cvar_next_values.
+ *
+ * The helpers first fill the whole output array with uniform random numbers
+ * and then transform it in place with loops that have no branches or calls
+ * into the generator, so that the compiler can vectorize them (log, exp,
+ * sin and cos included, when a vector math library is available).
+ */
+
+#ifndef _CVAR_BATCH_H
+#define _CVAR_BATCH_H
+
+#include "mtwist/mtwist.h"
+
+/*
+ * Fill values[0..count) with uniform random numbers on [0, 1), exactly as
+ * count calls to mts_drand would.
+ */
+void fill_uniform(mt_state *state, double *values, int count);
+
+/*
+ * Fill values[0..count) with normally distributed random numbers of the given
+ * mean and standard deviation, using the Box-Muller transform. Unlike the
+ * polar method of rds_normal, Box-Muller never rejects a pair of uniform
+ * numbers, and both numbers of each pair it generates are used.
+ */
+void fill_normal(mt_state *state, double *values, int count, double mean,
+		double sigma);
+
+#endif /* _CVAR_BATCH_H */
@@ -10,20 +10,83 @@
 #include <stdlib.h>
 #include <dlfcn.h>
 #include <stdint.h>
+#include <time.h>
 #include <fb_cvar.h>
 
+/* Number of values generated per cvar_next_values call in the benchmark. */
+#define BENCH_BATCH	64
+
 char *pgmname;
 
 void print_usage()
 {
 	printf("Usage:   %s <library name> <parameter string> "
-			"<count>\n", pgmname);
+			"<count> [<benchmark count>]\n", pgmname);
 	printf("Example: %s librand-triangular.so.1 "
 			"'lower:1024;upper:4096;mode:4096'"
-			" 10\n", pgmname);
+			" 10 1000000\n", pgmname);
 	return;
 }
 
+double elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start->tv_sec) +
+		(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Time the generation of count values, first one cvar_next_value call at a
+ * time and then, if the library supports it, BENCH_BATCH values per
+ * cvar_next_values call. Return 0 on success, non-zero on error.
+ */
+int benchmark(cvar_operations_t *cvar_op, void *cvar_handle, long count)
+{
+	struct timespec start;
+	double values[BENCH_BATCH];
+	double sum = 0.0;
+	double secs;
+	long i;
+	int ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) {
+		ret = cvar_op->cvar_next_value(cvar_handle, values);
+		if (ret)
+			return ret;
+		sum += values[0];
+	}
+	secs = elapsed(&start);
+	printf("cvar_next_value:  %ld values in %.3lf s, %.0lf values/s\n",
+			count, secs, secs > 0 ? count / secs : 0);
+
+	if (!cvar_op->cvar_next_values) {
+		printf("cvar_next_values: not implemented\n");
+		goto out;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i += BENCH_BATCH) {
+		ret = cvar_op->cvar_next_values(cvar_handle, values, BENCH_BATCH);
+		if (ret)
+			return ret;
+		sum += values[0];
+	}
+	secs = elapsed(&start);
+	printf("cvar_next_values: %ld values in %.3lf s, %.0lf values/s\n",
+			i, secs, secs > 0 ? i / secs : 0);
+
+out:
+	/* Keep the compiler from dropping the values. */
+	if (sum == -1.0)
+		printf("%lf\n", sum);
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	void *cvar_lib;
@@ -78,6 +141,8 @@ int main(int argc, char *argv[])
 		goto dlclose;
 	}
 
+	cvar_op.cvar_next_values = dlsym(cvar_lib, FB_CVAR_NEXT_VALUES);
+
 	cvar_op.cvar_free_handle = dlsym(cvar_lib, FB_CVAR_FREE_HANDLE);
 	if (!cvar_op.cvar_free_handle) {
 		printf("Unable to find " FB_CVAR_FREE_HANDLE ": %s.\n", dlerror());
@@ -145,6 +210,16 @@ int main(int argc, char *argv[])
 		printf("%lf.\n", d);
 	}
 
+	if (argc > 4) {
+		printf("\n");
+		ret = benchmark(&cvar_op, cvar_handle, atol(argv[4]));
+		if (ret) {
+			printf("Benchmark failed. Error %d.\n", ret);
+			ret = -12;
+			goto cvar_free;
+		}
+	}
+
 	ret = 0;
 	printf("\nAll done.\n");
 
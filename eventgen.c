@@ -37,6 +37,10 @@
  * bandwidth per second limits can be set. Note, the generated events are
  * shared with all consumer flowops, of which their will be one for each
  * process / thread instance which has a consumer flowop defined in it.
+ *
+ * In per-thread mode there is no generator thread and no shared queue:
+ * each consumer flowop paces itself from the monotonic clock at an equal
+ * share of the rate, see flowoplib_event_pace().
  */
 
 #include <sys/time.h>
@@ -75,7 +79,8 @@ eventgen_thread(void)
 		hrtime_t delta;
 		int count, rate;
 
-		if (filebench_shm->shm_eventgen_hz == NULL) {
+		if ((filebench_shm->shm_eventgen_hz == NULL) ||
+		    filebench_shm->shm_eventgen_perthread) {
 			(void) sleep(1);
 			continue;
 		} else {
@@ -128,27 +133,34 @@ eventgen_thread(void)
 }
 
 /*
- * Creates a thread to run the event generator eventgen_thread routine.
+ * Creates a thread to run the event generator eventgen_thread routine,
+ * unless it is already running.
  */
-void
-eventgen_init(void)
+static void
+eventgen_start(void)
 {
+	static int started = 0;
 	pthread_t tid;
 
+	if (started)
+		return;
+
 	if (pthread_create(&tid, NULL,
 	    (void *(*)(void *))eventgen_thread, 0) != 0) {
 		filebench_log(LOG_ERROR, "create timer thread failed: %s",
 		    strerror(errno));
 		exit(1);
 	}
+	started = 1;
 }
 
 /*
  * Sets the event generator rate to that supplied by
- * var_t *rate.
+ * var_t *rate. In per-thread mode the consumer flowops pace
+ * themselves, so the generator thread is only started otherwise.
  */
 void
-eventgen_setrate(avd_t rate)
+eventgen_setrate(avd_t rate, boolean_t perthread)
 {
 	filebench_shm->shm_eventgen_hz = rate;
 	if (rate == NULL) {
@@ -156,6 +168,12 @@ eventgen_setrate(avd_t rate)
 		    "eventgen_setrate() called without a rate");
 		return;
 	}
+
+	filebench_shm->shm_eventgen_perthread = perthread;
+	if (perthread)
+		filebench_shm->shm_eventgen_enabled = TRUE;
+	else
+		eventgen_start();
 }
 
 /*
@@ -28,8 +28,7 @@
 
 #include "filebench.h"
 
-void eventgen_init(void);
-void eventgen_setrate(avd_t rate);
+void eventgen_setrate(avd_t rate, boolean_t perthread);
 void eventgen_reset(void);
 
 #endif	/* _FB_EVENTGEN_H */
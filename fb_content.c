@@ -0,0 +1,148 @@
+/*
+ * Generates buffer contents with a given compressibility and
+ * deduplication ratio, so that file systems and devices which compress
+ * or deduplicate data do not see all-zero (or uninitialized) writes.
+ *
+ * The expensive part, producing random bytes, is done once per compress
+ * ratio when its pool is built. Filling a buffer is then a memcpy() from
+ * the pool, and stamping the unique tags costs one 16 byte store per
+ * FB_CONTENT_BLOCK, so callers can keep a filled buffer around and only
+ * restamp it before each write.
+ */
+
+#include <pthread.h>
+#include "filebench.h"
+#include "fb_content.h"
+
+static char *fb_content_pools[FB_CONTENT_MAXRATIO + 1];
+static pthread_mutex_t fb_content_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Checks the compress and dedupe ratios. Returns 0 if both are within
+ * 1..FB_CONTENT_MAXRATIO, -1 otherwise.
+ */
+int
+fb_content_check(int compress, int dedupe)
+{
+	if ((compress < 1) || (compress > FB_CONTENT_MAXRATIO) ||
+	    (dedupe < 1) || (dedupe > FB_CONTENT_MAXRATIO))
+		return (-1);
+
+	return (0);
+}
+
+/*
+ * Returns the pool for the given compress ratio, building it on first
+ * use. Pools are never freed. Returns NULL if out of memory.
+ */
+static char *
+fb_content_pool(int compress)
+{
+	uint64_t x = 0x9e3779b97f4a7c15ULL * (uint64_t)compress;
+	size_t randbytes = FB_CONTENT_BLOCK / compress;
+	char *pool;
+	size_t off, i;
+
+	(void) pthread_mutex_lock(&fb_content_lock);
+
+	if ((pool = fb_content_pools[compress]) != NULL) {
+		(void) pthread_mutex_unlock(&fb_content_lock);
+		return (pool);
+	}
+
+	if ((pool = calloc(1, FB_CONTENT_POOLSIZE)) == NULL) {
+		(void) pthread_mutex_unlock(&fb_content_lock);
+		return (NULL);
+	}
+
+	/* xorshift64* is plenty random for defeating compression */
+	for (off = 0; off < FB_CONTENT_POOLSIZE; off += FB_CONTENT_BLOCK) {
+		for (i = 0; i + sizeof (uint64_t) <= randbytes;
+		    i += sizeof (uint64_t)) {
+			uint64_t r;
+
+			x ^= x >> 12;
+			x ^= x << 25;
+			x ^= x >> 27;
+			r = x * 0x2545f4914f6cdd1dULL;
+			(void) memcpy(pool + off + i, &r, sizeof (r));
+		}
+	}
+
+	fb_content_pools[compress] = pool;
+	(void) pthread_mutex_unlock(&fb_content_lock);
+
+	return (pool);
+}
+
+/*
+ * Returns the initial value of a new stamp counter: a unique id, taken
+ * from a counter shared by all processes of the run, in the upper 32
+ * bits, and a block count of zero in the lower ones. Each file and each
+ * content buffer gets a counter of its own, so no two of them are ever
+ * stamped with the same tags.
+ */
+uint64_t
+fb_content_seed(void)
+{
+	uint64_t id;
+
+	id = __sync_add_and_fetch(&filebench_shm->shm_content_ids, 1);
+
+	return (id << 32);
+}
+
+/*
+ * Stamps a unique tag into the start of one out of every "dedupe"
+ * FB_CONTENT_BLOCKs of buf. The tag is made of the start time of the
+ * run and the caller's stamp counter, as set up by fb_content_seed(),
+ * which is advanced by one per block.
+ */
+void
+fb_content_stamp(char *buf, size_t len, int dedupe, uint64_t *stampp)
+{
+	uint64_t tag[2];
+	size_t off;
+
+	tag[0] = (uint64_t)filebench_shm->shm_epoch;
+
+	for (off = 0; off + sizeof (tag) <= len; off += FB_CONTENT_BLOCK) {
+		tag[1] = (*stampp)++;
+		if ((dedupe > 1) && (tag[1] % dedupe))
+			continue;
+		(void) memcpy(buf + off, tag, sizeof (tag));
+	}
+}
+
+/*
+ * Fills len bytes of buf with pool content of the given compress ratio,
+ * then stamps it for the given dedupe ratio. Successive fills with the
+ * same counter, and fills with different counters, start at different
+ * places in the pool. Returns 0 on success, -1 if the pool can't be
+ * allocated.
+ */
+int
+fb_content_fill(char *buf, size_t len, int compress, int dedupe,
+    uint64_t *stampp)
+{
+	char *pool;
+	size_t poff;
+	size_t off;
+
+	if ((pool = fb_content_pool(compress)) == NULL)
+		return (-1);
+
+	poff = ((*stampp + (*stampp >> 32)) * FB_CONTENT_BLOCK) %
+	    FB_CONTENT_POOLSIZE;
+	for (off = 0; off < len; ) {
+		size_t n = MIN(len - off, FB_CONTENT_POOLSIZE - poff);
+
+		(void) memcpy(buf + off, pool + poff, n);
+		off += n;
+		poff = 0;
+	}
+
+	fb_content_stamp(buf, len, dedupe, stampp);
+
+	return (0);
+}
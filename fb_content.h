@@ -0,0 +1,25 @@
+#ifndef _FB_CONTENT_H
+#define	_FB_CONTENT_H
+
+#include "filebench.h"
+
+/*
+ * Data content generator. Buffers are filled from a precomputed pool of
+ * FB_CONTENT_BLOCK sized blocks whose compressibility is set by the
+ * compress ratio: only the first FB_CONTENT_BLOCK / ratio bytes of each
+ * block are random, the rest is zero. Deduplication is controlled by
+ * stamping a unique tag into one out of every "dedupe ratio" blocks; the
+ * remaining blocks repeat content that was seen before.
+ */
+#define	FB_CONTENT_BLOCK	4096
+#define	FB_CONTENT_POOLSIZE	(1024 * 1024)
+#define	FB_CONTENT_MAXRATIO	256
+
+extern int fb_content_check(int compress, int dedupe);
+extern uint64_t fb_content_seed(void);
+extern int fb_content_fill(char *buf, size_t len, int compress, int dedupe,
+    uint64_t *stampp);
+extern void fb_content_stamp(char *buf, size_t len, int dedupe,
+    uint64_t *stampp);
+
+#endif	/* _FB_CONTENT_H */
@@ -11,9 +11,31 @@
 #include <limits.h>
 #include <dlfcn.h>
 
+#include <pthread.h>
 #include "ipc.h"
 #include "fb_cvar.h"
 
+/* Number of values a thread generates at once when the library can. */
+#define CVAR_BATCH	64
+
+/* A thread's copy of a custom variable handle. */
+typedef struct cvar_clone {
+	void *handle;
+	cvar_library_t *cvar_lib;
+	/* Set once cloning failed, so the thread uses the shared handle. */
+	int failed;
+	/* Values generated ahead by cvar_next_values; next is the first unused. */
+	int next;
+	int count;
+	double values[CVAR_BATCH];
+} cvar_clone_t;
+
+/* The copies of a thread, indexed by cvar_id. */
+typedef struct cvar_clones {
+	int count;
+	cvar_clone_t *clone;
+} cvar_clones_t;
+
 /* Some helpers. */
 static int alloc_cvar_lib_info(const char *filename);
 static char *gettype(const char *filename);
@@ -25,6 +47,9 @@ static int init_cvar_library_ops(cvar_library_t *c);
 /* Points to the head of an array of pointers to cvar_library_t. */
 cvar_library_t **cvar_libraries;
 
+static pthread_key_t cvar_clones_key;
+static pthread_once_t cvar_clones_once = PTHREAD_ONCE_INIT;
+
 /*
  * Allocate space for a new custom variable in the shared memory location.
  */
@@ -39,6 +64,8 @@ cvar_alloc(void)
 	}
 
 	/* place on the head of the global list */
+	cvar->cvar_id = filebench_shm->shm_cvar_list ?
+			filebench_shm->shm_cvar_list->cvar_id + 1 : 0;
 	cvar->next = filebench_shm->shm_cvar_list;
 	filebench_shm->shm_cvar_list = cvar;
 
@@ -328,6 +355,8 @@ init_cvar_library_ops(cvar_library_t *c)
 				": %s", dlerror());
 	}
 
+	c->cvar_op.cvar_clone_handle = dlsym(c->lib_handle, FB_CVAR_CLONE_HANDLE);
+
 	c->cvar_op.cvar_next_value = dlsym(c->lib_handle, FB_CVAR_NEXT_VALUE);
 	if (!c->cvar_op.cvar_next_value) {
 		filebench_log(LOG_ERROR, "Unable to find " FB_CVAR_NEXT_VALUE
@@ -335,6 +364,8 @@ init_cvar_library_ops(cvar_library_t *c)
 		goto out;
 	}
 
+	c->cvar_op.cvar_next_values = dlsym(c->lib_handle, FB_CVAR_NEXT_VALUES);
+
 	c->cvar_op.cvar_free_handle = dlsym(c->lib_handle, FB_CVAR_FREE_HANDLE);
 	if (!c->cvar_op.cvar_free_handle) {
 		filebench_log(LOG_ERROR, "Unable to find " FB_CVAR_FREE_HANDLE
@@ -385,17 +416,135 @@ out:
 	return ret;
 }
 
+static void
+free_cvar_clones(void *arg)
+{
+	cvar_clones_t *clones = arg;
+	cvar_clone_t *c;
+	int i;
+
+	for (i = 0; i < clones->count; i++) {
+		c = &clones->clone[i];
+		if (c->handle)
+			c->cvar_lib->cvar_op.cvar_free_handle(c->handle, free);
+	}
+
+	free(clones->clone);
+	free(clones);
+}
+
+static void
+init_cvar_clones_key(void)
+{
+	(void) pthread_key_create(&cvar_clones_key, free_cvar_clones);
+}
+
+/*
+ * Returns the calling thread's copy of the handle of a custom variable,
+ * cloning it on first use, or NULL if the library can't clone handles. A
+ * failed clone is not retried: the thread keeps using the shared handle. The
+ * copies live in process private memory and are freed when the thread exits.
+ */
+static cvar_clone_t *
+get_cvar_clone(cvar_t *cvar, cvar_library_t *cvar_lib)
+{
+	cvar_clones_t *clones;
+	cvar_clone_t *clone;
+	uint64_t stream;
+	int count;
+
+	if (!cvar_lib->cvar_op.cvar_clone_handle)
+		return NULL;
+
+	pthread_once(&cvar_clones_once, init_cvar_clones_key);
+
+	clones = pthread_getspecific(cvar_clones_key);
+	if (!clones) {
+		clones = calloc(1, sizeof(cvar_clones_t));
+		if (!clones)
+			return NULL;
+		pthread_setspecific(cvar_clones_key, clones);
+	}
+
+	if (cvar->cvar_id >= clones->count) {
+		count = cvar->cvar_id + 1;
+		clone = realloc(clones->clone, count * sizeof(cvar_clone_t));
+		if (!clone)
+			return NULL;
+		memset(clone + clones->count, 0,
+				(count - clones->count) * sizeof(cvar_clone_t));
+		clones->clone = clone;
+		clones->count = count;
+	}
+
+	clone = &clones->clone[cvar->cvar_id];
+	if (clone->handle)
+		return clone;
+	if (clone->failed)
+		return NULL;
+
+	/* Drawn from the thread's generator, so the same on every run. */
+	fb_random64(&stream, UINT32_MAX, 0, NULL);
+
+	clone->handle = cvar_lib->cvar_op.cvar_clone_handle(cvar->cvar_handle,
+			(unsigned int) stream, malloc, free);
+	clone->cvar_lib = cvar_lib;
+
+	if (!clone->handle) {
+		filebench_log(LOG_INFO, "Unable to clone custom variable handle"
+				" of type %s, using the shared one",
+				cvar->cvar_lib_info->type);
+		clone->failed = 1;
+		return NULL;
+	}
+
+	return clone;
+}
+
+/*
+ * Takes the next value from a thread's copy of a handle, generating a batch
+ * of CVAR_BATCH values when the library supports it and the previous batch
+ * is used up.
+ */
+static int
+next_cvar_clone_value(cvar_clone_t *clone, double *value)
+{
+	cvar_operations_t *op = &clone->cvar_lib->cvar_op;
+	int ret;
+
+	if (!op->cvar_next_values)
+		return op->cvar_next_value(clone->handle, value);
+
+	if (clone->next == clone->count) {
+		ret = op->cvar_next_values(clone->handle, clone->values, CVAR_BATCH);
+		if (ret)
+			return ret;
+		clone->next = 0;
+		clone->count = CVAR_BATCH;
+	}
+
+	*value = clone->values[clone->next++];
+
+	return 0;
+}
+
 double
 get_cvar_value(cvar_t *cvar)
 {
 	int ret;
 	double value = 0.0;
 	fbint_t round = cvar->round;
-
-	ipc_mutex_lock(&cvar->cvar_lock);
 	cvar_library_t *cvar_lib = cvar_libraries[cvar->cvar_lib_info->index];
-	ret = cvar_lib->cvar_op.cvar_next_value(cvar->cvar_handle, &value);
-	ipc_mutex_unlock(&cvar->cvar_lock);
+	cvar_clone_t *clone;
+
+	if ((clone = get_cvar_clone(cvar, cvar_lib)) != NULL) {
+		/* The thread's own copy needs no locking. */
+		ret = next_cvar_clone_value(clone, &value);
+	} else {
+		ipc_mutex_lock(&cvar->cvar_lock);
+		ret = cvar_lib->cvar_op.cvar_next_value(cvar->cvar_handle, &value);
+		ipc_mutex_unlock(&cvar->cvar_lock);
+	}
 
 	if (ret) {
 		filebench_log(LOG_ERROR, "Unable to get next_value from custom variable"
@@ -16,7 +16,9 @@
 #define FB_CVAR_MODULE_INIT			"cvar_module_init"
 #define FB_CVAR_ALLOC_HANDLE		"cvar_alloc_handle"
 #define FB_CVAR_REVALIDATE_HANDLE	"cvar_revalidate_handle"
+#define FB_CVAR_CLONE_HANDLE		"cvar_clone_handle"
 #define FB_CVAR_NEXT_VALUE			"cvar_next_value"
+#define FB_CVAR_NEXT_VALUES			"cvar_next_values"
 #define FB_CVAR_FREE_HANDLE			"cvar_free_handle"
 #define FB_CVAR_MODULE_EXIT			"cvar_module_exit"
 #define FB_CVAR_USAGE				"cvar_usage"
@@ -39,8 +41,10 @@ typedef struct cvar_library_info {
  * cvar_t (and not vice versa). */
 typedef struct cvar {
 	/* Used to provide exclusive access to this custom variable across threads
-	 * and processes. */
+	 * and processes, unless the library can clone handles. */
 	pthread_mutex_t cvar_lock;
+	/* Sequence number of this custom variable, starting from 0. */
+	int cvar_id;
 	/* The custom variable handle returned by cvar_alloc() */
 	void *cvar_handle;
 	double min;
@@ -57,7 +61,10 @@ typedef struct cvar_operations {
 	void *(*cvar_alloc_handle)(const char *cvar_parameters,
 			void *(*cvar_malloc)(size_t size), void (*cvar_free)(void *ptr));
 	int (*cvar_revalidate_handle)(void *cvar_handle);
+	void *(*cvar_clone_handle)(void *cvar_handle, unsigned int stream,
+			void *(*cvar_malloc)(size_t size), void (*cvar_free)(void *ptr));
 	int (*cvar_next_value)(void *cvar_handle, double *value);
+	int (*cvar_next_values)(void *cvar_handle, double *values, int count);
 	void (*cvar_free_handle)(void *cvar_handle, void (*cvar_free)(void *ptr));
 	void (*cvar_module_exit)();
 	const char *(*cvar_usage)(void);
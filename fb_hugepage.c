@@ -0,0 +1,171 @@
+/*
+ * Huge page backed memory for the hugepages thread attribute and the
+ * "enable hugepages" command.
+ *
+ * MAP_HUGETLB mappings only succeed when huge pages have been reserved
+ * with vm.nr_hugepages, so FB_HUGEPAGES_TLB falls back to transparent
+ * huge pages, which need memory aligned to the huge page size and
+ * covering whole huge pages. Buffers smaller than a huge page are left
+ * alone, as they can't be backed by one. Each fallback is logged once.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "filebench.h"
+#include "fb_hugepage.h"
+
+#define	FB_HUGEPAGE_NOTLB	0x1	/* MAP_HUGETLB failure was logged */
+#define	FB_HUGEPAGE_NOTHP	0x2	/* MADV_HUGEPAGE failure was logged */
+
+static size_t fb_hugepage_sz;	/* huge page size, once looked up */
+static int fb_hugepage_logged;	/* fallbacks already logged */
+
+/*
+ * Converts a hugepages attribute value to one of the FB_HUGEPAGES_*
+ * modes: a boolean, or one of "thp", "hugetlb" and "none" (or "true"
+ * and "false" as strings). Returns -1 if the value is not known.
+ */
+int
+fb_hugepage_mode(avd_t avd)
+{
+	char *name;
+
+	if (!AVD_IS_STRING(avd))
+		return (avd_get_bool(avd) ? FB_HUGEPAGES_TLB :
+		    FB_HUGEPAGES_NONE);
+
+	if ((name = avd_get_str(avd)) == NULL)
+		return (-1);
+	if (!strcmp(name, "thp"))
+		return (FB_HUGEPAGES_THP);
+	if (!strcmp(name, "hugetlb") || !strcmp(name, "true"))
+		return (FB_HUGEPAGES_TLB);
+	if (!strcmp(name, "none") || !strcmp(name, "false"))
+		return (FB_HUGEPAGES_NONE);
+
+	return (-1);
+}
+
+/*
+ * Returns the default huge page size, reading it from /proc/meminfo on
+ * first use.
+ */
+size_t
+fb_hugepage_size(void)
+{
+	FILE *fp;
+	char line[128];
+	unsigned long kb;
+
+	if (fb_hugepage_sz != 0)
+		return (fb_hugepage_sz);
+
+	fb_hugepage_sz = FB_HUGEPAGE_DEFSIZE;
+	if ((fp = fopen("/proc/meminfo", "r")) == NULL)
+		return (fb_hugepage_sz);
+
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		if ((sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) &&
+		    (kb != 0)) {
+			fb_hugepage_sz = (size_t)kb * KB;
+			break;
+		}
+	}
+	(void) fclose(fp);
+
+	return (fb_hugepage_sz);
+}
+
+/*
+ * Asks for the page aligned range to be backed by transparent huge
+ * pages. Only the whole huge pages within the range can be. Returns 0
+ * on success, -1 if the kernel or the backing file system does not
+ * support them.
+ */
+int
+fb_hugepage_advise(caddr_t addr, size_t len)
+{
+#ifdef MADV_HUGEPAGE
+	if (madvise(addr, len, MADV_HUGEPAGE) == 0)
+		return (0);
+
+	if (!(fb_hugepage_logged & FB_HUGEPAGE_NOTHP)) {
+		fb_hugepage_logged |= FB_HUGEPAGE_NOTHP;
+		filebench_log(LOG_INFO, "Transparent huge pages are not "
+		    "available (%s), using base pages", strerror(errno));
+	}
+#else
+	if (!(fb_hugepage_logged & FB_HUGEPAGE_NOTHP)) {
+		fb_hugepage_logged |= FB_HUGEPAGE_NOTHP;
+		filebench_log(LOG_INFO, "Transparent huge pages are not "
+		    "supported by this build, using base pages");
+	}
+#endif /* MADV_HUGEPAGE */
+
+	return (-1);
+}
+
+/*
+ * posix_memalign() that, for buffers of at least a huge page and a mode
+ * other than FB_HUGEPAGES_NONE, aligns and rounds the buffer up to huge
+ * pages and advises transparent huge pages for it. The buffer is freed
+ * with free(). Returns what posix_memalign() returns.
+ */
+int
+fb_hugepage_memalign(void **bufp, size_t align, size_t size, int mode)
+{
+	size_t hsize;
+	int ret;
+
+	hsize = fb_hugepage_size();
+	if ((mode == FB_HUGEPAGES_NONE) || (size < hsize))
+		return (posix_memalign(bufp, align, size));
+
+	size = (size + hsize - 1) & ~(hsize - 1);
+	if ((ret = posix_memalign(bufp, MAX(align, hsize), size)) != 0)
+		return (ret);
+
+	(void) fb_hugepage_advise(*bufp, size);
+
+	return (0);
+}
+
+/*
+ * Allocates thread memory of the given size with the given
+ * FB_HUGEPAGES_* mode, falling back as described above. The memory is
+ * aligned to align, a power of two, and at least to a page. It is never
+ * freed, like the tf_mem it is used for. Returns NULL if no memory could
+ * be allocated.
+ */
+caddr_t
+fb_hugepage_alloc(size_t size, size_t align, int mode)
+{
+	void *buf;
+#ifdef MAP_HUGETLB
+	size_t hsize;
+
+	hsize = fb_hugepage_size();
+	if ((mode == FB_HUGEPAGES_TLB) && (size != 0) && (align <= hsize)) {
+		buf = mmap(NULL, (size + hsize - 1) & ~(hsize - 1),
+		    PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (buf != MAP_FAILED)
+			return ((caddr_t)buf);
+
+		if (!(fb_hugepage_logged & FB_HUGEPAGE_NOTLB)) {
+			fb_hugepage_logged |= FB_HUGEPAGE_NOTLB;
+			filebench_log(LOG_INFO, "Could not map %zu bytes of "
+			    "hugetlb pages (%s), trying transparent huge pages",
+			    size, strerror(errno));
+		}
+	}
+#endif /* MAP_HUGETLB */
+
+	if (fb_hugepage_memalign(&buf, MAX(align, (size_t)getpagesize()),
+	    size, mode) != 0)
+		return (NULL);
+
+	return ((caddr_t)buf);
+}
@@ -0,0 +1,29 @@
+#ifndef _FB_HUGEPAGE_H
+#define	_FB_HUGEPAGE_H
+
+#include "filebench.h"
+
+/*
+ * Huge page backing for thread memory, I/O buffers and the shared
+ * memory pools, so that large I/O buffers cost a few TLB entries rather
+ * than one per 4K page. FB_HUGEPAGES_TLB maps memory from the reserved
+ * hugetlb pool and falls back to FB_HUGEPAGES_THP, which asks for
+ * transparent huge pages with madvise(), when the pool can't supply it.
+ * When neither is available memory stays on base pages.
+ */
+#define	FB_HUGEPAGES_DEFAULT	-1	/* thread follows "enable hugepages" */
+#define	FB_HUGEPAGES_NONE	0	/* base pages */
+#define	FB_HUGEPAGES_TLB	1	/* MAP_HUGETLB, else THP */
+#define	FB_HUGEPAGES_THP	2	/* madvise(MADV_HUGEPAGE) */
+
+/* used when the size can't be read from /proc/meminfo */
+#define	FB_HUGEPAGE_DEFSIZE	(2 * MB)
+
+extern int fb_hugepage_mode(avd_t avd);
+extern size_t fb_hugepage_size(void);
+extern int fb_hugepage_advise(caddr_t addr, size_t len);
+extern int fb_hugepage_memalign(void **bufp, size_t align, size_t size,
+    int mode);
+extern caddr_t fb_hugepage_alloc(size_t size, size_t align, int mode);
+
+#endif	/* _FB_HUGEPAGE_H */
@@ -80,6 +80,15 @@ static int fb_lfs_stat(char *, struct stat64 *);
 static int fb_lfs_fstat(fb_fdesc_t *, struct stat64 *);
 static int fb_lfs_access(const char *, int);
 static void fb_lfs_recur_rm(char *);
+static int fb_lfs_fallocate(fb_fdesc_t *, int, off64_t, off64_t);
+static int fb_lfs_cachectl(fb_fdesc_t *, int, off64_t, off64_t);
+static int fb_lfs_preadv2(fb_fdesc_t *, const struct iovec *, int, off64_t,
+    int);
+static int fb_lfs_pwritev2(fb_fdesc_t *, const struct iovec *, int, off64_t,
+    int);
+static int fb_lfs_fdatasync(fb_fdesc_t *);
+static int fb_lfs_syncrange(fb_fdesc_t *, off64_t, off64_t, int);
+static int fb_lfs_syncfs(fb_fdesc_t *);
 
 static fsplug_func_t fb_lfs_funcs =
 {
@@ -107,7 +116,14 @@ static fsplug_func_t fb_lfs_funcs =
 	fb_lfs_stat,		/* stat */
 	fb_lfs_fstat,		/* fstat */
 	fb_lfs_access,		/* access */
-	fb_lfs_recur_rm		/* recursive rm */
+	fb_lfs_recur_rm,	/* recursive rm */
+	fb_lfs_fallocate,	/* fallocate */
+	fb_lfs_cachectl,	/* page cache control */
+	fb_lfs_preadv2,		/* preadv2 */
+	fb_lfs_pwritev2,	/* pwritev2 */
+	fb_lfs_fdatasync,	/* fdatasync */
+	fb_lfs_syncrange,	/* sync_file_range */
+	fb_lfs_syncfs		/* syncfs */
 };
 
 #ifdef HAVE_AIO
@@ -115,10 +131,13 @@ static fsplug_func_t fb_lfs_funcs =
  * Local file system asynchronous IO flowops are in this module, as
  * they have a number of local file system specific features.
  */
+static int fb_lfsflow_aioread(threadflow_t *threadflow, flowop_t *flowop);
 static int fb_lfsflow_aiowrite(threadflow_t *threadflow, flowop_t *flowop);
 static int fb_lfsflow_aiowait(threadflow_t *threadflow, flowop_t *flowop);
 
 static flowop_proto_t fb_lfsflow_funcs[] = {
+	{FLOW_TYPE_AIO, FLOW_ATTR_READ, "aioread", flowop_init_generic,
+	fb_lfsflow_aioread, flowop_destruct_generic},
 	{FLOW_TYPE_AIO, FLOW_ATTR_WRITE, "aiowrite", flowop_init_generic,
 	fb_lfsflow_aiowrite, flowop_destruct_generic},
 	{FLOW_TYPE_AIO, 0, "aiowait", flowop_init_generic,
@@ -197,276 +216,217 @@ fb_lfs_read(fb_fdesc_t *fd, caddr_t iobuf, fbint_t iosize)
 
 #ifdef HAVE_AIO
 
-/*
- * Asynchronous write section. An Asynchronous IO element
- * (aiolist_t) is used to associate the asynchronous write request with
- * its subsequent completion. This element includes a aiocb64 struct
- * that is used by posix aio_xxx calls to track the asynchronous writes.
- * The flowops aiowrite and aiowait result in calls to these posix
- * aio_xxx system routines to do the actual asynchronous write IO
- * operations.
- */
-
+/* full ring waits with nothing completing before an aio flowop gives up */
+#define	FB_AIO_REAP_TRIES	10
 
 /*
- * Allocates an asynchronous I/O list (aio, of type
- * aiolist_t) element. Adds it to the flowop thread's
- * threadflow aio list. Returns a pointer to the element.
+ * Asynchronous I/O section. Each asynchronous read or write is tracked
+ * by an element (aiolist_t) taken from the thread's preallocated
+ * request ring, which associates the request with its subsequent
+ * completion. This element includes a aiocb64 struct that is used by
+ * posix aio_xxx calls to track the asynchronous I/O. The flowops
+ * aioread, aiowrite and aiowait result in calls to these posix aio_xxx
+ * system routines to do the actual asynchronous I/O operations. The
+ * latency and bytes of each request are recorded against the flowop
+ * that submitted it when the request is reaped.
  */
-static aiolist_t *
-aio_allocate(flowop_t *flowop)
-{
-	aiolist_t *aiolist;
-
-	if ((aiolist = malloc(sizeof (aiolist_t))) == NULL) {
-		filebench_log(LOG_ERROR, "malloc aiolist failed");
-		filebench_shutdown(1);
-	}
-
-	bzero(aiolist, sizeof(*aiolist));
-
-	/* Add to list */
-	if (flowop->fo_thread->tf_aiolist == NULL) {
-		flowop->fo_thread->tf_aiolist = aiolist;
-		aiolist->al_next = NULL;
-	} else {
-		aiolist->al_next = flowop->fo_thread->tf_aiolist;
-		flowop->fo_thread->tf_aiolist = aiolist;
-	}
-	return (aiolist);
-}
 
 /*
- * Searches for the aiolist element that has a matching
- * completion block, aiocb. If none found returns FILEBENCH_ERROR. If
- * found, removes the aiolist element from flowop thread's
- * list and returns FILEBENCH_OK.
+ * Reaps the completed posix aio requests of the thread, completing
+ * each one in place. If wait is set, first waits up to one second for
+ * at least one request to complete. Requests submitted through other
+ * asynchronous engines are left alone. Returns the number of requests
+ * reaped.
  */
 static int
-aio_deallocate(flowop_t *flowop, struct aiocb64 *aiocb)
+aio_reap(threadflow_t *threadflow, int wait)
 {
-	aiolist_t *aiolist = flowop->fo_thread->tf_aiolist;
-	aiolist_t *previous = NULL;
-	aiolist_t *match = NULL;
+	int nreaped = 0;
+	int i;
 
-	if (aiocb == NULL) {
-		filebench_log(LOG_ERROR, "null aiocb deallocate");
-		return (FILEBENCH_OK);
-	}
+	if (wait) {
+		struct timespec timeout;
 
-	while (aiolist) {
-		if (aiocb == &(aiolist->al_aiocb)) {
-			match = aiolist;
-			break;
+		timeout.tv_sec = 1;
+		timeout.tv_nsec = 0;
+
+		if ((aio_suspend64((const struct aiocb64 * const *)
+		    threadflow->tf_aiocbs, threadflow->tf_aiocount,
+		    &timeout) == -1) && (errno != EAGAIN) &&
+		    (errno != EINTR)) {
+			filebench_log(LOG_ERROR, "aio_suspend failed: %s",
+			    strerror(errno));
 		}
-		previous = aiolist;
-		aiolist = aiolist->al_next;
 	}
 
-	if (match == NULL)
-		return (FILEBENCH_ERROR);
+	/*
+	 * Walk the in flight array backwards, as completing a request
+	 * moves the last one, which has already been looked at, into
+	 * its slot.
+	 */
+	for (i = threadflow->tf_aiocount - 1; i >= 0; i--) {
+		aiolist_t *aio = threadflow->tf_aiopending[i];
+		ssize_t bytes;
+		int result;
+
+		if (aio->al_type & AL_URING)
+			continue;
+
+		if ((result = aio_error64(&aio->al_aiocb)) == EINPROGRESS)
+			continue;
+
+		bytes = aio_return64(&aio->al_aiocb);
+		if ((bytes == -1) || result) {
+			filebench_log(LOG_ERROR, "aio failed: %s",
+			    strerror(result));
+			bytes = 0;
+		}
 
-	/* Remove from the list */
-	if (previous)
-		previous->al_next = match->al_next;
-	else
-		flowop->fo_thread->tf_aiolist = match->al_next;
+		flowop_aio_done(threadflow, aio, bytes);
+		nreaped++;
+	}
 
-	return (FILEBENCH_OK);
+	return (nreaped);
 }
 
 /*
- * Emulate posix aiowrite(). Determines which file to use,
- * either one file of a fileset, or the file associated
- * with a fileobj, allocates and fills an aiolist_t element
- * for the write, and issues the asynchronous write. This
- * operation is only valid for random IO, and returns an
- * error if the flowop is set for sequential IO. Returns
- * FILEBENCH_OK on success, FILEBENCH_NORSC if iosetup can't
- * obtain a file to open, and FILEBENCH_ERROR on any
+ * Emulate posix aioread() and aiowrite(). Determines which file to
+ * use, either one file of a fileset, or the file associated with a
+ * fileobj, takes an aiolist_t element from the thread's request ring
+ * for the I/O, and issues the asynchronous read or write. If the ring
+ * is exhausted, completed requests are reaped first. This operation is
+ * only valid for random IO, and returns an error if the flowop is set
+ * for sequential IO. Returns FILEBENCH_OK on success, FILEBENCH_NORSC
+ * if iosetup can't obtain a file to open, and FILEBENCH_ERROR on any
  * encountered error.
  */
 static int
-fb_lfsflow_aiowrite(threadflow_t *threadflow, flowop_t *flowop)
+fb_lfsflow_aio(threadflow_t *threadflow, flowop_t *flowop, int type)
 {
+	struct aiocb64 *aiocb;
+	aiolist_t *aiolist;
+	uint64_t fileoffset;
 	caddr_t iobuf;
 	fbint_t wss;
 	fbint_t iosize;
 	fb_fdesc_t *fdesc;
+	int tries;
 	int ret;
 
-	iosize = avd_get_int(flowop->fo_iosize);
+	if (!(flowop->fo_boolattrs & FLOW_BOOL_RANDOM))
+		return (FILEBENCH_ERROR);
+
+	iosize = flowoplib_iosize(flowop);
 
 	if ((ret = flowoplib_iosetup(threadflow, flowop, &wss, &iobuf,
 	    &fdesc, iosize)) != FILEBENCH_OK)
 		return (ret);
 
-	if (avd_get_bool(flowop->fo_random)) {
-		uint64_t fileoffset;
-		struct aiocb64 *aiocb;
-		aiolist_t *aiolist;
+	if (wss < iosize) {
+		filebench_log(LOG_ERROR,
+		    "file size smaller than IO size for thread %s",
+		    flowop->fo_name);
+		return (FILEBENCH_ERROR);
+	}
 
-		if (wss < iosize) {
-			filebench_log(LOG_ERROR,
-			    "file size smaller than IO size for thread %s",
-			    flowop->fo_name);
-			return (FILEBENCH_ERROR);
+	fileoffset = fb_random_ring(&flowop->fo_offring, wss, iosize);
+
+	/*
+	 * The ring is shared with the io_uring flowops, so reap their
+	 * completions too, and give up if nothing at all completes.
+	 */
+	for (tries = 0;
+	    (aiolist = flowop_aio_get(threadflow, flowop, type)) == NULL; ) {
+		if ((aio_reap(threadflow, FALSE) > 0) ||
+		    (fb_uring_reap_async(FALSE) > 0))
+			continue;
+
+		if (++tries > FB_AIO_REAP_TRIES) {
+			filebench_log(LOG_ERROR, "flowop %s: no async I/O "
+			    "completed, all %d requests still in flight",
+			    flowop->fo_name, THREADFLOW_MAXAIO);
+			return (FILEBENCH_NORSC);
 		}
 
-		fb_random64(&fileoffset, wss, iosize, NULL);
-
-		aiolist = aio_allocate(flowop);
-		aiolist->al_type = AL_WRITE;
-		aiocb = &aiolist->al_aiocb;
-
-		aiocb->aio_fildes = fdesc->fd_num;
-		aiocb->aio_buf = iobuf;
-		aiocb->aio_nbytes = (size_t)iosize;
-		aiocb->aio_offset = (off64_t)fileoffset;
-		aiocb->aio_reqprio = 0;
+		/* a second for posix aio, else an io_uring completion */
+		if (aio_reap(threadflow, TRUE) == 0)
+			(void) fb_uring_reap_async(TRUE);
+	}
 
-		filebench_log(LOG_DEBUG_IMPL,
-		    "aio fd=%d, bytes=%llu, offset=%llu",
-		    fdesc->fd_num, (u_longlong_t)iosize,
-		    (u_longlong_t)fileoffset);
+	aiocb = &aiolist->al_aiocb;
+	bzero(aiocb, sizeof (*aiocb));
+	aiocb->aio_fildes = fdesc->fd_num;
+	aiocb->aio_buf = iobuf;
+	aiocb->aio_nbytes = (size_t)iosize;
+	aiocb->aio_offset = (off64_t)fileoffset;
+	aiocb->aio_reqprio = 0;
+
+	filebench_log(LOG_DEBUG_IMPL,
+	    "aio fd=%d, bytes=%llu, offset=%llu",
+	    fdesc->fd_num, (u_longlong_t)iosize,
+	    (u_longlong_t)fileoffset);
+
+	if (type == AL_READ)
+		ret = aio_read64(aiocb);
+	else
+		ret = aio_write64(aiocb);
 
-		flowop_beginop(threadflow, flowop);
-		if (aio_write64(aiocb) < 0) {
-			filebench_log(LOG_ERROR, "aiowrite failed: %s",
-			    strerror(errno));
-			filebench_shutdown(1);
-		}
-		flowop_endop(threadflow, flowop, iosize);
-	} else {
-		return (FILEBENCH_ERROR);
+	if (ret < 0) {
+		filebench_log(LOG_ERROR, "%s failed: %s",
+		    (type == AL_READ) ? "aioread" : "aiowrite",
+		    strerror(errno));
+		filebench_shutdown(1);
 	}
 
 	return (FILEBENCH_OK);
 }
 
+static int
+fb_lfsflow_aioread(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (fb_lfsflow_aio(threadflow, flowop, AL_READ));
+}
 
-
-#define	MAXREAP 4096
+static int
+fb_lfsflow_aiowrite(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (fb_lfsflow_aio(threadflow, flowop, AL_WRITE));
+}
 
 /*
  * Emulate posix aiowait(). Waits for the completion of half the
  * outstanding asynchronous IOs, or a single IO, which ever is
  * larger. The routine will return after a sufficient number of
- * completed calls issued by any thread in the procflow have
- * completed, or a 1 second timout elapses. All completed
- * IO operations are deleted from the thread's aiolist.
+ * the thread's requests have completed, or a 1 second timout
+ * elapses without any completing. All completed IO operations
+ * are returned to the thread's request ring.
  */
 static int
 fb_lfsflow_aiowait(threadflow_t *threadflow, flowop_t *flowop)
 {
-	struct aiocb64 **worklist;
-	aiolist_t *aio = flowop->fo_thread->tf_aiolist;
-	int uncompleted = 0;
-#ifdef HAVE_AIOWAITN
-	int i;
-#endif
-
-	worklist = calloc(MAXREAP, sizeof (struct aiocb64 *));
-
-	/* Count the list of pending aios */
-	while (aio) {
-		uncompleted++;
-		aio = aio->al_next;
-	}
-
-	do {
-		uint_t ncompleted = 0;
-		uint_t todo;
-		int inprogress;
-#ifdef HAVE_AIOWAITN
-		struct timespec timeout;
-
-		/* Wait for half of the outstanding requests */
-		timeout.tv_sec = 1;
-		timeout.tv_nsec = 0;
-#endif
-
-		if (uncompleted > MAXREAP)
-			todo = MAXREAP;
-		else
-			todo = uncompleted / 2;
-
-		if (todo == 0)
-			todo = 1;
-
-		flowop_beginop(threadflow, flowop);
-
-#ifdef HAVE_AIOWAITN
-		if (((aio_waitn64((struct aiocb64 **)worklist,
-		    MAXREAP, &todo, &timeout)) == -1) &&
-		    errno && (errno != ETIME)) {
-			filebench_log(LOG_ERROR,
-			    "aiowait failed: %s, outstanding = %d, "
-			    "ncompleted = %d ",
-			    strerror(errno), uncompleted, todo);
-		}
-
-		ncompleted = todo;
-		/* Take the  completed I/Os from the list */
-		inprogress = 0;
-		for (i = 0; i < ncompleted; i++) {
-			if ((aio_return64(worklist[i]) == -1) &&
-			    (errno == EINPROGRESS)) {
-				inprogress++;
-				continue;
-			}
-			if (aio_deallocate(flowop, worklist[i])
-			    == FILEBENCH_ERROR) {
-				filebench_log(LOG_ERROR, "Could not remove "
-				    "aio from list ");
-				flowop_endop(threadflow, flowop, 0);
-				return (FILEBENCH_ERROR);
-			}
-		}
+	int todo;
+	int n;
 
-		uncompleted -= ncompleted;
-		uncompleted += inprogress;
+	if (threadflow->tf_aiocount == 0)
+		return (FILEBENCH_OK);
 
-#else
+	todo = MAX(threadflow->tf_aiocount / 2, 1);
 
-		for (ncompleted = 0, inprogress = 0,
-		    aio = flowop->fo_thread->tf_aiolist;
-		    ncompleted < todo && aio != NULL; aio = aio->al_next) {
-			int result = aio_error64(&aio->al_aiocb);
-
-			if (result == EINPROGRESS) {
-				inprogress++;
-				continue;
-			}
-
-			if ((aio_return64(&aio->al_aiocb) == -1) || result) {
-				filebench_log(LOG_ERROR, "aio failed: %s",
-				    strerror(result));
-				continue;
-			}
-
-			ncompleted++;
-
-			if (aio_deallocate(flowop, &aio->al_aiocb) < 0) {
-				filebench_log(LOG_ERROR, "Could not remove "
-				    "aio from list ");
-				flowop_endop(threadflow, flowop, 0);
-				return (FILEBENCH_ERROR);
-			}
-		}
+	flowop_beginop(threadflow, flowop);
 
-		uncompleted -= ncompleted;
+	for (n = aio_reap(threadflow, FALSE); n < todo; ) {
+		int reaped;
 
-#endif
-		filebench_log(LOG_DEBUG_SCRIPT,
-		    "aio2 completed %d ios, uncompleted = %d, inprogress = %d",
-		    ncompleted, uncompleted, inprogress);
-
-	} while (uncompleted > MAXREAP);
+		if ((reaped = aio_reap(threadflow, TRUE)) == 0)
+			break;
+		n += reaped;
+	}
 
 	flowop_endop(threadflow, flowop, 0);
 
-	free(worklist);
+	filebench_log(LOG_DEBUG_SCRIPT,
+	    "aio completed %d ios, uncompleted = %d",
+	    n, threadflow->tf_aiocount);
 
 	return (FILEBENCH_OK);
 }
@@ -515,6 +475,76 @@ fb_lfs_fsync(fb_fdesc_t *fd)
 	return (fsync(fd->fd_num));
 }
 
+/*
+ * Does fdatasync of a file. Returns with fdatasync return info.
+ */
+static int
+fb_lfs_fdatasync(fb_fdesc_t *fd)
+{
+	return (fdatasync(fd->fd_num));
+}
+
+/*
+ * Translates FB_SFR_* flags into the platform's SYNC_FILE_RANGE_*
+ * flags. Returns -1 with errno set to EOPNOTSUPP if sync_file_range()
+ * is not available.
+ */
+int
+fb_lfs_syncflags(int flags)
+{
+#ifdef SYNC_FILE_RANGE_WRITE
+	int sfrflags = 0;
+
+	if (flags & FB_SFR_WAIT_BEFORE)
+		sfrflags |= SYNC_FILE_RANGE_WAIT_BEFORE;
+	if (flags & FB_SFR_WRITE)
+		sfrflags |= SYNC_FILE_RANGE_WRITE;
+	if (flags & FB_SFR_WAIT_AFTER)
+		sfrflags |= SYNC_FILE_RANGE_WAIT_AFTER;
+
+	return (sfrflags);
+#else
+	errno = EOPNOTSUPP;
+	return (-1);
+#endif /* SYNC_FILE_RANGE_WRITE */
+}
+
+/*
+ * Does sync_file_range of len bytes at offset, to the end of the file
+ * if len is 0, with FB_SFR_* flags. Returns what sync_file_range()
+ * returns.
+ */
+static int
+fb_lfs_syncrange(fb_fdesc_t *fd, off64_t offset, off64_t len, int flags)
+{
+#ifdef SYNC_FILE_RANGE_WRITE
+	int sfrflags;
+
+	if ((sfrflags = fb_lfs_syncflags(flags)) < 0)
+		return (-1);
+
+	return (sync_file_range(fd->fd_num, offset, len, sfrflags));
+#else
+	errno = EOPNOTSUPP;
+	return (-1);
+#endif /* SYNC_FILE_RANGE_WRITE */
+}
+
+/*
+ * Does syncfs of the file system the file is on. Falls back to a
+ * sync() of all file systems where syncfs() is not available.
+ */
+static int
+fb_lfs_syncfs(fb_fdesc_t *fd)
+{
+#ifdef __linux__
+	return (syncfs(fd->fd_num));
+#else
+	sync();
+	return (0);
+#endif /* __linux__ */
+}
+
 /*
  * Do a posix lseek of a file. Return what lseek() returns.
  */
@@ -657,6 +687,185 @@ fb_lfs_truncate(fb_fdesc_t *fd, off64_t fse_size)
 #endif
 }
 
+/*
+ * Reserves space for the byte range [offset, offset + len) of the file
+ * without writing any data. Returns -1 with errno set to EOPNOTSUPP if
+ * neither the platform nor the file system support it, in which case
+ * the caller is expected to fall back to writing the range.
+ */
+static int
+fb_lfs_fallocate(fb_fdesc_t *fd, int mode, off64_t offset, off64_t len)
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+	return (fallocate64(fd->fd_num, mode, offset, len));
+#else
+	errno = EOPNOTSUPP;
+	return (-1);
+#endif
+}
+
+/*
+ * Applies page cache control operation "op" to the byte range
+ * [offset, offset + len) of the file, a len of zero meaning up to the end
+ * of the file. FB_CACHE_DONTNEED first writes the range back, as dirty
+ * pages can't be dropped, and FB_CACHE_READAHEAD reads it in before
+ * returning where readahead() is available. Returns 0 on success, -1 on
+ * failure.
+ */
+static int
+fb_lfs_cachectl(fb_fdesc_t *fd, int op, off64_t offset, off64_t len)
+{
+#ifdef HAVE_FADVISE
+	int advice;
+	int ret;
+
+	switch (op) {
+	case FB_CACHE_NORMAL:
+		advice = POSIX_FADV_NORMAL;
+		break;
+	case FB_CACHE_SEQUENTIAL:
+		advice = POSIX_FADV_SEQUENTIAL;
+		break;
+	case FB_CACHE_RANDOM:
+		advice = POSIX_FADV_RANDOM;
+		break;
+	case FB_CACHE_WILLNEED:
+		advice = POSIX_FADV_WILLNEED;
+		break;
+	case FB_CACHE_DONTNEED:
+		(void) fdatasync(fd->fd_num);
+		advice = POSIX_FADV_DONTNEED;
+		break;
+	case FB_CACHE_READAHEAD:
+#ifdef __linux__
+		if (len == 0) {
+			struct stat64 sb;
+
+			if (fstat64(fd->fd_num, &sb) < 0)
+				return (-1);
+			len = sb.st_size - MIN(offset, sb.st_size);
+		}
+		return (readahead(fd->fd_num, offset, len) < 0 ? -1 : 0);
+#else
+		advice = POSIX_FADV_WILLNEED;
+		break;
+#endif /* __linux__ */
+	default:
+		errno = EINVAL;
+		return (-1);
+	}
+
+	/* posix_fadvise() returns the error instead of setting errno */
+	if ((ret = posix_fadvise(fd->fd_num, offset, len, advice)) != 0) {
+		errno = ret;
+		return (-1);
+	}
+
+	return (0);
+#else
+	struct stat64 sb;
+
+	/* without fadvise, only dropping the whole file is supported */
+	if ((op != FB_CACHE_DONTNEED) || offset || len) {
+		errno = EOPNOTSUPP;
+		return (-1);
+	}
+
+	if (fstat64(fd->fd_num, &sb) < 0)
+		return (-1);
+
+	return ((sb.st_size && fb_lfs_freemem(fd, sb.st_size)) ? -1 : 0);
+#endif /* HAVE_FADVISE */
+}
+
+/*
+ * Translates FB_RWF_* flags into the platform's RWF_* flags. Returns -1
+ * with errno set to EOPNOTSUPP if any of them is not available.
+ */
+int
+fb_lfs_rwflags(int flags)
+{
+	int rwflags = 0;
+
+#ifdef RWF_NOWAIT
+	if (flags & FB_RWF_NOWAIT) {
+		rwflags |= RWF_NOWAIT;
+		flags &= ~FB_RWF_NOWAIT;
+	}
+#endif
+#ifdef RWF_HIPRI
+	if (flags & FB_RWF_HIPRI) {
+		rwflags |= RWF_HIPRI;
+		flags &= ~FB_RWF_HIPRI;
+	}
+#endif
+#ifdef RWF_DSYNC
+	if (flags & FB_RWF_DSYNC) {
+		rwflags |= RWF_DSYNC;
+		flags &= ~FB_RWF_DSYNC;
+	}
+#endif
+#ifdef RWF_SYNC
+	if (flags & FB_RWF_SYNC) {
+		rwflags |= RWF_SYNC;
+		flags &= ~FB_RWF_SYNC;
+	}
+#endif
+
+	if (flags) {
+		errno = EOPNOTSUPP;
+		return (-1);
+	}
+
+	return (rwflags);
+}
+
+/*
+ * Does a vectored read at offset, or at the current file position if
+ * offset is -1, with FB_RWF_* flags. Without preadv2() only a zero
+ * flags value is supported. Returns what the read returns.
+ */
+static int
+fb_lfs_preadv2(fb_fdesc_t *fd, const struct iovec *iov, int iovcnt,
+    off64_t offset, int flags)
+{
+	int rwflags;
+
+	if ((rwflags = fb_lfs_rwflags(flags)) < 0)
+		return (-1);
+
+#ifdef RWF_HIPRI
+	return (preadv2(fd->fd_num, iov, iovcnt, offset, rwflags));
+#else
+	if (offset == -1)
+		return (readv(fd->fd_num, iov, iovcnt));
+	return (preadv(fd->fd_num, iov, iovcnt, offset));
+#endif
+}
+
+/*
+ * Does a vectored write at offset, or at the current file position if
+ * offset is -1, with FB_RWF_* flags. Without pwritev2() only a zero
+ * flags value is supported. Returns what the write returns.
+ */
+static int
+fb_lfs_pwritev2(fb_fdesc_t *fd, const struct iovec *iov, int iovcnt,
+    off64_t offset, int flags)
+{
+	int rwflags;
+
+	if ((rwflags = fb_lfs_rwflags(flags)) < 0)
+		return (-1);
+
+#ifdef RWF_HIPRI
+	return (pwritev2(fd->fd_num, iov, iovcnt, offset, rwflags));
+#else
+	if (offset == -1)
+		return (writev(fd->fd_num, iov, iovcnt));
+	return (pwritev(fd->fd_num, iov, iovcnt, offset));
+#endif
+}
+
 /*
  * Does a link operation and returns the result
  */
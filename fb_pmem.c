@@ -0,0 +1,300 @@
+/*
+ * Persistent memory store and flush primitives for the pmemstore flowop.
+ *
+ * Which cache line flush instructions the CPU has is found out once
+ * with CPUID. Non-temporal copies use 32 byte AVX stores when the CPU
+ * has AVX and 16 byte SSE2 stores otherwise. Their unaligned head and
+ * tail are copied with regular stores and flushed like any other line,
+ * so that the whole range is persistent after the final fence.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "filebench.h"
+#include "fb_pmem.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define	FB_PMEM_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#define	FB_PMEM_LINE	64	/* cache line size */
+
+static int fb_pmem_features = -1;	/* supported modes, as a bitmask */
+static int fb_pmem_avx;			/* CPU has AVX */
+
+/*
+ * Returns the bitmask of modes the CPU supports, querying it on first
+ * use. SSE2, and hence clflush and non-temporal stores, is part of
+ * x86_64; clflushopt and clwb are reported by CPUID leaf 7.
+ */
+static int
+fb_pmem_cpu(void)
+{
+	int features;
+#ifdef FB_PMEM_X86
+	unsigned int eax, ebx, ecx, edx;
+#endif
+
+	if (fb_pmem_features != -1)
+		return (fb_pmem_features);
+
+	features = 1 << FB_PMEM_MSYNC;
+#ifdef FB_PMEM_X86
+	features |= (1 << FB_PMEM_NTSTORE) | (1 << FB_PMEM_CLFLUSH);
+	if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+		if (ebx & bit_CLFLUSHOPT)
+			features |= 1 << FB_PMEM_CLFLUSHOPT;
+		if (ebx & bit_CLWB)
+			features |= 1 << FB_PMEM_CLWB;
+	}
+	fb_pmem_avx = __builtin_cpu_supports("avx");
+#endif
+
+	fb_pmem_features = features;
+	return (features);
+}
+
+/*
+ * Converts a storemode attribute value to one of the FB_PMEM_* modes.
+ * No value means FB_PMEM_AUTO. Returns -1 if the name is not known.
+ */
+int
+fb_pmem_mode(char *name)
+{
+	if ((name == NULL) || !strcmp(name, "auto"))
+		return (FB_PMEM_AUTO);
+	if (!strcmp(name, "ntstore"))
+		return (FB_PMEM_NTSTORE);
+	if (!strcmp(name, "clwb"))
+		return (FB_PMEM_CLWB);
+	if (!strcmp(name, "clflushopt"))
+		return (FB_PMEM_CLFLUSHOPT);
+	if (!strcmp(name, "clflush"))
+		return (FB_PMEM_CLFLUSH);
+	if (!strcmp(name, "msync"))
+		return (FB_PMEM_MSYNC);
+
+	return (-1);
+}
+
+/*
+ * Returns non-zero if the CPU supports the given mode.
+ */
+int
+fb_pmem_supported(int mode)
+{
+	if (mode == FB_PMEM_AUTO)
+		return (1);
+
+	return ((fb_pmem_cpu() & (1 << mode)) != 0);
+}
+
+/*
+ * Picks the mode to use for a store of len bytes. FB_PMEM_AUTO uses
+ * non-temporal stores for stores of at least FB_PMEM_NTSTORE_MIN bytes,
+ * and otherwise regular stores with the best flush the CPU has.
+ * Returns -1 if an explicitly requested mode is not supported.
+ */
+int
+fb_pmem_resolve(int mode, size_t len)
+{
+	if (mode != FB_PMEM_AUTO)
+		return (fb_pmem_supported(mode) ? mode : -1);
+
+	if ((len >= FB_PMEM_NTSTORE_MIN) && fb_pmem_supported(FB_PMEM_NTSTORE))
+		return (FB_PMEM_NTSTORE);
+	if (fb_pmem_supported(FB_PMEM_CLWB))
+		return (FB_PMEM_CLWB);
+	if (fb_pmem_supported(FB_PMEM_CLFLUSHOPT))
+		return (FB_PMEM_CLFLUSHOPT);
+	if (fb_pmem_supported(FB_PMEM_CLFLUSH))
+		return (FB_PMEM_CLFLUSH);
+
+	return (FB_PMEM_MSYNC);
+}
+
+#ifdef FB_PMEM_X86
+
+__attribute__((target("clwb")))
+static void
+fb_pmem_clwb(caddr_t addr, size_t len)
+{
+	uintptr_t line = (uintptr_t)addr & ~((uintptr_t)FB_PMEM_LINE - 1);
+
+	for (; line < (uintptr_t)addr + len; line += FB_PMEM_LINE)
+		_mm_clwb((void *)line);
+}
+
+__attribute__((target("clflushopt")))
+static void
+fb_pmem_clflushopt(caddr_t addr, size_t len)
+{
+	uintptr_t line = (uintptr_t)addr & ~((uintptr_t)FB_PMEM_LINE - 1);
+
+	for (; line < (uintptr_t)addr + len; line += FB_PMEM_LINE)
+		_mm_clflushopt((void *)line);
+}
+
+static void
+fb_pmem_clflush(caddr_t addr, size_t len)
+{
+	uintptr_t line = (uintptr_t)addr & ~((uintptr_t)FB_PMEM_LINE - 1);
+
+	for (; line < (uintptr_t)addr + len; line += FB_PMEM_LINE)
+		_mm_clflush((void *)line);
+}
+
+/*
+ * Flushes the lines of a range written with regular stores, using the
+ * best instruction the CPU has. Used for the edges of non-temporal
+ * copies.
+ */
+static void
+fb_pmem_flush_lines(caddr_t addr, size_t len)
+{
+	if (len == 0)
+		return;
+
+	if (fb_pmem_supported(FB_PMEM_CLWB))
+		fb_pmem_clwb(addr, len);
+	else if (fb_pmem_supported(FB_PMEM_CLFLUSHOPT))
+		fb_pmem_clflushopt(addr, len);
+	else
+		fb_pmem_clflush(addr, len);
+}
+
+/*
+ * Splits a non-temporal copy of len bytes to dst into a head up to the
+ * first line boundary, a body of whole lines and a tail. The head and
+ * tail are written with regular stores and need flushing.
+ */
+static void
+fb_pmem_edges(caddr_t dst, size_t len, size_t *headp, size_t *bodyp)
+{
+	size_t head;
+
+	head = (FB_PMEM_LINE - ((uintptr_t)dst & (FB_PMEM_LINE - 1))) &
+	    (FB_PMEM_LINE - 1);
+	if (head > len)
+		head = len;
+
+	*headp = head;
+	*bodyp = (len - head) & ~((size_t)FB_PMEM_LINE - 1);
+}
+
+/*
+ * Non-temporal copy of whole cache lines to a line aligned dst.
+ */
+__attribute__((target("avx")))
+static void
+fb_pmem_stream_avx(caddr_t dst, caddr_t src, size_t len)
+{
+	__m256i *d = (__m256i *)dst;
+	__m256i *s = (__m256i *)src;
+
+	for (; len > 0; len -= FB_PMEM_LINE, d += 2, s += 2) {
+		__m256i a = _mm256_loadu_si256(s);
+		__m256i b = _mm256_loadu_si256(s + 1);
+
+		_mm256_stream_si256(d, a);
+		_mm256_stream_si256(d + 1, b);
+	}
+}
+
+static void
+fb_pmem_stream_sse2(caddr_t dst, caddr_t src, size_t len)
+{
+	__m128i *d = (__m128i *)dst;
+	__m128i *s = (__m128i *)src;
+
+	for (; len > 0; len -= FB_PMEM_LINE, d += 4, s += 4) {
+		__m128i a = _mm_loadu_si128(s);
+		__m128i b = _mm_loadu_si128(s + 1);
+		__m128i c = _mm_loadu_si128(s + 2);
+		__m128i e = _mm_loadu_si128(s + 3);
+
+		_mm_stream_si128(d, a);
+		_mm_stream_si128(d + 1, b);
+		_mm_stream_si128(d + 2, c);
+		_mm_stream_si128(d + 3, e);
+	}
+}
+
+#endif /* FB_PMEM_X86 */
+
+/*
+ * Copies len bytes from src to dst, a persistent memory mapping, with
+ * the stores of the given, resolved, mode. The copy is not persistent
+ * until fb_pmem_flush() has been called on the same range.
+ */
+void
+fb_pmem_copy(int mode, caddr_t dst, caddr_t src, size_t len)
+{
+#ifdef FB_PMEM_X86
+	size_t head, body;
+
+	if (mode == FB_PMEM_NTSTORE) {
+		fb_pmem_edges(dst, len, &head, &body);
+
+		(void) memcpy(dst, src, head);
+
+		if (fb_pmem_avx)
+			fb_pmem_stream_avx(dst + head, src + head, body);
+		else
+			fb_pmem_stream_sse2(dst + head, src + head, body);
+
+		head += body;
+		(void) memcpy(dst + head, src + head, len - head);
+		return;
+	}
+#endif /* FB_PMEM_X86 */
+
+	(void) memcpy(dst, src, len);
+}
+
+/*
+ * Makes a range written by fb_pmem_copy() with the same mode
+ * persistent: writes back or flushes its cache lines and fences. After
+ * non-temporal stores only the partial lines at either end, written
+ * with regular stores, are flushed before the fence. Returns 0 on
+ * success, -1 with errno set if msync() fails.
+ */
+int
+fb_pmem_flush(int mode, caddr_t dst, size_t len)
+{
+	size_t pad;
+#ifdef FB_PMEM_X86
+	size_t head, body;
+#endif
+
+	switch (mode) {
+#ifdef FB_PMEM_X86
+	case FB_PMEM_NTSTORE:
+		fb_pmem_edges(dst, len, &head, &body);
+		fb_pmem_flush_lines(dst, head);
+		head += body;
+		fb_pmem_flush_lines(dst + head, len - head);
+		_mm_sfence();
+		return (0);
+	case FB_PMEM_CLWB:
+		fb_pmem_clwb(dst, len);
+		_mm_sfence();
+		return (0);
+	case FB_PMEM_CLFLUSHOPT:
+		fb_pmem_clflushopt(dst, len);
+		_mm_sfence();
+		return (0);
+	case FB_PMEM_CLFLUSH:
+		/* clflush is ordered with respect to stores */
+		fb_pmem_clflush(dst, len);
+		return (0);
+#endif /* FB_PMEM_X86 */
+	default:
+		/* msync() wants a page aligned address */
+		pad = (uintptr_t)dst & (getpagesize() - 1);
+		return (msync(dst - pad, len + pad, MS_SYNC));
+	}
+}
@@ -0,0 +1,30 @@
+#ifndef _FB_PMEM_H
+#define	_FB_PMEM_H
+
+#include "filebench.h"
+
+/*
+ * Persistent memory store primitives, used to write into DAX mappings
+ * the way applications do: either with non-temporal stores that bypass
+ * the CPU caches, or with regular stores followed by a cache line write
+ * back or flush of every line written. Both are completed by a store
+ * fence. FB_PMEM_MSYNC falls back to msync() and is what is used where
+ * none of the instructions is available.
+ */
+#define	FB_PMEM_AUTO		0	/* best supported, by store size */
+#define	FB_PMEM_NTSTORE		1	/* non-temporal stores + sfence */
+#define	FB_PMEM_CLWB		2	/* stores + clwb + sfence */
+#define	FB_PMEM_CLFLUSHOPT	3	/* stores + clflushopt + sfence */
+#define	FB_PMEM_CLFLUSH		4	/* stores + clflush */
+#define	FB_PMEM_MSYNC		5	/* stores + msync() */
+
+/* stores at least this large default to non-temporal stores */
+#define	FB_PMEM_NTSTORE_MIN	256
+
+extern int fb_pmem_mode(char *name);
+extern int fb_pmem_supported(int mode);
+extern int fb_pmem_resolve(int mode, size_t len);
+extern void fb_pmem_copy(int mode, caddr_t dst, caddr_t src, size_t len);
+extern int fb_pmem_flush(int mode, caddr_t dst, size_t len);
+
+#endif	/* _FB_PMEM_H */
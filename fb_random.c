@@ -25,17 +25,188 @@
 
 #include <stdio.h>
 #include <fcntl.h>
+#include <string.h>
+#include <pthread.h>
 /* this definition prevents warning about
    using undefined round() function */
 #include <math.h>
 #include "filebench.h"
 #include "ipc.h"
 #include "gamma_dist.h"
-#include "cvars/mtwist/mtwist.h"
 
 /*
- * Generates a 64-bit random number using mtwist or from a provided random
- * variable "avd".
+ * Uniform random numbers come from a xoshiro256** generator per thread,
+ * rather than from one generator shared, and raced on, by all threads.
+ * Worker threads use the state in their threadflow, seeded from the run
+ * seed and their tf_utid, so that a run draws the same numbers every
+ * time. Other threads, such as those creating filesets, get a private
+ * state on first use, seeded from the run seed and the order in which
+ * they first asked for one.
+ */
+static pthread_key_t fb_random_key;
+static pthread_once_t fb_random_once = PTHREAD_ONCE_INIT;
+static uint64_t fb_random_streams;	/* private states handed out */
+
+static void
+fb_random_destroy(void *arg)
+{
+	fb_rand_t *rand = arg;
+
+	if (rand->fr_private)
+		free(rand);
+}
+
+static void
+fb_random_key_init(void)
+{
+	(void) pthread_key_create(&fb_random_key, fb_random_destroy);
+}
+
+/*
+ * splitmix64, used to expand a seed into a generator state.
+ */
+static uint64_t
+fb_random_splitmix(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return (z ^ (z >> 31));
+}
+
+/*
+ * Seeds a generator for the given stream of the run with the given seed.
+ * Different streams of the same seed give unrelated sequences.
+ */
+void
+fb_random_seed(fb_rand_t *rand, uint64_t seed, uint64_t stream)
+{
+	uint64_t x;
+	int i;
+
+	x = seed ^ fb_random_splitmix(&stream);
+	for (i = 0; i < 4; i++)
+		rand->fr_s[i] = fb_random_splitmix(&x);
+	rand->fr_private = 0;
+}
+
+/*
+ * Makes the calling thread draw its random numbers from rand.
+ */
+void
+fb_random_thread(fb_rand_t *rand)
+{
+	(void) pthread_once(&fb_random_once, fb_random_key_init);
+	(void) pthread_setspecific(fb_random_key, rand);
+}
+
+/*
+ * Returns the calling thread's generator, setting up a private one for
+ * threads that have not been given one.
+ */
+static fb_rand_t *
+fb_random_get(void)
+{
+	fb_rand_t *rand;
+
+	(void) pthread_once(&fb_random_once, fb_random_key_init);
+
+	if ((rand = pthread_getspecific(fb_random_key)) == NULL) {
+		if ((rand = malloc(sizeof (fb_rand_t))) == NULL) {
+			filebench_log(LOG_ERROR, "Out of memory for random "
+			    "number generator");
+			filebench_shutdown(1);
+		}
+		/* streams from the top, to stay clear of the tf_utids */
+		fb_random_seed(rand, filebench_shm->shm_rand_seed, UINT64_MAX -
+		    __sync_fetch_and_add(&fb_random_streams, 1));
+		rand->fr_private = 1;
+		(void) pthread_setspecific(fb_random_key, rand);
+	}
+
+	return (rand);
+}
+
+static inline uint64_t
+fb_random_rotl(uint64_t x, int k)
+{
+	return ((x << k) | (x >> (64 - k)));
+}
+
+/*
+ * Returns the next number of a xoshiro256** generator.
+ */
+static inline uint64_t
+fb_random_next(fb_rand_t *rand)
+{
+	uint64_t *s = rand->fr_s;
+	uint64_t result = fb_random_rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = fb_random_rotl(s[3], 45);
+
+	return (result);
+}
+
+/*
+ * Reduces x, a generator output, to a number uniformly distributed in
+ * [0; n), n > 0, without the bias of a plain modulo: Lemire's multiply
+ * and reject method where 128 bit products are available, rejection of
+ * the incomplete last multiple of n otherwise. bound is
+ * FB_RANDOM_BOUND(n), which a batch of reductions computes only once.
+ */
+#ifdef __SIZEOF_INT128__
+#define	FB_RANDOM_BOUND(n)	(-(n) % (n))	/* lowest low half kept */
+
+static inline uint64_t
+fb_random_reduce(fb_rand_t *rand, uint64_t x, uint64_t n, uint64_t bound)
+{
+	unsigned __int128 m = (unsigned __int128)x * n;
+
+	while ((uint64_t)m < bound)
+		m = (unsigned __int128)fb_random_next(rand) * n;
+
+	return ((uint64_t)(m >> 64));
+}
+#else
+#define	FB_RANDOM_BOUND(n)	(UINT64_MAX - (UINT64_MAX % (n) + 1) % (n))
+
+static inline uint64_t
+fb_random_reduce(fb_rand_t *rand, uint64_t x, uint64_t n, uint64_t bound)
+{
+	while (x > bound)
+		x = fb_random_next(rand);
+
+	return (x % n);
+}
+#endif
+
+/*
+ * Returns a number uniformly distributed in [0; n), n > 0.
+ */
+static uint64_t
+fb_random_below(fb_rand_t *rand, uint64_t n)
+{
+	uint64_t x = fb_random_next(rand);
+
+#ifdef __SIZEOF_INT128__
+	/* only a low half below n can need rejecting: skip the division */
+	if (x * n >= n)
+		return ((uint64_t)(((unsigned __int128)x * n) >> 64));
+#endif
+
+	return (fb_random_reduce(rand, x, n, FB_RANDOM_BOUND(n)));
+}
+
+/*
+ * Generates a 64-bit random number using the thread's generator or from
+ * a provided random variable "avd".
  *
  * Returned random number "randp" is clipped by the "max" value and rounded off
  * by the "round" value.  Returns 0 on success, shuts down Filebench on
@@ -47,29 +218,35 @@ fb_random64(uint64_t *randp, uint64_t max, uint64_t round, avd_t avd)
 	double random_normalized;
 	uint64_t random = 0;
 
-	if (avd) {
-		/* get it from the random variable */
-		if (!AVD_IS_RANDOM(avd)) {
-			/* trying to get random value not from
-				random variable. That's a clear error. */
-			filebench_log(LOG_ERROR, "filebench_randomno64: trying"
-			" to get a random value from not a random variable");
-			filebench_shutdown(1);
-			/* NOT REACHABLE */
-		} else {
-			random = avd_get_int(avd);
-		}
+	if (!avd) {
+		/*
+		 * If round is not zero, then caller will get a multiple of
+		 * round in the range [0; max - round].  This allows the
+		 * caller to use this function, for example, to obtain a
+		 * pointer in an allocated memory region of [0; max] and
+		 * read/write round bytes safely starting at this pointer.
+		 * Otherwise the range is [0; max).
+		 */
+		if (round)
+			max /= round;
+		*randp = max ? fb_random_below(fb_random_get(), max) : 0;
+		if (round)
+			*randp *= round;
+		return;
+	}
+
+	/* get it from the random variable */
+	if (!AVD_IS_RANDOM(avd)) {
+		/* trying to get random value not from
+			random variable. That's a clear error. */
+		filebench_log(LOG_ERROR, "filebench_randomno64: trying"
+		" to get a random value from not a random variable");
+		filebench_shutdown(1);
+		/* NOT REACHABLE */
 	} else {
-		random = mt_llrand();
+		random = avd_get_int(avd);
 	}
 
-	/*
-	 * If round is not zero, then caller will get a random number in the
-	 * range [0; max - round].  This allows the caller to use this
-	 * function, for example, to obtain a pointer in an allocated memory
-	 * region of [0; max] and read/write round bytes safely starting
-	 * at this pointer.
-	 */
 	max = max - round;
 
 	random_normalized = (double)random / UINT64_MAX;
@@ -83,6 +260,68 @@ fb_random64(uint64_t *randp, uint64_t max, uint64_t round, avd_t avd)
 	*randp = random;
 }
 
+/*
+ * Refills a ring for fb_random_ring() or fb_random_avdring() and returns
+ * its first entry. The generator outputs are drawn in one loop and then
+ * reduced to the range in another, with the rejection bound worked out
+ * once per batch. A range is only batched once it is asked for twice in
+ * a row, so that flowops whose range changes on every call, such as
+ * random I/O to files of different sizes, don't draw numbers that would
+ * be thrown away; such calls draw one number at a time.
+ */
+uint64_t
+fb_random_refill(fb_randring_t *ring, uint64_t max, uint64_t round,
+    avd_t avd)
+{
+	uint64_t *val = ring->rr_val;
+	uint64_t n, bound;
+	fb_rand_t *rand;
+	int i;
+
+	if (avd) {
+		for (i = 0; i < FB_RANDRING_SIZE; i++)
+			val[i] = avd_get_int(avd);
+		goto done;
+	}
+
+	if ((ring->rr_avd != NULL) || (ring->rr_max != max) ||
+	    (ring->rr_round != round)) {
+		ring->rr_avd = NULL;
+		ring->rr_max = max;
+		ring->rr_round = round;
+		ring->rr_next = FB_RANDRING_SIZE;
+		fb_random64(&n, max, round, NULL);
+		return (n);
+	}
+
+	n = round ? max / round : max;
+	if (n == 0) {
+		(void) memset(val, 0, sizeof (ring->rr_val));
+		goto done;
+	}
+
+	rand = fb_random_get();
+	for (i = 0; i < FB_RANDRING_SIZE; i++)
+		val[i] = fb_random_next(rand);
+
+	bound = FB_RANDOM_BOUND(n);
+	for (i = 0; i < FB_RANDRING_SIZE; i++)
+		val[i] = fb_random_reduce(rand, val[i], n, bound);
+
+	if (round) {
+		for (i = 0; i < FB_RANDRING_SIZE; i++)
+			val[i] *= round;
+	}
+
+done:
+	ring->rr_avd = avd;
+	ring->rr_max = max;
+	ring->rr_round = round;
+	ring->rr_next = 1;
+
+	return (val[0]);
+}
+
 /*
  * Same as filebench_randomno64, but for 32 bit integers.
  */
@@ -100,17 +339,120 @@ fb_random32(uint32_t *randp,
 }
 
 /*
- * Same as filebench_randomno64, but for probability [0-1].
+ * Same as filebench_randomno64, but for probability [0-1).
  */
 static double
 fb_random_probability()
 {
-	uint64_t randnum;
+	/* the top 53 bits, as a double in [0; 1) */
+	return ((double)(fb_random_next(fb_random_get()) >> 11) *
+	    (1.0 / 9007199254740992.0));
+}
+
+/*
+ * Builds an alias table (Vose's method) for picking one of n outcomes
+ * with probabilities proportional to the given weights, at least one of
+ * which must be non-zero. Returns NULL if it could not be allocated.
+ */
+fb_alias_t *
+fb_alias_alloc(uint64_t *weights, int n)
+{
+	fb_alias_t *table;
+	double *scaled;
+	int *small, *large;
+	int nsmall = 0, nlarge = 0;
+	double total = 0.0;
+	int i, s, l;
+
+	table = malloc(sizeof (fb_alias_t));
+	scaled = malloc(n * sizeof (double));
+	small = malloc(n * sizeof (int));
+	large = malloc(n * sizeof (int));
+	if (table != NULL) {
+		table->fa_n = n;
+		table->fa_prob = malloc(n * sizeof (double));
+		table->fa_alias = malloc(n * sizeof (int));
+	}
+	if ((table == NULL) || (scaled == NULL) || (small == NULL) ||
+	    (large == NULL) || (table->fa_prob == NULL) ||
+	    (table->fa_alias == NULL)) {
+		fb_alias_free(table);
+		free(scaled);
+		free(small);
+		free(large);
+		return (NULL);
+	}
+
+	for (i = 0; i < n; i++)
+		total += (double)weights[i];
+
+	/* scale to a mean of 1, splitting into under- and overfull */
+	for (i = 0; i < n; i++) {
+		scaled[i] = (double)weights[i] * n / total;
+		if (scaled[i] < 1.0)
+			small[nsmall++] = i;
+		else
+			large[nlarge++] = i;
+	}
+
+	/* top up each underfull column from an overfull one */
+	while ((nsmall > 0) && (nlarge > 0)) {
+		s = small[--nsmall];
+		l = large[--nlarge];
+		table->fa_prob[s] = scaled[s];
+		table->fa_alias[s] = l;
+		scaled[l] -= 1.0 - scaled[s];
+		if (scaled[l] < 1.0)
+			small[nsmall++] = l;
+		else
+			large[nlarge++] = l;
+	}
+
+	/* what is left is full, give or take rounding */
+	while (nlarge > 0) {
+		l = large[--nlarge];
+		table->fa_prob[l] = 1.0;
+		table->fa_alias[l] = l;
+	}
+	while (nsmall > 0) {
+		s = small[--nsmall];
+		table->fa_prob[s] = 1.0;
+		table->fa_alias[s] = s;
+	}
+
+	free(scaled);
+	free(small);
+	free(large);
+
+	return (table);
+}
+
+void
+fb_alias_free(fb_alias_t *table)
+{
+	if (table == NULL)
+		return;
+
+	free(table->fa_prob);
+	free(table->fa_alias);
+	free(table);
+}
+
+/*
+ * Picks an outcome from the alias table with the given generator, in
+ * constant time: a uniform column, then the column or its alias.
+ */
+int
+fb_alias_pick(fb_rand_t *rand, fb_alias_t *table)
+{
+	int i;
+	double u;
 
-	fb_random64(&randnum, UINT64_MAX, 0, NULL);
+	i = (int)fb_random_below(rand, table->fa_n);
+	u = (double)(fb_random_next(rand) >> 11) *
+	    (1.0 / 9007199254740992.0);
 
-	/* convert to 0-1 probability */
-	return (double)randnum / (double)(UINT64_MAX);
+	return ((u < table->fa_prob[i]) ? i : table->fa_alias[i]);
 }
 
 /****************************************
@@ -94,11 +94,79 @@ typedef struct randdist {
 #define	RAND_PARAM_GAMMA	6
 #define	RAND_PARAM_ROUND	7
 
+/*
+ * State of a xoshiro256** generator, from which fb_random64() draws
+ * uniform random numbers. Each thread has its own.
+ */
+typedef struct fb_rand {
+	uint64_t	fr_s[4];
+	int		fr_private;	/* allocated by fb_random_get() */
+} fb_rand_t;
+
+/*
+ * A ring of random numbers drawn in bulk, for a flowop to take one
+ * from per operation: offsets in [0; max - round] for a given max and
+ * round, or values of a random variable.
+ */
+#define	FB_RANDRING_SIZE	16
+
+typedef struct fb_randring {
+	avd_t		rr_avd;		/* random variable, or NULL */
+	uint64_t	rr_max;		/* else the range drawn for */
+	uint64_t	rr_round;
+	int		rr_next;	/* next entry to hand out */
+	uint64_t	rr_val[FB_RANDRING_SIZE];
+} fb_randring_t;
+
+/*
+ * Alias table for picking one of fa_n weighted outcomes in constant
+ * time.
+ */
+typedef struct fb_alias {
+	int		fa_n;
+	double		*fa_prob;	/* chance of keeping a column */
+	int		*fa_alias;	/* else the outcome it stands for */
+} fb_alias_t;
+
 /* Function declarations */
+extern void fb_random_seed(fb_rand_t *, uint64_t, uint64_t);
+extern uint64_t fb_random_refill(fb_randring_t *, uint64_t, uint64_t, avd_t);
+extern void fb_random_thread(fb_rand_t *);
 extern void fb_random64(uint64_t *, uint64_t, uint64_t, avd_t);
 extern void fb_random32(uint32_t *, uint32_t, uint32_t, avd_t);
+extern fb_alias_t *fb_alias_alloc(uint64_t *, int);
+extern void fb_alias_free(fb_alias_t *);
+extern int fb_alias_pick(fb_rand_t *, fb_alias_t *);
 
 extern randdist_t *randdist_alloc(void);
 extern void randdist_init(randdist_t *rndp);
 
+/*
+ * Returns what fb_random64() would for max and round, from the ring.
+ */
+static inline uint64_t
+fb_random_ring(fb_randring_t *ring, uint64_t max, uint64_t round)
+{
+	if ((ring->rr_next < FB_RANDRING_SIZE) && (ring->rr_avd == NULL) &&
+	    (ring->rr_max == max) && (ring->rr_round == round))
+		return (ring->rr_val[ring->rr_next++]);
+
+	return (fb_random_refill(ring, max, round, NULL));
+}
+
+/*
+ * Returns the value of avd, from the ring if it is a random variable.
+ */
+static inline uint64_t
+fb_random_avdring(fb_randring_t *ring, avd_t avd)
+{
+	if (!AVD_IS_RANDOM(avd))
+		return (avd_get_int(avd));
+
+	if ((ring->rr_next < FB_RANDRING_SIZE) && (ring->rr_avd == avd))
+		return (ring->rr_val[ring->rr_next++]);
+
+	return (fb_random_refill(ring, 0, 0, avd));
+}
+
 #endif	/* _FB_RANDOM_H */
@@ -0,0 +1,1182 @@
+/*
+ * io_uring file system plug-in. Reads, writes, fsync, fdatasync,
+ * sync_file_range, open, close and stat of the local file system are
+ * issued through a per-thread io_uring instead of plain system calls.
+ * Everything else, and any operation the running kernel's io_uring
+ * doesn't support, goes to the local file system plug-in.
+ *
+ * Each thread gets its own ring on first use, sized by the "iodepth"
+ * of "enable io_uring" and optionally serviced by a kernel SQPOLL thread.
+ * Files opened by a thread are added to its ring's registered file
+ * table, and the thread's tf_mem is registered as a fixed buffer, so
+ * I/O to and from tf_mem avoids the per-request file and page lookups.
+ *
+ * The uringread and uringwrite flowops submit without waiting, keeping
+ * up to iodepth requests in flight, and uringwait reaps them, in the same
+ * way as aiowrite and aiowait do with POSIX AIO.
+ *
+ * The rings are driven with the raw system calls, so liburing is not
+ * needed to build filebench.
+ */
+
+#include "config.h"
+#include "filebench.h"
+#include "flowop.h"
+#include "threadflow.h"
+#include "fsplug.h"
+#include "fb_random.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+
+/*
+ * IORING_FEAT_RW_CUR_POS only tells that the headers are recent enough
+ * for everything used here; whether the running kernel has the feature
+ * is checked when each ring is set up.
+ */
+#if defined(__NR_io_uring_setup) && defined(STATX_BASIC_STATS)
+#include <linux/io_uring.h>
+#ifdef IORING_FEAT_RW_CUR_POS
+#define	FB_IO_URING
+#endif /* IORING_FEAT_RW_CUR_POS */
+#endif
+
+#ifdef FB_IO_URING
+
+#define	FB_URING_NFILES		1024	/* registered file table slots */
+#define	FB_URING_SYNC		1	/* user_data of synchronous requests */
+
+typedef struct fb_uring {
+	int		fur_fd;		/* ring file descriptor */
+	uint_t		fur_entries;	/* submission queue entries */
+	int		fur_depth;	/* max async requests in flight */
+	int		fur_inflight;	/* async requests not yet reaped */
+	int		fur_sqpoll;	/* serviced by a kernel SQ thread */
+	int		fur_curpos;	/* offset -1 reads at the file position */
+	uint_t		*fur_sqhead;
+	uint_t		*fur_sqtail;
+	uint_t		*fur_sqmask;
+	uint_t		*fur_sqflags;
+	uint_t		*fur_sqarray;
+	struct io_uring_sqe *fur_sqes;
+	uint_t		*fur_cqhead;
+	uint_t		*fur_cqtail;
+	uint_t		*fur_cqmask;
+	struct io_uring_cqe *fur_cqes;
+	void		*fur_sqring;
+	size_t		fur_sqringsz;
+	void		*fur_cqring;
+	size_t		fur_cqringsz;
+	size_t		fur_sqessz;
+	int		fur_files;	/* file table is registered */
+	char		fur_fixed[FB_URING_NFILES]; /* fd is in file table */
+	caddr_t		fur_buf;	/* registered buffer, or NULL */
+	size_t		fur_buflen;
+	struct statx	*fur_stx;	/* statx results of fb_uring_statxv() */
+	char		fur_op[IORING_OP_LAST]; /* supported opcodes */
+} fb_uring_t;
+
+/* marks threads whose ring could not be set up */
+static fb_uring_t fb_uring_none;
+
+static pthread_key_t fb_uring_key;
+static pthread_once_t fb_uring_once = PTHREAD_ONCE_INIT;
+
+#endif /* FB_IO_URING */
+
+/* the local file system vector, for everything not done by the ring */
+static fsplug_func_t fb_uring_lfs;
+
+#ifdef FB_IO_URING
+
+static fsplug_func_t fb_uring_funcs;
+
+static int fb_uring_reap(fb_uring_t *, int, uint64_t *, int *);
+
+/*
+ * Unmaps and closes a thread's ring. Called at thread exit through the
+ * ring's thread specific data key, after the thread has accounted for
+ * its asynchronous requests, so any still in flight are only waited for
+ * and dropped before the ring goes away under them.
+ */
+static void
+fb_uring_destroy(void *arg)
+{
+	fb_uring_t *ring = arg;
+	uint64_t data;
+	int res;
+
+	if (ring == &fb_uring_none)
+		return;
+
+	for (; ring->fur_inflight > 0; ring->fur_inflight--) {
+		if (fb_uring_reap(ring, TRUE, &data, &res) < 0)
+			break;
+	}
+
+	(void) munmap(ring->fur_sqes, ring->fur_sqessz);
+	if (ring->fur_cqring != ring->fur_sqring)
+		(void) munmap(ring->fur_cqring, ring->fur_cqringsz);
+	(void) munmap(ring->fur_sqring, ring->fur_sqringsz);
+	(void) close(ring->fur_fd);
+	free(ring->fur_stx);
+	free(ring);
+}
+
+static void
+fb_uring_key_init(void)
+{
+	(void) pthread_key_create(&fb_uring_key, fb_uring_destroy);
+}
+
+/*
+ * Finds out which opcodes the kernel supports, so that requests it
+ * doesn't know about are sent to the local file system plug-in instead.
+ */
+static void
+fb_uring_probe(fb_uring_t *ring)
+{
+	struct io_uring_probe *probe;
+	size_t size;
+	int i;
+
+	size = sizeof (*probe) + 256 * sizeof (struct io_uring_probe_op);
+	if ((probe = calloc(1, size)) == NULL)
+		return;
+
+	if (syscall(__NR_io_uring_register, ring->fur_fd,
+	    IORING_REGISTER_PROBE, probe, 256) == 0) {
+		for (i = 0; i < probe->ops_len; i++) {
+			int op = probe->ops[i].op;
+
+			if ((op < IORING_OP_LAST) &&
+			    (probe->ops[i].flags & IO_URING_OP_SUPPORTED))
+				ring->fur_op[op] = 1;
+		}
+	}
+
+	free(probe);
+}
+
+/*
+ * Registers an empty file table of FB_URING_NFILES slots. Files are put
+ * in the slot matching their descriptor number when they are opened.
+ */
+static void
+fb_uring_register_files(fb_uring_t *ring)
+{
+	int fds[FB_URING_NFILES];
+	int i;
+
+	for (i = 0; i < FB_URING_NFILES; i++)
+		fds[i] = -1;
+
+	if (syscall(__NR_io_uring_register, ring->fur_fd,
+	    IORING_REGISTER_FILES, fds, FB_URING_NFILES) == 0)
+		ring->fur_files = 1;
+}
+
+/*
+ * Creates and maps a ring for the calling thread. Falls back to a ring
+ * without SQPOLL if the kernel refuses one. Returns NULL on failure.
+ */
+static fb_uring_t *
+fb_uring_setup(void)
+{
+	struct io_uring_params p;
+	fb_uring_t *ring;
+	int depth;
+
+	if ((ring = calloc(1, sizeof (fb_uring_t))) == NULL)
+		return (NULL);
+
+	depth = MAX(filebench_shm->shm_uring_iodepth, 1);
+
+	(void) memset(&p, 0, sizeof (p));
+	if (filebench_shm->shm_uring_sqpoll) {
+		p.flags = IORING_SETUP_SQPOLL;
+		p.sq_thread_idle = 1000;
+	}
+
+	/* room for the async requests plus a synchronous one */
+	ring->fur_fd = syscall(__NR_io_uring_setup, depth + 1, &p);
+	if ((ring->fur_fd < 0) && (p.flags & IORING_SETUP_SQPOLL)) {
+		filebench_log(LOG_INFO, "io_uring SQPOLL not available: %s, "
+		    "submitting from the thread", strerror(errno));
+		(void) memset(&p, 0, sizeof (p));
+		ring->fur_fd = syscall(__NR_io_uring_setup, depth + 1, &p);
+	}
+
+	if (ring->fur_fd < 0) {
+		filebench_log(LOG_ERROR, "io_uring setup failed: %s",
+		    strerror(errno));
+		free(ring);
+		return (NULL);
+	}
+
+	ring->fur_entries = p.sq_entries;
+	ring->fur_depth = depth;
+	ring->fur_sqpoll = (p.flags & IORING_SETUP_SQPOLL) != 0;
+	ring->fur_curpos = (p.features & IORING_FEAT_RW_CUR_POS) != 0;
+
+	ring->fur_sqringsz = p.sq_off.array + p.sq_entries * sizeof (uint_t);
+	ring->fur_cqringsz = p.cq_off.cqes +
+	    p.cq_entries * sizeof (struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->fur_sqringsz = ring->fur_cqringsz =
+		    MAX(ring->fur_sqringsz, ring->fur_cqringsz);
+	ring->fur_sqessz = p.sq_entries * sizeof (struct io_uring_sqe);
+
+	ring->fur_sqring = mmap(NULL, ring->fur_sqringsz,
+	    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	    ring->fur_fd, IORING_OFF_SQ_RING);
+	if (ring->fur_sqring == MAP_FAILED)
+		goto fail;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->fur_cqring = ring->fur_sqring;
+	} else {
+		ring->fur_cqring = mmap(NULL, ring->fur_cqringsz,
+		    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		    ring->fur_fd, IORING_OFF_CQ_RING);
+		if (ring->fur_cqring == MAP_FAILED) {
+			(void) munmap(ring->fur_sqring, ring->fur_sqringsz);
+			goto fail;
+		}
+	}
+
+	ring->fur_sqes = mmap(NULL, ring->fur_sqessz,
+	    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	    ring->fur_fd, IORING_OFF_SQES);
+	if (ring->fur_sqes == MAP_FAILED) {
+		if (ring->fur_cqring != ring->fur_sqring)
+			(void) munmap(ring->fur_cqring, ring->fur_cqringsz);
+		(void) munmap(ring->fur_sqring, ring->fur_sqringsz);
+		goto fail;
+	}
+
+	ring->fur_sqhead = (uint_t *)((char *)ring->fur_sqring +
+	    p.sq_off.head);
+	ring->fur_sqtail = (uint_t *)((char *)ring->fur_sqring +
+	    p.sq_off.tail);
+	ring->fur_sqmask = (uint_t *)((char *)ring->fur_sqring +
+	    p.sq_off.ring_mask);
+	ring->fur_sqflags = (uint_t *)((char *)ring->fur_sqring +
+	    p.sq_off.flags);
+	ring->fur_sqarray = (uint_t *)((char *)ring->fur_sqring +
+	    p.sq_off.array);
+	ring->fur_cqhead = (uint_t *)((char *)ring->fur_cqring +
+	    p.cq_off.head);
+	ring->fur_cqtail = (uint_t *)((char *)ring->fur_cqring +
+	    p.cq_off.tail);
+	ring->fur_cqmask = (uint_t *)((char *)ring->fur_cqring +
+	    p.cq_off.ring_mask);
+	ring->fur_cqes = (struct io_uring_cqe *)((char *)ring->fur_cqring +
+	    p.cq_off.cqes);
+
+	fb_uring_probe(ring);
+	fb_uring_register_files(ring);
+
+	filebench_log(LOG_DEBUG_IMPL, "io_uring with %u entries%s set up",
+	    ring->fur_entries, ring->fur_sqpoll ? " and SQPOLL" : "");
+
+	return (ring);
+
+fail:
+	filebench_log(LOG_ERROR, "io_uring mmap failed: %s", strerror(errno));
+	(void) close(ring->fur_fd);
+	free(ring);
+	return (NULL);
+}
+
+/*
+ * Returns the calling thread's ring, setting it up on first use, or NULL
+ * if the thread can't have one, in which case the caller falls back to
+ * the local file system plug-in.
+ */
+static fb_uring_t *
+fb_uring_get(void)
+{
+	fb_uring_t *ring;
+
+	(void) pthread_once(&fb_uring_once, fb_uring_key_init);
+
+	if ((ring = pthread_getspecific(fb_uring_key)) == NULL) {
+		if ((ring = fb_uring_setup()) == NULL)
+			ring = &fb_uring_none;
+		(void) pthread_setspecific(fb_uring_key, ring);
+	}
+
+	return (ring == &fb_uring_none ? NULL : ring);
+}
+
+/*
+ * Returns the thread's ring if it supports opcode op, NULL otherwise.
+ */
+static fb_uring_t *
+fb_uring_get_op(int op)
+{
+	fb_uring_t *ring = fb_uring_get();
+
+	return ((ring && ring->fur_op[op]) ? ring : NULL);
+}
+
+/*
+ * Returns a cleared submission queue entry. With SQPOLL the kernel
+ * thread may not have consumed earlier entries yet, so waits for room.
+ */
+static struct io_uring_sqe *
+fb_uring_get_sqe(fb_uring_t *ring)
+{
+	struct io_uring_sqe *sqe;
+	uint_t tail = *ring->fur_sqtail;
+	uint_t idx;
+
+	while (tail - __atomic_load_n(ring->fur_sqhead, __ATOMIC_ACQUIRE) >=
+	    ring->fur_entries)
+		(void) sched_yield();
+
+	idx = tail & *ring->fur_sqmask;
+	sqe = &ring->fur_sqes[idx];
+	(void) memset(sqe, 0, sizeof (*sqe));
+	ring->fur_sqarray[idx] = idx;
+
+	return (sqe);
+}
+
+/*
+ * Publishes the entry returned by the last fb_uring_get_sqe(), without
+ * telling the kernel about it yet.
+ */
+static void
+fb_uring_publish(fb_uring_t *ring)
+{
+	__atomic_store_n(ring->fur_sqtail, *ring->fur_sqtail + 1,
+	    __ATOMIC_RELEASE);
+}
+
+/*
+ * Tells the kernel about the last tosubmit published entries, also
+ * waiting for a completion if wait is set. Returns 0 on success, -1 on
+ * failure.
+ */
+static int
+fb_uring_enter(fb_uring_t *ring, uint_t tosubmit, int wait)
+{
+	uint_t flags = wait ? IORING_ENTER_GETEVENTS : 0;
+
+	if (ring->fur_sqpoll) {
+		tosubmit = 0;
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(ring->fur_sqflags, __ATOMIC_RELAXED) &
+		    IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		else if (!wait)
+			return (0);
+	}
+
+	while (syscall(__NR_io_uring_enter, ring->fur_fd, tosubmit,
+	    wait ? 1 : 0, flags, NULL, 0) < 0) {
+		if (errno != EINTR)
+			return (-1);
+		/* the entries were consumed, only the wait is left */
+		tosubmit = 0;
+		flags &= ~IORING_ENTER_SQ_WAKEUP;
+	}
+
+	return (0);
+}
+
+/*
+ * Publishes the entry returned by the last fb_uring_get_sqe() and tells
+ * the kernel about it, also waiting for a completion if wait is set.
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+fb_uring_submit(fb_uring_t *ring, int wait)
+{
+	fb_uring_publish(ring);
+
+	return (fb_uring_enter(ring, 1, wait));
+}
+
+/*
+ * Takes the next completion off the ring, waiting for one if wait is
+ * set. Returns 0 with the completion's user_data and result filled in,
+ * -1 if there is none.
+ */
+static int
+fb_uring_reap(fb_uring_t *ring, int wait, uint64_t *datap, int *resp)
+{
+	struct io_uring_cqe *cqe;
+	uint_t head = *ring->fur_cqhead;
+
+	while (head == __atomic_load_n(ring->fur_cqtail, __ATOMIC_ACQUIRE)) {
+		if (!wait)
+			return (-1);
+		if ((syscall(__NR_io_uring_enter, ring->fur_fd, 0, 1,
+		    IORING_ENTER_GETEVENTS, NULL, 0) < 0) && (errno != EINTR))
+			return (-1);
+	}
+
+	cqe = &ring->fur_cqes[head & *ring->fur_cqmask];
+	*datap = cqe->user_data;
+	*resp = cqe->res;
+	__atomic_store_n(ring->fur_cqhead, head + 1, __ATOMIC_RELEASE);
+
+	return (0);
+}
+
+/*
+ * Completes a reaped asynchronous request, whose user_data is its
+ * aiolist_t, recording its latency and bytes against the flowop that
+ * submitted it.
+ */
+static void
+fb_uring_async_done(fb_uring_t *ring, uint64_t data, int res)
+{
+	aiolist_t *aio = (aiolist_t *)(uintptr_t)data;
+
+	ring->fur_inflight--;
+
+	if (res < 0) {
+		filebench_log(LOG_ERROR, "io_uring async I/O failed: %s",
+		    strerror(-res));
+		res = 0;
+	}
+
+	flowop_aio_done(aio->al_flowop->fo_thread, aio, res);
+}
+
+/*
+ * Submits the prepared entry as a synchronous request and waits for it,
+ * accounting for any asynchronous completions reaped on the way.
+ * Returns the request's result, or -1 with errno set on failure.
+ */
+static int
+fb_uring_sync(fb_uring_t *ring, struct io_uring_sqe *sqe)
+{
+	uint64_t data;
+	int res;
+
+	sqe->user_data = FB_URING_SYNC;
+
+	if (fb_uring_submit(ring, TRUE) < 0)
+		return (-1);
+
+	/* CONSTCOND */
+	while (1) {
+		if (fb_uring_reap(ring, TRUE, &data, &res) < 0)
+			return (-1);
+		if (data == FB_URING_SYNC)
+			break;
+		fb_uring_async_done(ring, data, res);
+	}
+
+	if (res < 0) {
+		errno = -res;
+		return (-1);
+	}
+
+	return (res);
+}
+
+/*
+ * Fills in a read or write entry, using the registered file and buffer
+ * where possible. An offset of -1 means the file's current position.
+ */
+static void
+fb_uring_prep_rw(fb_uring_t *ring, struct io_uring_sqe *sqe, int write,
+    int fd, caddr_t iobuf, fbint_t iosize, off64_t offset)
+{
+	if (ring->fur_buf && (iobuf >= ring->fur_buf) &&
+	    (iobuf + iosize <= ring->fur_buf + ring->fur_buflen) &&
+	    ring->fur_op[write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED] &&
+	    (offset != -1)) {
+		sqe->opcode = write ? IORING_OP_WRITE_FIXED :
+		    IORING_OP_READ_FIXED;
+		sqe->buf_index = 0;
+	} else {
+		sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+	}
+
+	sqe->fd = fd;
+	if ((fd >= 0) && (fd < FB_URING_NFILES) && ring->fur_fixed[fd])
+		sqe->flags |= IOSQE_FIXED_FILE;
+	sqe->addr = (uint64_t)(uintptr_t)iobuf;
+	sqe->len = (uint32_t)iosize;
+	sqe->off = (uint64_t)offset;
+}
+
+/*
+ * Puts file descriptor fd in, or with file set to -1 takes it out of,
+ * the slot of the ring's registered file table that matches fd.
+ */
+static void
+fb_uring_fixfile(fb_uring_t *ring, int fd, int file)
+{
+	struct io_uring_files_update up;
+
+	if (!ring->fur_files || (fd < 0) || (fd >= FB_URING_NFILES))
+		return;
+
+	(void) memset(&up, 0, sizeof (up));
+	up.offset = fd;
+	up.fds = (uint64_t)(uintptr_t)&file;
+
+	if (syscall(__NR_io_uring_register, ring->fur_fd,
+	    IORING_REGISTER_FILES_UPDATE, &up, 1) == 1)
+		ring->fur_fixed[fd] = (file != -1);
+	else
+		ring->fur_fixed[fd] = 0;
+}
+
+/*
+ * Does a pread or, with an offset of -1, a read through the ring. Reads
+ * and writes at the file position go to the local file system plug-in
+ * if the kernel's ring can't do them.
+ */
+static int
+fb_uring_rw(int write, fb_fdesc_t *fd, caddr_t iobuf, fbint_t iosize,
+    off64_t offset)
+{
+	struct io_uring_sqe *sqe;
+	fb_uring_t *ring;
+
+	if (((ring = fb_uring_get_op(write ? IORING_OP_WRITE :
+	    IORING_OP_READ)) == NULL) ||
+	    ((offset == -1) && !ring->fur_curpos)) {
+		if (write)
+			return ((offset == -1) ?
+			    (*fb_uring_lfs.fsp_write)(fd, iobuf, iosize) :
+			    (*fb_uring_lfs.fsp_pwrite)(fd, iobuf, iosize,
+			    offset));
+		return ((offset == -1) ?
+		    (*fb_uring_lfs.fsp_read)(fd, iobuf, iosize) :
+		    (*fb_uring_lfs.fsp_pread)(fd, iobuf, iosize, offset));
+	}
+
+	sqe = fb_uring_get_sqe(ring);
+	fb_uring_prep_rw(ring, sqe, write, fd->fd_num, iobuf, iosize, offset);
+
+	return (fb_uring_sync(ring, sqe));
+}
+
+static int
+fb_uring_pread(fb_fdesc_t *fd, caddr_t iobuf, fbint_t iosize,
+    off64_t fileoffset)
+{
+	return (fb_uring_rw(FALSE, fd, iobuf, iosize, fileoffset));
+}
+
+static int
+fb_uring_read(fb_fdesc_t *fd, caddr_t iobuf, fbint_t iosize)
+{
+	return (fb_uring_rw(FALSE, fd, iobuf, iosize, -1));
+}
+
+static int
+fb_uring_pwrite(fb_fdesc_t *fd, caddr_t iobuf, fbint_t iosize,
+    off64_t fileoffset)
+{
+	return (fb_uring_rw(TRUE, fd, iobuf, iosize, fileoffset));
+}
+
+static int
+fb_uring_write(fb_fdesc_t *fd, caddr_t iobuf, fbint_t iosize)
+{
+	return (fb_uring_rw(TRUE, fd, iobuf, iosize, -1));
+}
+
+/*
+ * Does a preadv2 or pwritev2 through the ring, with the FB_RWF_* flags
+ * translated as for the local file system. An offset of -1 means the
+ * file's current position, which goes to the local file system plug-in
+ * if the kernel's ring can't do it.
+ */
+static int
+fb_uring_rwv(int write, fb_fdesc_t *fd, const struct iovec *iov,
+    int iovcnt, off64_t offset, int flags)
+{
+	struct io_uring_sqe *sqe;
+	fb_uring_t *ring;
+	int rwflags;
+
+	if (((ring = fb_uring_get_op(write ? IORING_OP_WRITEV :
+	    IORING_OP_READV)) == NULL) ||
+	    ((offset == -1) && !ring->fur_curpos)) {
+		if (write)
+			return ((*fb_uring_lfs.fsp_pwritev2)(fd, iov, iovcnt,
+			    offset, flags));
+		return ((*fb_uring_lfs.fsp_preadv2)(fd, iov, iovcnt,
+		    offset, flags));
+	}
+
+	if ((rwflags = fb_lfs_rwflags(flags)) < 0)
+		return (-1);
+
+	sqe = fb_uring_get_sqe(ring);
+	sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+	sqe->fd = fd->fd_num;
+	if ((fd->fd_num < FB_URING_NFILES) && ring->fur_fixed[fd->fd_num])
+		sqe->flags |= IOSQE_FIXED_FILE;
+	sqe->addr = (uint64_t)(uintptr_t)iov;
+	sqe->len = (uint32_t)iovcnt;
+	sqe->off = (uint64_t)offset;
+	sqe->rw_flags = rwflags;
+
+	return (fb_uring_sync(ring, sqe));
+}
+
+static int
+fb_uring_preadv2(fb_fdesc_t *fd, const struct iovec *iov, int iovcnt,
+    off64_t offset, int flags)
+{
+	return (fb_uring_rwv(FALSE, fd, iov, iovcnt, offset, flags));
+}
+
+static int
+fb_uring_pwritev2(fb_fdesc_t *fd, const struct iovec *iov, int iovcnt,
+    off64_t offset, int flags)
+{
+	return (fb_uring_rwv(TRUE, fd, iov, iovcnt, offset, flags));
+}
+
+/*
+ * Does an fsync, or an fdatasync if datasync is set, through the ring.
+ */
+static int
+fb_uring_fsync_common(fb_fdesc_t *fd, int datasync)
+{
+	struct io_uring_sqe *sqe;
+	fb_uring_t *ring;
+
+	if ((ring = fb_uring_get_op(IORING_OP_FSYNC)) == NULL)
+		return (datasync ? (*fb_uring_lfs.fsp_fdatasync)(fd) :
+		    (*fb_uring_lfs.fsp_fsync)(fd));
+
+	sqe = fb_uring_get_sqe(ring);
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->fd = fd->fd_num;
+	if ((fd->fd_num < FB_URING_NFILES) && ring->fur_fixed[fd->fd_num])
+		sqe->flags |= IOSQE_FIXED_FILE;
+	if (datasync)
+		sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+
+	return (fb_uring_sync(ring, sqe) < 0 ? -1 : 0);
+}
+
+static int
+fb_uring_fsync(fb_fdesc_t *fd)
+{
+	return (fb_uring_fsync_common(fd, FALSE));
+}
+
+static int
+fb_uring_fdatasync(fb_fdesc_t *fd)
+{
+	return (fb_uring_fsync_common(fd, TRUE));
+}
+
+/*
+ * Does a sync_file_range through the ring.
+ */
+static int
+fb_uring_syncrange(fb_fdesc_t *fd, off64_t offset, off64_t len, int flags)
+{
+	struct io_uring_sqe *sqe;
+	fb_uring_t *ring;
+	int sfrflags;
+
+	/* the ring's length field is 32 bits wide */
+	if (((ring = fb_uring_get_op(IORING_OP_SYNC_FILE_RANGE)) == NULL) ||
+	    (len > UINT32_MAX))
+		return ((*fb_uring_lfs.fsp_syncrange)(fd, offset, len, flags));
+
+	if ((sfrflags = fb_lfs_syncflags(flags)) < 0)
+		return (-1);
+
+	sqe = fb_uring_get_sqe(ring);
+	sqe->opcode = IORING_OP_SYNC_FILE_RANGE;
+	sqe->fd = fd->fd_num;
+	sqe->off = offset;
+	sqe->len = len;
+	sqe->sync_range_flags = sfrflags;
+	if ((fd->fd_num < FB_URING_NFILES) && ring->fur_fixed[fd->fd_num])
+		sqe->flags |= IOSQE_FIXED_FILE;
+
+	return (fb_uring_sync(ring, sqe) < 0 ? -1 : 0);
+}
+
+/*
+ * Does an openat through the ring and adds the new file to the ring's
+ * registered file table. Returns FILEBENCH_OK on success, and
+ * FILEBENCH_ERROR on failure.
+ */
+static int
+fb_uring_open(fb_fdesc_t *fd, char *path, int flags, int perms)
+{
+	struct io_uring_sqe *sqe;
+	fb_uring_t *ring;
+	int ret;
+
+	if ((ring = fb_uring_get_op(IORING_OP_OPENAT)) == NULL)
+		return ((*fb_uring_lfs.fsp_open)(fd, path, flags, perms));
+
+	sqe = fb_uring_get_sqe(ring);
+	sqe->opcode = IORING_OP_OPENAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (uint64_t)(uintptr_t)path;
+	sqe->len = perms;
+	sqe->open_flags = flags;
+
+	if ((ret = fb_uring_sync(ring, sqe)) < 0)
+		return (FILEBENCH_ERROR);
+
+	fd->fd_num = ret;
+	fb_uring_fixfile(ring, ret, ret);
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Takes the file out of the ring's registered file table and closes it
+ * through the ring.
+ */
+static int
+fb_uring_close(fb_fdesc_t *fd)
+{
+	struct io_uring_sqe *sqe;
+	fb_uring_t *ring;
+
+	if ((ring = fb_uring_get()) == NULL)
+		return ((*fb_uring_lfs.fsp_close)(fd));
+
+	if ((fd->fd_num < FB_URING_NFILES) && ring->fur_fixed[fd->fd_num])
+		fb_uring_fixfile(ring, fd->fd_num, -1);
+
+	if (!ring->fur_op[IORING_OP_CLOSE])
+		return ((*fb_uring_lfs.fsp_close)(fd));
+
+	sqe = fb_uring_get_sqe(ring);
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = fd->fd_num;
+
+	return (fb_uring_sync(ring, sqe) < 0 ? -1 : 0);
+}
+
+/*
+ * Does a statx through the ring, relative to dirfd, and converts the
+ * result to a struct stat64. Returns 0 on success, -1 on failure.
+ */
+static int
+fb_uring_statx(fb_uring_t *ring, int dirfd, const char *path, int flags,
+    struct stat64 *statp)
+{
+	struct io_uring_sqe *sqe;
+	struct statx stx;
+
+	sqe = fb_uring_get_sqe(ring);
+	sqe->opcode = IORING_OP_STATX;
+	sqe->fd = dirfd;
+	sqe->addr = (uint64_t)(uintptr_t)path;
+	sqe->len = STATX_BASIC_STATS;
+	sqe->off = (uint64_t)(uintptr_t)&stx;
+	sqe->statx_flags = flags;
+
+	if (fb_uring_sync(ring, sqe) < 0)
+		return (-1);
+
+	(void) memset(statp, 0, sizeof (*statp));
+	statp->st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+	statp->st_ino = stx.stx_ino;
+	statp->st_mode = stx.stx_mode;
+	statp->st_nlink = stx.stx_nlink;
+	statp->st_uid = stx.stx_uid;
+	statp->st_gid = stx.stx_gid;
+	statp->st_rdev = makedev(stx.stx_rdev_major, stx.stx_rdev_minor);
+	statp->st_size = stx.stx_size;
+	statp->st_blksize = stx.stx_blksize;
+	statp->st_blocks = stx.stx_blocks;
+	statp->st_atim.tv_sec = stx.stx_atime.tv_sec;
+	statp->st_atim.tv_nsec = stx.stx_atime.tv_nsec;
+	statp->st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+	statp->st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+	statp->st_ctim.tv_sec = stx.stx_ctime.tv_sec;
+	statp->st_ctim.tv_nsec = stx.stx_ctime.tv_nsec;
+
+	return (0);
+}
+
+static int
+fb_uring_stat(char *path, struct stat64 *statp)
+{
+	fb_uring_t *ring;
+
+	if ((ring = fb_uring_get_op(IORING_OP_STATX)) == NULL)
+		return ((*fb_uring_lfs.fsp_stat)(path, statp));
+
+	return (fb_uring_statx(ring, AT_FDCWD, path, 0, statp));
+}
+
+static int
+fb_uring_fstat(fb_fdesc_t *fd, struct stat64 *statp)
+{
+	fb_uring_t *ring;
+
+	if ((ring = fb_uring_get_op(IORING_OP_STATX)) == NULL)
+		return ((*fb_uring_lfs.fsp_fstat)(fd, statp));
+
+	return (fb_uring_statx(ring, fd->fd_num, "", AT_EMPTY_PATH, statp));
+}
+
+/*
+ * Stats count directory entries, given by name relative to dirfd, the
+ * way "ls -l" does, with up to a ring's worth of statx requests
+ * submitted in a single system call. The results themselves are
+ * discarded. Returns the number of entries statted successfully, or -1
+ * if the io_uring plug-in is not in use or the thread's ring can't do
+ * statx, in which case the caller stats the entries itself.
+ */
+int
+fb_uring_statxv(int dirfd, char **names, int count)
+{
+	struct io_uring_sqe *sqe;
+	fb_uring_t *ring;
+	uint64_t data;
+	int batch;
+	int done;
+	int ok = 0;
+	int res;
+	int i;
+
+	if ((fs_functions_vec != &fb_uring_funcs) ||
+	    ((ring = fb_uring_get_op(IORING_OP_STATX)) == NULL))
+		return (-1);
+
+	if ((ring->fur_stx == NULL) && ((ring->fur_stx =
+	    calloc(ring->fur_entries, sizeof (struct statx))) == NULL))
+		return (-1);
+
+	for (done = 0; done < count; done += batch) {
+		batch = MIN(count - done, (int)ring->fur_entries);
+
+		/* user_data is the name's slot, to tell them from async I/O */
+		for (i = 0; i < batch; i++) {
+			sqe = fb_uring_get_sqe(ring);
+			sqe->opcode = IORING_OP_STATX;
+			sqe->fd = dirfd;
+			sqe->addr = (uint64_t)(uintptr_t)names[done + i];
+			sqe->len = STATX_BASIC_STATS;
+			sqe->off = (uint64_t)(uintptr_t)&ring->fur_stx[i];
+			sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+			sqe->user_data = (uint64_t)(uintptr_t)&names[done + i];
+			fb_uring_publish(ring);
+		}
+
+		if (fb_uring_enter(ring, batch, TRUE) < 0)
+			return (-1);
+
+		for (i = 0; i < batch; ) {
+			if (fb_uring_reap(ring, TRUE, &data, &res) < 0)
+				return (-1);
+			if ((data < (uint64_t)(uintptr_t)&names[done]) ||
+			    (data >= (uint64_t)(uintptr_t)&names[done + batch])) {
+				fb_uring_async_done(ring, data, res);
+				continue;
+			}
+			if (res == 0)
+				ok++;
+			i++;
+		}
+	}
+
+	return (ok);
+}
+
+/*
+ * Registers buf as the calling thread's fixed I/O buffer. Called by
+ * worker threads for their tf_mem once it is allocated. Failure only
+ * means I/O to buf is not done with the fixed buffer opcodes.
+ */
+void
+fb_uring_regbuf(caddr_t buf, size_t len)
+{
+	struct iovec iov;
+	fb_uring_t *ring;
+
+	if ((filebench_shm->shm_filesys_type != IO_URING_PLUG) ||
+	    (buf == NULL) || (len == 0) || ((ring = fb_uring_get()) == NULL))
+		return;
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+
+	if (syscall(__NR_io_uring_register, ring->fur_fd,
+	    IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+		filebench_log(LOG_DEBUG_IMPL, "io_uring buffer registration "
+		    "failed: %s", strerror(errno));
+		return;
+	}
+
+	ring->fur_buf = buf;
+	ring->fur_buflen = len;
+}
+
+/*
+ * Submits an asynchronous random read or write of iosize bytes to
+ * either one file of a fileset, or the file associated with a fileobj,
+ * first reaping completions if iodepth requests are already in flight.
+ * The request is tracked by an element of the thread's async request
+ * ring, and its latency is recorded when it is reaped. Like aiowrite,
+ * this is only valid for random I/O. Returns FILEBENCH_OK
+ * on success, FILEBENCH_NORSC if iosetup can't obtain a file to open,
+ * and FILEBENCH_ERROR on any encountered error.
+ */
+static int
+fb_uringflow_rw(threadflow_t *threadflow, flowop_t *flowop, int write)
+{
+	struct io_uring_sqe *sqe;
+	fb_fdesc_t *fdesc;
+	fb_uring_t *ring;
+	aiolist_t *aio;
+	uint64_t fileoffset;
+	caddr_t iobuf;
+	fbint_t wss;
+	fbint_t iosize;
+	int ret;
+
+	if (!(flowop->fo_boolattrs & FLOW_BOOL_RANDOM)) {
+		filebench_log(LOG_ERROR,
+		    "flowop %s: io_uring flowops only do random I/O",
+		    flowop->fo_name);
+		return (FILEBENCH_ERROR);
+	}
+
+	if ((ring = fb_uring_get()) == NULL)
+		return (FILEBENCH_ERROR);
+
+	iosize = flowoplib_iosize(flowop);
+
+	if ((ret = flowoplib_iosetup(threadflow, flowop, &wss, &iobuf,
+	    &fdesc, iosize)) != FILEBENCH_OK)
+		return (ret);
+
+	if (wss < iosize) {
+		filebench_log(LOG_ERROR,
+		    "file size smaller than IO size for thread %s",
+		    flowop->fo_name);
+		return (FILEBENCH_ERROR);
+	}
+
+	fileoffset = fb_random_ring(&flowop->fo_offring, wss, iosize);
+
+	/* keep at most iodepth requests in flight */
+	while ((ring->fur_inflight >= ring->fur_depth) ||
+	    ((aio = flowop_aio_get(threadflow, flowop,
+	    (write ? AL_WRITE : AL_READ) | AL_URING)) == NULL)) {
+		uint64_t data;
+		int res;
+
+		if (ring->fur_inflight == 0) {
+			filebench_log(LOG_ERROR, "flowop %s: thread has too "
+			    "many async requests in flight", flowop->fo_name);
+			return (FILEBENCH_ERROR);
+		}
+		if (fb_uring_reap(ring, TRUE, &data, &res) < 0) {
+			filebench_log(LOG_ERROR, "io_uring reap failed: %s",
+			    strerror(errno));
+			return (FILEBENCH_ERROR);
+		}
+		fb_uring_async_done(ring, data, res);
+	}
+
+	sqe = fb_uring_get_sqe(ring);
+	fb_uring_prep_rw(ring, sqe, write, fdesc->fd_num, iobuf, iosize,
+	    (off64_t)fileoffset);
+	sqe->user_data = (uint64_t)(uintptr_t)aio;
+
+	if (fb_uring_submit(ring, FALSE) < 0) {
+		flowop_aio_done(threadflow, aio, 0);
+		filebench_log(LOG_ERROR, "io_uring submit failed: %s",
+		    strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+	ring->fur_inflight++;
+
+	return (FILEBENCH_OK);
+}
+
+static int
+fb_uringflow_read(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (fb_uringflow_rw(threadflow, flowop, FALSE));
+}
+
+static int
+fb_uringflow_write(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (fb_uringflow_rw(threadflow, flowop, TRUE));
+}
+
+/*
+ * Waits for the completion of half the thread's outstanding io_uring
+ * requests, or a single one, whichever is larger, and reaps whatever
+ * else has completed by then.
+ */
+static int
+fb_uringflow_wait(threadflow_t *threadflow, flowop_t *flowop)
+{
+	fb_uring_t *ring;
+	uint64_t data;
+	int todo;
+	int res;
+
+	if (((ring = fb_uring_get()) == NULL) || (ring->fur_inflight == 0))
+		return (FILEBENCH_OK);
+
+	todo = MAX(ring->fur_inflight / 2, 1);
+
+	flowop_beginop(threadflow, flowop);
+
+	for (; todo > 0; todo--) {
+		if (fb_uring_reap(ring, TRUE, &data, &res) < 0) {
+			flowop_endop(threadflow, flowop, 0);
+			filebench_log(LOG_ERROR, "io_uring reap failed: %s",
+			    strerror(errno));
+			return (FILEBENCH_ERROR);
+		}
+		fb_uring_async_done(ring, data, res);
+	}
+
+	while (fb_uring_reap(ring, FALSE, &data, &res) == 0)
+		fb_uring_async_done(ring, data, res);
+
+	flowop_endop(threadflow, flowop, 0);
+
+	filebench_log(LOG_DEBUG_SCRIPT, "io_uring %d requests in flight",
+	    ring->fur_inflight);
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Reaps the calling thread's completed asynchronous io_uring requests,
+ * for the posix aio flowops, which take their requests from the same
+ * ring of the thread. With wait set, waits for one if none has
+ * completed yet. Never sets up a ring. Returns the number reaped.
+ */
+int
+fb_uring_reap_async(int wait)
+{
+	fb_uring_t *ring;
+	uint64_t data;
+	int res;
+	int n = 0;
+
+	(void) pthread_once(&fb_uring_once, fb_uring_key_init);
+
+	ring = pthread_getspecific(fb_uring_key);
+	if ((ring == NULL) || (ring == &fb_uring_none) ||
+	    (ring->fur_inflight == 0))
+		return (0);
+
+	while (fb_uring_reap(ring, wait && (n == 0), &data, &res) == 0) {
+		fb_uring_async_done(ring, data, res);
+		n++;
+	}
+
+	return (n);
+}
+
+static flowop_proto_t fb_uringflow_funcs[] = {
+	{FLOW_TYPE_AIO, FLOW_ATTR_READ, "uringread", flowop_init_generic,
+	fb_uringflow_read, flowop_destruct_generic},
+	{FLOW_TYPE_AIO, FLOW_ATTR_WRITE, "uringwrite", flowop_init_generic,
+	fb_uringflow_write, flowop_destruct_generic},
+	{FLOW_TYPE_AIO, 0, "uringwait", flowop_init_generic,
+	fb_uringflow_wait, flowop_destruct_generic}
+};
+
+#else /* FB_IO_URING */
+
+/* ARGSUSED */
+void
+fb_uring_regbuf(caddr_t buf, size_t len)
+{
+}
+
+/* ARGSUSED */
+int
+fb_uring_statxv(int dirfd, char **names, int count)
+{
+	return (-1);
+}
+
+/* ARGSUSED */
+int
+fb_uring_reap_async(int wait)
+{
+	return (0);
+}
+
+#endif /* FB_IO_URING */
+
+/*
+ * Initialize file system functions vector to the io_uring plug-in. It
+ * starts as a copy of the local file system vector, which also provides
+ * the fallbacks, with the operations done through the ring replaced.
+ * Returns FILEBENCH_ERROR if io_uring is not supported by this build.
+ */
+int
+fb_uring_funcvecinit(void)
+{
+	fb_lfs_funcvecinit();
+	fb_uring_lfs = *fs_functions_vec;
+
+#ifdef FB_IO_URING
+	fb_uring_funcs = fb_uring_lfs;
+	(void) fb_strlcpy(fb_uring_funcs.fs_name, "io_uring",
+	    sizeof (fb_uring_funcs.fs_name));
+	fb_uring_funcs.fsp_open = fb_uring_open;
+	fb_uring_funcs.fsp_pread = fb_uring_pread;
+	fb_uring_funcs.fsp_read = fb_uring_read;
+	fb_uring_funcs.fsp_pwrite = fb_uring_pwrite;
+	fb_uring_funcs.fsp_write = fb_uring_write;
+	fb_uring_funcs.fsp_close = fb_uring_close;
+	fb_uring_funcs.fsp_fsync = fb_uring_fsync;
+	fb_uring_funcs.fsp_fdatasync = fb_uring_fdatasync;
+	fb_uring_funcs.fsp_syncrange = fb_uring_syncrange;
+	fb_uring_funcs.fsp_stat = fb_uring_stat;
+	fb_uring_funcs.fsp_fstat = fb_uring_fstat;
+	fb_uring_funcs.fsp_preadv2 = fb_uring_preadv2;
+	fb_uring_funcs.fsp_pwritev2 = fb_uring_pwritev2;
+	fs_functions_vec = &fb_uring_funcs;
+
+	return (FILEBENCH_OK);
+#else
+	return (FILEBENCH_ERROR);
+#endif /* FB_IO_URING */
+}
+
+/*
+ * Adds the io_uring specific flowops to the master flowop list.
+ */
+void
+fb_uring_newflowops(void)
+{
+#ifdef FB_IO_URING
+	int nops;
+
+	nops = sizeof (fb_uringflow_funcs) / sizeof (flowop_proto_t);
+	flowop_add_from_proto(fb_uringflow_funcs, nops);
+#endif /* FB_IO_URING */
+}
@@ -100,6 +100,8 @@ typedef unsigned int uint_t;
 #endif
 #ifndef HAVE_AIO_WRITE64
 	#define aio_write64 aio_write
+	#define aio_read64 aio_read
+	#define aio_suspend64 aio_suspend
 	#define aiocb64 aiocb
 #endif
 #ifndef HAVE_AIO_RETURN64
@@ -40,6 +40,7 @@
 #include "gamma_dist.h"
 #include "utils.h"
 #include "fsplug.h"
+#include "fb_content.h"
 
 #include "threadflow.h"
 
@@ -138,70 +139,344 @@ fileset_resolvepath(filesetentry_t *entry)
 
 /*
  * Creates multiple nested directories as required by the
- * supplied path. Starts at the end of the path, creating
- * a list of directories to mkdir, up to the root of the
- * path, then mkdirs them one at a time from the root on down.
+ * supplied path. Tries the full path first, and on ENOENT cuts
+ * the path back one component at a time until a mkdir succeeds
+ * or finds the directory already there. It then restores the cut
+ * components and mkdirs them one at a time from there on down.
+ * Returns FILEBENCH_ERROR if a directory can't be made, including when
+ * even the first component of the path, relative or absolute, can't
+ * be, and FILEBENCH_OK otherwise.
  */
 static int
 fileset_mkdir(char *path, int mode)
 {
-	char *p;
-	char *dirs[65536];
-	int i = 0;
+	char p[MAXPATHLEN];
+	char *end;
+	char *s;
 
-	if ((p = strdup(path)) == NULL)
-		goto null_str;
+	(void) fb_strlcpy(p, path, MAXPATHLEN);
+	end = p + strlen(p);
+	s = end;
+
+	while ((FB_MKDIR(p, mode) < 0) && (errno != EEXIST)) {
+		if (errno != ENOENT)
+			goto failed;
+		while ((s > p) && (*s != '/'))
+			s--;
+		/* no parent left to make: the start of the path is missing */
+		if (s == p)
+			goto failed;
+		*s = '\0';
+	}
+
+	while (s < end) {
+		*s = '/';
+		s += strlen(s);
+		if ((FB_MKDIR(p, mode) < 0) && (errno != EEXIST))
+			goto failed;
+	}
+
+	return (FILEBENCH_OK);
+
+failed:
+	filebench_log(LOG_ERROR, "Failed to create directory %s: %s",
+	    p, strerror(errno));
+	return (FILEBENCH_ERROR);
+}
+
+/*
+ * Reads the list of CPUs of NUMA node "node" from sysfs into cpus.
+ * Returns 0 on success, -1 if the node's cpulist can't be read.
+ */
+static int
+fileset_node_cpus(int node, cpu_set_t *cpus)
+{
+	char path[MAXPATHLEN];
+	char list[4096];
+	char *s;
+	FILE *fp;
+
+	(void) snprintf(path, sizeof (path),
+	    "/sys/devices/system/node/node%d/cpulist", node);
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return (-1);
+
+	if (fgets(list, sizeof (list), fp) == NULL) {
+		(void) fclose(fp);
+		return (-1);
+	}
+	(void) fclose(fp);
+
+	/* cpulist is a comma separated list of cpus and cpu ranges */
+	CPU_ZERO(cpus);
+	for (s = strtok(list, ",\n"); s; s = strtok(NULL, ",\n")) {
+		int first, last;
+
+		if (sscanf(s, "%d-%d", &first, &last) != 2)
+			last = first = atoi(s);
+
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, cpus);
+	}
+
+	return (CPU_COUNT(cpus) ? 0 : -1);
+}
+
+/*
+ * State shared by the directory creation workers. The fileset's
+ * directories are bucketed by depth and, within a depth, grouped with
+ * their siblings, so each worker takes a whole parent directory, opens
+ * it once and mkdirat()s all of its children relative to that fd.
+ */
+typedef struct fileset_mkdir_ctl {
+	char		*fmc_rootpath;	/* fileset root directory */
+	filesetentry_t	**fmc_parents;	/* parents of the level being made */
+	int		fmc_nparents;
+	int		fmc_next;	/* next parent to be taken */
+	filesetentry_t	**fmc_kids;	/* all dirs, grouped by parent */
+	int		*fmc_kidstart;	/* first kid of each dir in fmc_kids */
+	int		*fmc_nkids;	/* number of kids of each dir */
+	int		fmc_pin;	/* pin workers to fmc_cpus? */
+	cpu_set_t	fmc_cpus;
+	int		fmc_error;	/* a worker failed, under fmc_lock */
+	pthread_mutex_t	fmc_lock;
+} fileset_mkdir_ctl_t;
+
+/*
+ * Directory creation worker. Repeatedly takes the next parent directory
+ * of the current level and creates all of its subdirectories, until the
+ * level is exhausted.
+ */
+static void *
+fileset_mkdir_thread(fileset_mkdir_ctl_t *ctl)
+{
+	char path[MAXPATHLEN];
+
+	if (ctl->fmc_pin)
+		(void) pthread_setaffinity_np(pthread_self(),
+		    sizeof (cpu_set_t), &ctl->fmc_cpus);
 
-	/*
-	 * Fill an array of subdirectory path names until either we
-	 * reach the root or encounter an already existing subdirectory
-	 */
 	/* CONSTCOND */
 	while (1) {
-		struct stat64 sb;
-
-		if (stat64(p, &sb) == 0)
+		filesetentry_t *parent;
+		char *part_path;
+		int dirfd;
+		int i, first, last;
+
+		(void) pthread_mutex_lock(&ctl->fmc_lock);
+		if (ctl->fmc_error || (ctl->fmc_next >= ctl->fmc_nparents)) {
+			(void) pthread_mutex_unlock(&ctl->fmc_lock);
 			break;
-		if (strlen(p) < 3)
+		}
+		parent = ctl->fmc_parents[ctl->fmc_next++];
+		(void) pthread_mutex_unlock(&ctl->fmc_lock);
+
+		(void) fb_strlcpy(path, ctl->fmc_rootpath, MAXPATHLEN);
+		part_path = fileset_resolvepath(parent);
+		(void) fb_strlcat(path, part_path, MAXPATHLEN);
+		free(part_path);
+
+		if ((dirfd = open(path, O_RDONLY | O_DIRECTORY)) < 0) {
+			filebench_log(LOG_ERROR, "Failed to open directory %s: %s",
+			    path, strerror(errno));
+			(void) pthread_mutex_lock(&ctl->fmc_lock);
+			ctl->fmc_error = 1;
+			(void) pthread_mutex_unlock(&ctl->fmc_lock);
 			break;
-		if ((dirs[i] = strdup(p)) == NULL) {
-			free(p);
-			goto null_str;
 		}
 
-		(void) trunc_dirname(p);
-		i++;
+		first = ctl->fmc_kidstart[parent->fse_index];
+		last = first + ctl->fmc_nkids[parent->fse_index];
+		for (i = first; i < last; i++) {
+			filesetentry_t *kid = ctl->fmc_kids[i];
+
+			if ((mkdirat(dirfd, kid->fse_path, 0755) < 0) &&
+			    (errno != EEXIST)) {
+				filebench_log(LOG_ERROR,
+				    "Failed to create directory %s/%s: %s",
+				    path, kid->fse_path, strerror(errno));
+				(void) pthread_mutex_lock(&ctl->fmc_lock);
+				ctl->fmc_error = 1;
+				(void) pthread_mutex_unlock(&ctl->fmc_lock);
+				break;
+			}
+		}
+
+		(void) close(dirfd);
 	}
 
-	/* Make the directories, from closest to root downwards. */
-	for (--i; i >= 0; i--) {
-		(void) FB_MKDIR(dirs[i], mode);
-		free(dirs[i]);
+	return (NULL);
+}
+
+/*
+ * Creates the subdirectory tree of a fileset breadth first with a pool
+ * of up to MAX_PARALLOC_THREADS workers. All directories of one depth
+ * are created before any of the next, so every parent exists by the time
+ * its children are made. If the fileset's mkdir_node attribute is set,
+ * the workers run on the CPUs of that NUMA node. dirs holds the
+ * fileset's ndirs directories, indexed by fse_index.
+ */
+static int
+fileset_create_subdirs_parallel(fileset_t *fileset, char *filesetpath,
+    filesetentry_t **dirs, int ndirs)
+{
+	fileset_mkdir_ctl_t ctl;
+	pthread_t tids[MAX_PARALLOC_THREADS];
+	filesetentry_t **bylevel;
+	int *depth, *levelstart, *fill;
+	int maxdepth = 0;
+	int ret = FILEBENCH_ERROR;
+	int i, level;
+
+	(void) memset(&ctl, 0, sizeof (ctl));
+	ctl.fmc_rootpath = filesetpath;
+	(void) pthread_mutex_init(&ctl.fmc_lock, NULL);
+
+	if (fileset->fs_mkdirnode) {
+		int node = (int)avd_get_int(fileset->fs_mkdirnode);
+
+		if (fileset_node_cpus(node, &ctl.fmc_cpus) == 0)
+			ctl.fmc_pin = 1;
+		else
+			filebench_log(LOG_INFO, "Can't get CPUs of node %d, "
+			    "creating %s directories unpinned", node,
+			    avd_get_str(fileset->fs_name));
 	}
 
-	free(p);
-	return (FILEBENCH_OK);
+	depth = calloc(ndirs, sizeof (int));
+	levelstart = calloc(ndirs + 1, sizeof (int));
+	fill = calloc(ndirs + 1, sizeof (int));
+	bylevel = malloc(ndirs * sizeof (filesetentry_t *));
+	ctl.fmc_kids = malloc(ndirs * sizeof (filesetentry_t *));
+	ctl.fmc_kidstart = calloc(ndirs, sizeof (int));
+	ctl.fmc_nkids = calloc(ndirs, sizeof (int));
+	if (!depth || !levelstart || !fill || !bylevel || !ctl.fmc_kids ||
+	    !ctl.fmc_kidstart || !ctl.fmc_nkids) {
+		filebench_log(LOG_ERROR,
+		    "Can't allocate directory creation tables");
+		goto out;
+	}
 
-null_str:
-	/* clean up */
-	for (--i; i >= 0; i--)
-		free(dirs[i]);
+	/* parents always have lower indices than their children */
+	for (i = 0; i < ndirs; i++) {
+		filesetentry_t *parent = dirs[i]->fse_parent;
 
-	filebench_log(LOG_ERROR,
-	    "Failed to create directory path %s: Out of memory", path);
-	return (FILEBENCH_ERROR);
+		if (parent) {
+			depth[i] = depth[parent->fse_index] + 1;
+			ctl.fmc_nkids[parent->fse_index]++;
+		}
+		levelstart[depth[i] + 1]++;
+		maxdepth = MAX(maxdepth, depth[i]);
+	}
+
+	/* turn the counts into start offsets */
+	for (i = 1; i < ndirs; i++)
+		ctl.fmc_kidstart[i] = ctl.fmc_kidstart[i - 1] +
+		    ctl.fmc_nkids[i - 1];
+	for (level = 1; level <= maxdepth; level++)
+		levelstart[level] += levelstart[level - 1];
+
+	/* bucket directories by parent */
+	for (i = 0; i < ndirs; i++) {
+		filesetentry_t *parent = dirs[i]->fse_parent;
+
+		if (parent)
+			ctl.fmc_kids[ctl.fmc_kidstart[parent->fse_index] +
+			    fill[parent->fse_index]++] = dirs[i];
+	}
+
+	/* and by depth */
+	(void) memset(fill, 0, (ndirs + 1) * sizeof (int));
+	for (i = 0; i < ndirs; i++)
+		bylevel[levelstart[depth[i]] + fill[depth[i]]++] = dirs[i];
+
+	/* level by level, make the children of every directory on it */
+	for (level = 0; level < maxdepth; level++) {
+		int nthreads;
+
+		ctl.fmc_parents = &bylevel[levelstart[level]];
+		ctl.fmc_nparents = levelstart[level + 1] - levelstart[level];
+		ctl.fmc_next = 0;
+
+		nthreads = MIN(ctl.fmc_nparents, MAX_PARALLOC_THREADS);
+		for (i = 0; i < nthreads; i++) {
+			if (pthread_create(&tids[i], NULL,
+			    (void *(*)(void*))fileset_mkdir_thread, &ctl)) {
+				filebench_log(LOG_ERROR,
+				    "Directory creation thread create failed");
+				(void) pthread_mutex_lock(&ctl.fmc_lock);
+				ctl.fmc_error = 1;
+				(void) pthread_mutex_unlock(&ctl.fmc_lock);
+				break;
+			}
+		}
+
+		/* level barrier */
+		while (--i >= 0)
+			(void) pthread_join(tids[i], NULL);
+
+		if (ctl.fmc_error)
+			goto out;
+	}
+
+	ret = FILEBENCH_OK;
+out:
+	free(depth);
+	free(levelstart);
+	free(fill);
+	free(bylevel);
+	free(ctl.fmc_kids);
+	free(ctl.fmc_kidstart);
+	free(ctl.fmc_nkids);
+	(void) pthread_mutex_destroy(&ctl.fmc_lock);
+	return (ret);
 }
 
 /*
- * creates the subdirectory tree for a fileset.
+ * creates the subdirectory tree for a fileset. Parallel allocation
+ * filesets on the local file system get their directories made by
+ * fileset_create_subdirs_parallel(), all others one path at a time.
  */
 static int
 fileset_create_subdirs(fileset_t *fileset, char *filesetpath)
 {
 	filesetentry_t *direntry;
+	filesetentry_t **dirs;
 	char full_path[MAXPATHLEN];
 	char *part_path;
+	int ndirs = 0;
+	int ret;
+
+	if (avd_get_bool(fileset->fs_paralloc) &&
+	    ((filebench_shm->shm_filesys_type == LOCAL_FS_PLUG) ||
+	    (filebench_shm->shm_filesys_type == IO_URING_PLUG))) {
+		for (direntry = fileset->fs_dirlist; direntry;
+		    direntry = direntry->fse_nextoftype)
+			ndirs++;
 
+		if ((dirs = malloc(ndirs * sizeof (filesetentry_t *))) == NULL) {
+			filebench_log(LOG_ERROR,
+			    "Can't allocate directory table");
+			return (FILEBENCH_ERROR);
+		}
+
+		for (direntry = fileset->fs_dirlist; direntry;
+		    direntry = direntry->fse_nextoftype) {
+			if (direntry->fse_index >= ndirs) {
+				free(dirs);
+				goto serial;
+			}
+			dirs[direntry->fse_index] = direntry;
+		}
+
+		ret = fileset_create_subdirs_parallel(fileset, filesetpath,
+		    dirs, ndirs);
+		free(dirs);
+		return (ret);
+	}
+
+serial:
 	/* walk the subdirectory list, enstanciating subdirs */
 	direntry = fileset->fs_dirlist;
 	while (direntry) {
@@ -271,22 +546,121 @@ fileset_alloc_leafdir(filesetentry_t *entry)
 	return (FILEBENCH_OK);
 }
 
+/*
+ * Zero filled buffer that "write" and "odirect" preallocations copy from.
+ * It is never modified once initialized, so the master thread and all
+ * paralloc threads share it instead of allocating one per file.
+ */
+static pthread_once_t fileset_allocbuf_once = PTHREAD_ONCE_INIT;
+static char *fileset_allocbuf = NULL;
+
+static void
+fileset_allocbuf_init(void)
+{
+	void *buf;
+
+	if (posix_memalign(&buf, FILESET_PREALLOC_ALIGN, FILE_ALLOC_BLOCK))
+		return;
+
+	(void) memset(buf, 0, FILE_ALLOC_BLOCK);
+	fileset_allocbuf = buf;
+}
+
+/*
+ * Writes size bytes of zeroes to the file in FILE_ALLOC_BLOCK chunks. With
+ * odirect set, the last chunk is rounded up to FILESET_PREALLOC_ALIGN, as
+ * O_DIRECT requires, and the file is truncated back to size afterwards.
+ * If the fileset has a compress_ratio or dedupe_ratio, the zeroes are
+ * replaced by generated content: a private buffer is filled once and
+ * restamped before each chunk is written.
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+fileset_alloc_write(fileset_t *fileset, fb_fdesc_t *fdesc, off64_t size,
+    int odirect)
+{
+	uint64_t stamp;
+	char *buf = NULL;
+	void *cbuf = NULL;
+	off64_t bufsize;
+	off64_t seek;
+	int ret = 0;
+
+	bufsize = (MIN(size, FILE_ALLOC_BLOCK) + FILESET_PREALLOC_ALIGN - 1) &
+	    ~((off64_t)FILESET_PREALLOC_ALIGN - 1);
+
+	if (fileset->fs_constcompress && (bufsize > 0)) {
+		if (posix_memalign(&cbuf, FILESET_PREALLOC_ALIGN, bufsize)) {
+			errno = ENOMEM;
+			return (-1);
+		}
+		buf = cbuf;
+		stamp = fb_content_seed();
+		if (fb_content_fill(buf, bufsize, fileset->fs_constcompress,
+		    fileset->fs_constdedupe, &stamp) < 0) {
+			free(cbuf);
+			errno = ENOMEM;
+			return (-1);
+		}
+	} else {
+		(void) pthread_once(&fileset_allocbuf_once,
+		    fileset_allocbuf_init);
+		if (!(buf = fileset_allocbuf)) {
+			errno = ENOMEM;
+			return (-1);
+		}
+	}
+
+	for (seek = 0; seek < size; ) {
+		off64_t wsize;
+
+		/*
+		 * Write FILE_ALLOC_BLOCK's worth,
+		 * except on last write
+		 */
+		wsize = MIN(size - seek, FILE_ALLOC_BLOCK);
+		if (odirect)
+			wsize = (wsize + FILESET_PREALLOC_ALIGN - 1) &
+			    ~((off64_t)FILESET_PREALLOC_ALIGN - 1);
+
+		if (cbuf && seek)
+			fb_content_stamp(buf, wsize,
+			    fileset->fs_constdedupe, &stamp);
+
+		if (FB_WRITE(fdesc, buf, wsize) != wsize) {
+			ret = -1;
+			break;
+		}
+
+		seek += wsize;
+	}
+
+	free(cbuf);
+
+	if ((ret == 0) && (seek > size))
+		return (FB_FTRUNC(fdesc, size));
+
+	return (ret);
+}
+
 /*
  * given a fileset entry, determines if the associated file
- * needs to be allocated or not, and if so does the allocation.
+ * needs to be allocated or not, and if so does the allocation
+ * using the fileset's prealloc_mode.
  */
 static int
 fileset_alloc_file(filesetentry_t *entry)
 {
 	fileset_t *fileset;
 	char path[MAXPATHLEN];
-	char *buf;
 	struct stat64 sb;
 	char *pathtmp;
-	off64_t seek;
 	fb_fdesc_t fdesc;
 	int trust_tree;
 	int fs_readonly;
+	int mode;
+	int oflags = 0;
+	int ret;
 
 	fileset = entry->fse_fileset;
 	(void) fb_strlcpy(path, avd_get_str(fileset->fs_path), MAXPATHLEN);
@@ -298,6 +672,12 @@ fileset_alloc_file(filesetentry_t *entry)
 
 	filebench_log(LOG_DEBUG_IMPL, "Populated %s", entry->fse_path);
 
+	mode = fileset->fs_constpreallocmode;
+#ifdef HAVE_O_DIRECT
+	if (mode == FILESET_PREALLOC_ODIRECT)
+		oflags |= O_DIRECT;
+#endif /* HAVE_O_DIRECT */
+
 	/* see if fileset is readonly */
 	fs_readonly = avd_get_bool(fileset->fs_readonly) == TRUE;
 	
@@ -305,7 +685,7 @@ fileset_alloc_file(filesetentry_t *entry)
 	trust_tree = avd_get_bool(fileset->fs_trust_tree);
 	if ((entry->fse_flags & FSE_REUSING) && (trust_tree ||
 	    (FB_STAT(path, &sb) == 0))) {
-		if (FB_OPEN(&fdesc, path, fs_readonly ? O_RDONLY : O_RDWR, 0) == FILEBENCH_ERROR) {
+		if (FB_OPEN(&fdesc, path, fs_readonly ? O_RDONLY : O_RDWR | oflags, 0) == FILEBENCH_ERROR) {
 			filebench_log(LOG_INFO,
 			    "Attempted but failed to Re-use file %s",
 			    path);
@@ -339,7 +719,7 @@ fileset_alloc_file(filesetentry_t *entry)
 	} else {
 
 		/* No file or not reusing, so create */
-		if (FB_OPEN(&fdesc, path, O_RDWR | O_CREAT, 0644) ==
+		if (FB_OPEN(&fdesc, path, O_RDWR | O_CREAT | oflags, 0644) ==
 		    FILEBENCH_ERROR) {
 			filebench_log(LOG_ERROR,
 			    "Failed to pre-allocate file %s: %s",
@@ -351,39 +731,44 @@ fileset_alloc_file(filesetentry_t *entry)
 		}
 	}
 
-	if ((buf = (char *)malloc(FILE_ALLOC_BLOCK)) == NULL) {
-		/* unbusy the unallocated entry */
-		fileset_unbusy(entry, TRUE, FALSE, 0);
-		return (FILEBENCH_ERROR);
-	}
+	switch (mode) {
+	case FILESET_PREALLOC_SPARSE:
+		ret = FB_FTRUNC(&fdesc, (off64_t)entry->fse_size);
+		break;
+	case FILESET_PREALLOC_FALLOCATE:
+		/* zero length ranges are rejected by fallocate() */
+		if (entry->fse_size == 0) {
+			ret = 0;
+			break;
+		}
 
-	for (seek = 0; seek < entry->fse_size; ) {
-		off64_t wsize;
-		int ret = 0;
+		ret = FB_FALLOCATE(&fdesc, 0, 0, (off64_t)entry->fse_size);
+		if ((ret == 0) || ((errno != EOPNOTSUPP) && (errno != ENOSYS)))
+			break;
 
-		/*
-		 * Write FILE_ALLOC_BLOCK's worth,
-		 * except on last write
-		 */
-		wsize = MIN(entry->fse_size - seek, FILE_ALLOC_BLOCK);
+		/* fileset_probe_fallocate() said yes, but not for this file */
+		filebench_log(LOG_DEBUG_IMPL, "fallocate is not supported "
+		    "for %s, writing it instead", path);
+		ret = fileset_alloc_write(fileset, &fdesc,
+		    (off64_t)entry->fse_size, FALSE);
+		break;
+	default:
+		ret = fileset_alloc_write(fileset, &fdesc,
+		    (off64_t)entry->fse_size, mode == FILESET_PREALLOC_ODIRECT);
+		break;
+	}
 
-		ret = FB_WRITE(&fdesc, buf, wsize);
-		if (ret != wsize) {
-			filebench_log(LOG_ERROR,
-			    "Failed to pre-allocate file %s: %s",
-			    path, strerror(errno));
-			(void) FB_CLOSE(&fdesc);
-			free(buf);
-			fileset_unbusy(entry, TRUE, FALSE, 0);
-			return (FILEBENCH_ERROR);
-		}
-		seek += wsize;
+	if (ret < 0) {
+		filebench_log(LOG_ERROR,
+		    "Failed to pre-allocate file %s: %s",
+		    path, strerror(errno));
+		(void) FB_CLOSE(&fdesc);
+		fileset_unbusy(entry, TRUE, FALSE, 0);
+		return (FILEBENCH_ERROR);
 	}
 
 	(void) FB_CLOSE(&fdesc);
 
-	free(buf);
-
 	/* unbusy the allocated entry */
 	fileset_unbusy(entry, TRUE, TRUE, 0);
 
@@ -418,6 +803,41 @@ fileset_alloc_thread(filesetentry_t *entry)
 }
 
 
+/*
+ * Puts the full pathname of a fileset entry into path, which must be
+ * MAXPATHLEN bytes long. If mkparent is set, also creates the entry's
+ * parent directories when they do not exist yet, for flowops that give
+ * an entry its name without opening it, such as renamefile and
+ * linkfile. Returns FILEBENCH_ERROR if they could not be created,
+ * FILEBENCH_OK otherwise.
+ */
+int
+fileset_entrypath(fileset_t *fileset, filesetentry_t *entry, char *path,
+    int mkparent)
+{
+	char dir[MAXPATHLEN];
+	char *pathtmp;
+	struct stat64 sb;
+
+	(void) fb_strlcpy(path, avd_get_str(fileset->fs_path), MAXPATHLEN);
+	(void) fb_strlcat(path, "/", MAXPATHLEN);
+	(void) fb_strlcat(path, avd_get_str(fileset->fs_name), MAXPATHLEN);
+	pathtmp = fileset_resolvepath(entry);
+	(void) fb_strlcat(path, pathtmp, MAXPATHLEN);
+	free(pathtmp);
+
+	if (!mkparent)
+		return (FILEBENCH_OK);
+
+	(void) fb_strlcpy(dir, path, MAXPATHLEN);
+	(void) trunc_dirname(dir);
+	if ((stat64(dir, &sb) != 0) &&
+	    (fileset_mkdir(dir, 0755) == FILEBENCH_ERROR))
+		return (FILEBENCH_ERROR);
+
+	return (FILEBENCH_OK);
+}
+
 /*
  * First creates the parent directories of the file using
  * fileset_mkdir(). Then Optionally sets the O_DSYNC flag
@@ -967,6 +1387,124 @@ fileset_unbusy(filesetentry_t *entry, int update_exist,
 	(void) ipc_mutex_unlock(&fileset->fs_pick_lock);
 }
 
+/*
+ * Filesets that are reused across runs get a manifest, a small binary file
+ * next to the fileset's root directory which records the populated tree:
+ * a header followed by one record per directory, file and leaf directory,
+ * each group in fse_index order. On the next run with reuse set, the
+ * manifest is mapped and the filesetentry tree is rebuilt from it instead
+ * of being regenerated from the (random) size and width distributions, so
+ * the in-memory tree always matches what the fileset was created with.
+ * Flowops that create, delete or resize files leave the manifest behind,
+ * so the restored files are still checked on disk like any reused tree,
+ * unless trusttree is set, in which case they are taken as recorded.
+ */
+#define	FILESET_MANIFEST_SUFFIX		".manifest"
+#define	FILESET_MANIFEST_MAGIC		0x31464e414d424646ULL	/* FFBMANF1 */
+#define	FILESET_MANIFEST_NOPARENT	0xffffffff
+
+typedef struct fileset_manifest_hdr {
+	uint64_t	fmh_magic;
+	uint64_t	fmh_entries;	/* fs_constentries when written */
+	uint64_t	fmh_leafdirs;	/* fs_constleafdirs when written */
+	uint64_t	fmh_size;	/* file size attr, 0 if not constant */
+	uint64_t	fmh_dirwidth;	/* dirwidth attr, 0 if not constant */
+	uint64_t	fmh_ndirs;	/* number of directory records */
+	uint64_t	fmh_nfiles;	/* number of file records */
+	uint64_t	fmh_nleafdirs;	/* number of leaf directory records */
+	uint64_t	fmh_bytes;	/* fs_bytes */
+	double		fmh_meandepth;	/* fs_meandepth */
+} fileset_manifest_hdr_t;
+
+typedef struct fileset_manifest_ent {
+	uint64_t	fme_size;	/* fse_size */
+	uint32_t	fme_parent;	/* fse_index of parent directory */
+	uint32_t	fme_serial;	/* number the entry's name is made of */
+	uint32_t	fme_flags;	/* FSE_TYPE_* and FSE_EXISTS */
+	uint32_t	fme_pad;
+} fileset_manifest_ent_t;
+
+/*
+ * Puts the pathname of the fileset's manifest into the supplied
+ * MAXPATHLEN buffer.
+ */
+static void
+fileset_manifest_path(fileset_t *fileset, char *path)
+{
+	(void) fb_strlcpy(path, avd_get_str(fileset->fs_path), MAXPATHLEN);
+	(void) fb_strlcat(path, "/", MAXPATHLEN);
+	(void) fb_strlcat(path, avd_get_str(fileset->fs_name), MAXPATHLEN);
+	(void) fb_strlcat(path, FILESET_MANIFEST_SUFFIX, MAXPATHLEN);
+}
+
+/*
+ * Converts the fileset's prealloc_mode attribute to one of the
+ * FILESET_PREALLOC_* methods. Defaults to FILESET_PREALLOC_WRITE if the
+ * attribute is not set. Returns -1 if the mode is not recognized.
+ */
+static int
+fileset_preallocmode(fileset_t *fileset)
+{
+	char *mode;
+
+	if (!fileset->fs_preallocmode)
+		return (FILESET_PREALLOC_WRITE);
+
+	mode = avd_get_str(fileset->fs_preallocmode);
+	if (!mode || !strcmp(mode, "write"))
+		return (FILESET_PREALLOC_WRITE);
+	if (!strcmp(mode, "fallocate"))
+		return (FILESET_PREALLOC_FALLOCATE);
+	if (!strcmp(mode, "sparse"))
+		return (FILESET_PREALLOC_SPARSE);
+	if (!strcmp(mode, "odirect")) {
+#ifndef HAVE_O_DIRECT
+		filebench_log(LOG_INFO, "O_DIRECT is not supported, "
+		    "using prealloc_mode=write for %s",
+		    avd_get_str(fileset->fs_name));
+		return (FILESET_PREALLOC_WRITE);
+#else
+		return (FILESET_PREALLOC_ODIRECT);
+#endif /* HAVE_O_DIRECT */
+	}
+
+	filebench_log(LOG_ERROR, "%s %s: unknown prealloc_mode %s",
+	    fileset_entity_name(fileset), avd_get_str(fileset->fs_name), mode);
+	return (-1);
+}
+
+/*
+ * Finds out whether the file system under path supports fallocate(),
+ * by reserving space for a scratch file there, and switches the fileset
+ * to prealloc_mode=write if it does not. Called before any allocation
+ * thread starts, so that they only ever read fs_constpreallocmode.
+ */
+static void
+fileset_probe_fallocate(fileset_t *fileset, char *path)
+{
+	char probe[MAXPATHLEN];
+	fb_fdesc_t fdesc;
+	int ret, err;
+
+	(void) fb_strlcpy(probe, path, MAXPATHLEN);
+	(void) fb_strlcat(probe, "/.fallocate_probe", MAXPATHLEN);
+
+	/* if even this fails, the allocations will report why */
+	if (FB_OPEN(&fdesc, probe, O_RDWR | O_CREAT, 0644) == FILEBENCH_ERROR)
+		return;
+
+	ret = FB_FALLOCATE(&fdesc, 0, 0, 4096);
+	err = errno;
+	(void) FB_CLOSE(&fdesc);
+	(void) FB_UNLINK(probe);
+
+	if ((ret < 0) && ((err == EOPNOTSUPP) || (err == ENOSYS))) {
+		filebench_log(LOG_INFO, "fallocate is not supported for %s, "
+		    "falling back to prealloc_mode=write", path);
+		fileset->fs_constpreallocmode = FILESET_PREALLOC_WRITE;
+	}
+}
+
 /*
  * Given a fileset "fileset", create the associated files as specified in the
  * attributes of the fileset. The fileset is rooted in a directory whose
@@ -976,7 +1514,9 @@ fileset_unbusy(filesetentry_t *entry, int update_exist,
  * root directory for the fileset. All the file type filesetentries are cycled
  * through creating as needed their containing subdirectory trees in the
  * filesystem and creating actual files for fileset_preallocpercent of them.
- * The created files are filled with fse_size bytes of unitialized data. The
+ * The created files are given fse_size bytes as selected by fs_preallocmode:
+ * zeroes written through the page cache or with O_DIRECT, blocks reserved
+ * with fallocate(), or just the file size for sparse files. The
  * routine returns FILEBENCH_ERROR on errors, FILEBENCH_OK on success.
  */
 static int
@@ -991,6 +1531,7 @@ fileset_create(fileset_t *fileset)
 	int randno;
 	int preallocated = 0;
 	int reusing;
+	int restored;
 	uint64_t preallocpercent;
 	fileset_path = avd_get_str(fileset->fs_path);
 	
@@ -1061,6 +1602,30 @@ fileset_create(fileset_t *fileset)
 	if (fileset->fs_attrs & FILESET_IS_RAW_DEV)
 		return FILEBENCH_OK;
 
+	fileset->fs_constpreallocmode = fileset_preallocmode(fileset);
+	if (fileset->fs_constpreallocmode < 0)
+		return FILEBENCH_ERROR;
+
+	/* content generation is only enabled by an explicit ratio */
+	fileset->fs_constcompress = 0;
+	fileset->fs_constdedupe = 1;
+	if (fileset->fs_compress || fileset->fs_dedupe) {
+		fileset->fs_constcompress = fileset->fs_compress ?
+		    (int)avd_get_int(fileset->fs_compress) : 1;
+		if (fileset->fs_dedupe)
+			fileset->fs_constdedupe =
+			    (int)avd_get_int(fileset->fs_dedupe);
+
+		if (fb_content_check(fileset->fs_constcompress,
+		    fileset->fs_constdedupe) < 0) {
+			filebench_log(LOG_ERROR, "%s %s: compress_ratio and "
+			    "dedupe_ratio must be between 1 and %d",
+			    fileset_entity_name(fileset), fileset_name,
+			    FB_CONTENT_MAXRATIO);
+			return (FILEBENCH_ERROR);
+		}
+	}
+
 	/* XXX Add check to see if there is enough space */
 
 	/* set up path to fileset */
@@ -1081,10 +1646,14 @@ fileset_create(fileset_t *fileset)
 	}
 
 	if (!reusing) {
-		/* Remove existing */
+		char mpath[MAXPATHLEN];
+
+		/* Remove existing, starting with the manifest describing it */
 		filebench_log(LOG_INFO,
 		    "Removing %s tree (if exists)", fileset_name);
 
+		fileset_manifest_path(fileset, mpath);
+		(void) unlink(mpath);
 		FB_RECUR_RM(path);
 	} else {
 		/* we are re-using */
@@ -1092,6 +1661,15 @@ fileset_create(fileset_t *fileset)
 							fileset_name);
 	}
 
+	/*
+	 * With trusttree, a tree restored from its manifest is taken as
+	 * recorded: a file that has gone missing or changed size since the
+	 * manifest was written only shows when a flowop first uses it.
+	 * Otherwise every entry is checked on disk, as in any reused tree.
+	 */
+	restored = reusing && (fileset->fs_attrs & FILESET_FROM_MANIFEST) &&
+	    avd_get_bool(fileset->fs_trust_tree);
+
 	/* make the filesets directory tree unless in reuse mode */
 	if (!reusing) {
 		filebench_log(LOG_INFO,
@@ -1105,6 +1683,10 @@ fileset_create(fileset_t *fileset)
 
 	start = gethrtime();
 
+	/* settle any fallocate fallback before allocation threads run */
+	if (fileset->fs_constpreallocmode == FILESET_PREALLOC_FALLOCATE)
+		fileset_probe_fallocate(fileset, path);
+
 	filebench_log(LOG_INFO,
 		"Pre-allocating files in %s tree", fileset_name);
 
@@ -1160,7 +1742,18 @@ fileset_create(fileset_t *fileset)
 
 		newrand = rand();
 
-		if (randno && newrand <= randno) {
+		/* a restored tree preallocates what existed before */
+		if (reusing && (fileset->fs_attrs & FILESET_FROM_MANIFEST)) {
+			if (!(entry->fse_flags & FSE_PREALLOCATED)) {
+				fileset_unbusy(entry, TRUE, FALSE, 0);
+				continue;
+			}
+			if (restored) {
+				preallocated++;
+				fileset_unbusy(entry, TRUE, TRUE, 0);
+				continue;
+			}
+		} else if (randno && newrand <= randno) {
 			/* unbusy the unallocated entry */
 			fileset_unbusy(entry, TRUE, FALSE, 0);
 			continue;
@@ -1248,7 +1841,17 @@ fileset_create(fileset_t *fileset)
 	while ((entry = fileset_pick(fileset,
 	    FILESET_PICKFREE | FILESET_PICKLEAFDIR, 0, 0))) {
 
-		if (rand() < randno) {
+		if (reusing && (fileset->fs_attrs & FILESET_FROM_MANIFEST)) {
+			if (!(entry->fse_flags & FSE_PREALLOCATED)) {
+				fileset_unbusy(entry, TRUE, FALSE, 0);
+				continue;
+			}
+			if (restored) {
+				preallocated++;
+				fileset_unbusy(entry, TRUE, TRUE, 0);
+				continue;
+			}
+		} else if (rand() < randno) {
 			/* unbusy the unallocated entry */
 			fileset_unbusy(entry, TRUE, FALSE, 0);
 			continue;
@@ -1650,6 +2253,327 @@ fileset_populate_subdir(fileset_t *fileset, filesetentry_t *parent,
 	return (FILEBENCH_OK);
 }
 
+/*
+ * Copies the entries on one of the fileset's lists into the manifest
+ * records starting at recs, placing each at its fse_index. Returns
+ * FILEBENCH_ERROR if an index is out of range, FILEBENCH_OK otherwise.
+ */
+static int
+fileset_manifest_fill(filesetentry_t *list, fileset_manifest_ent_t *recs,
+    uint64_t nrecs)
+{
+	filesetentry_t *entry;
+
+	for (entry = list; entry; entry = entry->fse_nextoftype) {
+		fileset_manifest_ent_t *rec;
+
+		if (entry->fse_index >= nrecs)
+			return (FILEBENCH_ERROR);
+
+		rec = &recs[entry->fse_index];
+		rec->fme_size = (uint64_t)entry->fse_size;
+		rec->fme_parent = entry->fse_parent ?
+		    entry->fse_parent->fse_index : FILESET_MANIFEST_NOPARENT;
+		rec->fme_serial = (uint32_t)atoi(entry->fse_path);
+		rec->fme_flags = entry->fse_flags &
+		    (FSE_TYPE_MASK | FSE_EXISTS);
+		rec->fme_pad = 0;
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Writes the manifest of a created fileset. The manifest is first written
+ * to a temporary file and then renamed, so a partially written manifest is
+ * never picked up. Returns FILEBENCH_OK on success, FILEBENCH_ERROR on
+ * failure, in which case no manifest is left behind.
+ */
+static int
+fileset_manifest_write(fileset_t *fileset)
+{
+	char path[MAXPATHLEN];
+	char tmppath[MAXPATHLEN];
+	fileset_manifest_hdr_t *hdr;
+	fileset_manifest_ent_t *recs;
+	filesetentry_t *entry;
+	uint64_t ndirs = 0;
+	size_t len;
+	ssize_t ret;
+	char *buf;
+	int fd;
+
+	for (entry = fileset->fs_dirlist; entry; entry = entry->fse_nextoftype)
+		ndirs++;
+
+	len = sizeof (fileset_manifest_hdr_t) +
+	    (ndirs + fileset->fs_realfiles + fileset->fs_realleafdirs) *
+	    sizeof (fileset_manifest_ent_t);
+
+	if ((buf = calloc(1, len)) == NULL) {
+		filebench_log(LOG_ERROR,
+		    "Can't allocate manifest for %s", avd_get_str(fileset->fs_name));
+		return (FILEBENCH_ERROR);
+	}
+
+	hdr = (fileset_manifest_hdr_t *)buf;
+	hdr->fmh_magic = FILESET_MANIFEST_MAGIC;
+	hdr->fmh_entries = fileset->fs_constentries;
+	hdr->fmh_leafdirs = fileset->fs_constleafdirs;
+	hdr->fmh_size = AVD_IS_INT(fileset->fs_size) ?
+	    avd_get_int(fileset->fs_size) : 0;
+	hdr->fmh_dirwidth = AVD_IS_INT(fileset->fs_dirwidth) ?
+	    avd_get_int(fileset->fs_dirwidth) : 0;
+	hdr->fmh_ndirs = ndirs;
+	hdr->fmh_nfiles = fileset->fs_realfiles;
+	hdr->fmh_nleafdirs = fileset->fs_realleafdirs;
+	hdr->fmh_bytes = fileset->fs_bytes;
+	hdr->fmh_meandepth = fileset->fs_meandepth;
+
+	recs = (fileset_manifest_ent_t *)(hdr + 1);
+	if ((fileset_manifest_fill(fileset->fs_dirlist, recs,
+	    hdr->fmh_ndirs) != FILEBENCH_OK) ||
+	    (fileset_manifest_fill(fileset->fs_filelist, recs + ndirs,
+	    hdr->fmh_nfiles) != FILEBENCH_OK) ||
+	    (fileset_manifest_fill(fileset->fs_leafdirlist,
+	    recs + ndirs + hdr->fmh_nfiles, hdr->fmh_nleafdirs) !=
+	    FILEBENCH_OK)) {
+		filebench_log(LOG_ERROR, "Inconsistent fileset %s, "
+		    "not writing manifest", avd_get_str(fileset->fs_name));
+		free(buf);
+		return (FILEBENCH_ERROR);
+	}
+
+	fileset_manifest_path(fileset, path);
+	(void) fb_strlcpy(tmppath, path, MAXPATHLEN);
+	(void) fb_strlcat(tmppath, ".tmp", MAXPATHLEN);
+
+	if ((fd = open64(tmppath, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		filebench_log(LOG_ERROR, "Can't create manifest %s: %s",
+		    tmppath, strerror(errno));
+		free(buf);
+		return (FILEBENCH_ERROR);
+	}
+
+	ret = write(fd, buf, len);
+	free(buf);
+
+	if ((ret != (ssize_t)len) || (fsync(fd) < 0)) {
+		filebench_log(LOG_ERROR, "Can't write manifest %s: %s",
+		    tmppath, strerror(errno));
+		(void) close(fd);
+		(void) unlink(tmppath);
+		return (FILEBENCH_ERROR);
+	}
+
+	(void) close(fd);
+
+	if (rename(tmppath, path) < 0) {
+		filebench_log(LOG_ERROR, "Can't rename manifest to %s: %s",
+		    path, strerror(errno));
+		(void) unlink(tmppath);
+		return (FILEBENCH_ERROR);
+	}
+
+	filebench_log(LOG_VERBOSE, "Wrote manifest %s", path);
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Checks that count manifest records are of the given type and point at
+ * a parent directory record below maxparent. Directories must come after
+ * their parent, and only the first directory is allowed to have none.
+ */
+static int
+fileset_manifest_check(fileset_manifest_ent_t *recs, uint64_t count,
+    int type, uint64_t maxparent)
+{
+	uint64_t i;
+
+	for (i = 0; i < count; i++) {
+		uint64_t limit = (type == FSE_TYPE_DIR) ? i : maxparent;
+
+		if ((int)(recs[i].fme_flags & FSE_TYPE_MASK) != type)
+			return (FILEBENCH_ERROR);
+
+		if (recs[i].fme_parent == FILESET_MANIFEST_NOPARENT) {
+			if ((type != FSE_TYPE_DIR) || (i != 0))
+				return (FILEBENCH_ERROR);
+		} else if (recs[i].fme_parent >= limit) {
+			return (FILEBENCH_ERROR);
+		}
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Allocates a filesetentry for a manifest record and puts it on the
+ * appropriate fileset lists, as fileset_populate_file(),
+ * fileset_populate_leafdir() and fileset_populate_subdir() would.
+ */
+static filesetentry_t *
+fileset_manifest_entry(fileset_t *fileset, fileset_manifest_ent_t *rec,
+    filesetentry_t **dirs)
+{
+	char tmpname[16];
+	filesetentry_t *entry;
+
+	entry = (filesetentry_t *)ipc_malloc(FILEBENCH_FILESETENTRY);
+	if (!entry) {
+		filebench_log(LOG_ERROR,
+		    "fileset_manifest_restore: Can't malloc filesetentry");
+		return (NULL);
+	}
+
+	(void) snprintf(tmpname, sizeof (tmpname), "%08d", rec->fme_serial);
+	if ((entry->fse_path = (char *)ipc_pathalloc(tmpname)) == NULL) {
+		filebench_log(LOG_ERROR,
+		    "fileset_manifest_restore: Can't alloc path string");
+		return (NULL);
+	}
+
+	entry->fse_parent = (rec->fme_parent == FILESET_MANIFEST_NOPARENT) ?
+	    NULL : dirs[rec->fme_parent];
+	entry->fse_fileset = fileset;
+
+	(void) ipc_mutex_lock(&fileset->fs_pick_lock);
+	switch (rec->fme_flags & FSE_TYPE_MASK) {
+	case FSE_TYPE_DIR:
+		entry->fse_index = fileset->fs_idle_dirs++;
+		fileset_insdirlist(fileset, entry);
+		break;
+	case FSE_TYPE_LEAFDIR:
+		entry->fse_index = fileset->fs_idle_leafdirs++;
+		fileset_insleafdirlist(fileset, entry);
+		fileset->fs_realleafdirs++;
+		break;
+	default:
+		entry->fse_index = fileset->fs_idle_files++;
+		fileset_insfilelist(fileset, entry);
+		entry->fse_size = (off64_t)rec->fme_size;
+		fileset->fs_bytes += entry->fse_size;
+		fileset->fs_realfiles++;
+		break;
+	}
+	(void) ipc_mutex_unlock(&fileset->fs_pick_lock);
+
+	if (rec->fme_flags & FSE_EXISTS)
+		entry->fse_flags |= FSE_PREALLOCATED;
+
+	return (entry);
+}
+
+/*
+ * Rebuilds the fileset's entry tree from its manifest. Returns FILEBENCH_OK
+ * if the tree was restored, FILEBENCH_NORSC if there is no usable manifest
+ * (missing, corrupt or written for a different fileset definition), in
+ * which case the fileset is left untouched, and FILEBENCH_ERROR if memory
+ * ran out part way through.
+ */
+static int
+fileset_manifest_restore(fileset_t *fileset)
+{
+	char path[MAXPATHLEN];
+	fileset_manifest_hdr_t *hdr;
+	fileset_manifest_ent_t *recs;
+	filesetentry_t **dirs = NULL;
+	struct stat64 sb;
+	uint64_t nrecs;
+	uint64_t i;
+	void *map;
+	int ret = FILEBENCH_NORSC;
+	int fd;
+
+	fileset_manifest_path(fileset, path);
+
+	if ((fd = open64(path, O_RDONLY)) < 0)
+		return (FILEBENCH_NORSC);
+
+	if ((fstat64(fd, &sb) < 0) ||
+	    (sb.st_size < (off64_t)sizeof (fileset_manifest_hdr_t))) {
+		(void) close(fd);
+		return (FILEBENCH_NORSC);
+	}
+
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void) close(fd);
+	if (map == MAP_FAILED)
+		return (FILEBENCH_NORSC);
+
+	hdr = (fileset_manifest_hdr_t *)map;
+	recs = (fileset_manifest_ent_t *)(hdr + 1);
+	nrecs = sb.st_size / sizeof (fileset_manifest_ent_t);
+	if ((hdr->fmh_ndirs <= nrecs) && (hdr->fmh_nfiles <= nrecs) &&
+	    (hdr->fmh_nleafdirs <= nrecs))
+		nrecs = hdr->fmh_ndirs + hdr->fmh_nfiles + hdr->fmh_nleafdirs;
+
+	/* the manifest must describe this very fileset definition */
+	if ((hdr->fmh_magic != FILESET_MANIFEST_MAGIC) ||
+	    (sb.st_size != (off64_t)(sizeof (fileset_manifest_hdr_t) +
+	    nrecs * sizeof (fileset_manifest_ent_t))) ||
+	    (hdr->fmh_entries != fileset->fs_constentries) ||
+	    (hdr->fmh_leafdirs != fileset->fs_constleafdirs) ||
+	    (hdr->fmh_nfiles > hdr->fmh_entries) ||
+	    (hdr->fmh_nleafdirs > hdr->fmh_leafdirs) ||
+	    (hdr->fmh_ndirs == 0) || (hdr->fmh_ndirs > UINT_MAX) ||
+	    (AVD_IS_INT(fileset->fs_size) &&
+	    (hdr->fmh_size != avd_get_int(fileset->fs_size))) ||
+	    (AVD_IS_INT(fileset->fs_dirwidth) &&
+	    (hdr->fmh_dirwidth != avd_get_int(fileset->fs_dirwidth)))) {
+		filebench_log(LOG_INFO, "Manifest %s does not match "
+		    "%s, ignoring it", path, avd_get_str(fileset->fs_name));
+		goto out;
+	}
+
+	if ((fileset_manifest_check(recs, hdr->fmh_ndirs,
+	    FSE_TYPE_DIR, 0) != FILEBENCH_OK) ||
+	    (fileset_manifest_check(recs + hdr->fmh_ndirs, hdr->fmh_nfiles,
+	    FSE_TYPE_FILE, hdr->fmh_ndirs) != FILEBENCH_OK) ||
+	    (fileset_manifest_check(recs + hdr->fmh_ndirs + hdr->fmh_nfiles,
+	    hdr->fmh_nleafdirs, FSE_TYPE_LEAFDIR, hdr->fmh_ndirs) !=
+	    FILEBENCH_OK)) {
+		filebench_log(LOG_INFO, "Manifest %s is corrupt, ignoring it",
+		    path);
+		goto out;
+	}
+
+	dirs = malloc(hdr->fmh_ndirs * sizeof (filesetentry_t *));
+	if (!dirs) {
+		filebench_log(LOG_ERROR,
+		    "fileset_manifest_restore: Can't malloc directory map");
+		ret = FILEBENCH_ERROR;
+		goto out;
+	}
+
+	/* directories first, so all parents exist before their children */
+	for (i = 0; i < nrecs; i++) {
+		filesetentry_t *entry;
+
+		entry = fileset_manifest_entry(fileset, &recs[i], dirs);
+		if (!entry) {
+			ret = FILEBENCH_ERROR;
+			goto out;
+		}
+
+		if (i < hdr->fmh_ndirs)
+			dirs[i] = entry;
+	}
+
+	fileset->fs_meandepth = hdr->fmh_meandepth;
+	fileset->fs_attrs |= FILESET_FROM_MANIFEST;
+
+	filebench_log(LOG_INFO, "Restored %s from manifest %s",
+	    avd_get_str(fileset->fs_name), path);
+	ret = FILEBENCH_OK;
+
+out:
+	free(dirs);
+	(void) munmap(map, sb.st_size);
+	return (ret);
+}
+
 /*
  * Populates a fileset with files and subdirectory entries. Uses the supplied
  * fileset_dirwidth and fileset_entries (number of files) to calculate the
@@ -1743,6 +2667,15 @@ fileset_populate(fileset_t *fileset)
 		    fileset->fs_meandepth;
 	}
 
+	/* a reused fileset is rebuilt from its manifest, if it has one */
+	if (avd_get_bool(fileset->fs_reuse)) {
+		ret = fileset_manifest_restore(fileset);
+		if (ret == FILEBENCH_OK)
+			goto exists;
+		if (ret == FILEBENCH_ERROR)
+			return (ret);
+	}
+
 	if ((ret = fileset_populate_subdir(fileset, NULL, 1, 0)) != 0)
 		return (ret);
 
@@ -1941,9 +2874,177 @@ fileset_createsets()
 	if (filebench_shm->shm_fsparalloc_count < 0)
 		return (FILEBENCH_ERROR);
 
+	/* record reusable filesets so the next run can restore them */
+	for (list = filebench_shm->shm_filesetlist; list; list = list->fs_next) {
+		if ((list->fs_attrs & FILESET_IS_RAW_DEV) ||
+		    !avd_get_bool(list->fs_reuse))
+			continue;
+
+		(void) fileset_manifest_write(list);
+	}
+
 	return 0;
 }
 
+/*
+ * State shared by the page cache control workers, which take existing
+ * files off the fileset's file list one at a time.
+ */
+typedef struct fileset_cachectl_ctl {
+	fileset_t	*fcc_fileset;
+	filesetentry_t	*fcc_next;	/* next file to be taken */
+	int		fcc_op;		/* FILESET_CACHE_* */
+	int		fcc_nfiles;	/* files done */
+	int		fcc_error;
+	pthread_mutex_t	fcc_lock;
+} fileset_cachectl_ctl_t;
+
+/*
+ * Reads a whole file into the page cache the slow way, for when
+ * FB_CACHE_READAHEAD is not supported. Returns 0 on success, -1 on
+ * failure.
+ */
+static int
+fileset_cachectl_read(fb_fdesc_t *fdesc)
+{
+	char *buf;
+	int ret;
+
+	if ((buf = malloc(FILE_ALLOC_BLOCK)) == NULL)
+		return (-1);
+
+	while ((ret = FB_READ(fdesc, buf, FILE_ALLOC_BLOCK)) > 0)
+		;
+
+	free(buf);
+	return (ret);
+}
+
+/*
+ * Page cache control worker. Evicts or prewarms the next existing file
+ * of the fileset until the file list is exhausted or an error occurs.
+ */
+static void *
+fileset_cachectl_thread(fileset_cachectl_ctl_t *ctl)
+{
+	fileset_t *fileset = ctl->fcc_fileset;
+	char path[MAXPATHLEN];
+
+	/* CONSTCOND */
+	while (1) {
+		filesetentry_t *entry;
+		fb_fdesc_t fdesc;
+		char *pathtmp;
+		int ret;
+
+		(void) pthread_mutex_lock(&ctl->fcc_lock);
+		while ((entry = ctl->fcc_next) &&
+		    !(entry->fse_flags & FSE_EXISTS))
+			ctl->fcc_next = entry->fse_nextoftype;
+		if (entry)
+			ctl->fcc_next = entry->fse_nextoftype;
+		(void) pthread_mutex_unlock(&ctl->fcc_lock);
+
+		if (!entry || ctl->fcc_error)
+			break;
+
+		(void) fb_strlcpy(path, avd_get_str(fileset->fs_path),
+		    MAXPATHLEN);
+		(void) fb_strlcat(path, "/", MAXPATHLEN);
+		(void) fb_strlcat(path, avd_get_str(fileset->fs_name),
+		    MAXPATHLEN);
+		pathtmp = fileset_resolvepath(entry);
+		(void) fb_strlcat(path, pathtmp, MAXPATHLEN);
+		free(pathtmp);
+
+		if (FB_OPEN(&fdesc, path, O_RDONLY, 0) == FILEBENCH_ERROR) {
+			filebench_log(LOG_ERROR, "Failed to open file %s: %s",
+			    path, strerror(errno));
+			ctl->fcc_error = 1;
+			break;
+		}
+
+		if (ctl->fcc_op == FILESET_CACHE_EVICT) {
+			ret = FB_CACHECTL(&fdesc, FB_CACHE_DONTNEED, 0, 0);
+		} else if ((ret = FB_CACHECTL(&fdesc,
+		    FB_CACHE_READAHEAD, 0, 0)) < 0) {
+			ret = fileset_cachectl_read(&fdesc);
+		}
+
+		(void) FB_CLOSE(&fdesc);
+
+		if (ret < 0) {
+			filebench_log(LOG_ERROR, "Failed to %s file %s: %s",
+			    ctl->fcc_op == FILESET_CACHE_EVICT ?
+			    "evict" : "prewarm", path, strerror(errno));
+			ctl->fcc_error = 1;
+			break;
+		}
+
+		(void) pthread_mutex_lock(&ctl->fcc_lock);
+		ctl->fcc_nfiles++;
+		(void) pthread_mutex_unlock(&ctl->fcc_lock);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Evicts all existing files of the fileset from the page cache, or reads
+ * them all into it, as selected by op (FILESET_CACHE_EVICT or
+ * FILESET_CACHE_PREWARM). The files are processed by up to
+ * MAX_PARALLOC_THREADS threads in parallel, so that warm and cold cache
+ * runs can be set up without dropping the caches system wide. Returns
+ * FILEBENCH_OK on success, FILEBENCH_ERROR on failure.
+ */
+int
+fileset_cachectl(fileset_t *fileset, int op)
+{
+	pthread_t tids[MAX_PARALLOC_THREADS];
+	fileset_cachectl_ctl_t ctl;
+	int nthreads;
+	int i;
+
+	if (fileset->fs_attrs & FILESET_IS_RAW_DEV) {
+		filebench_log(LOG_INFO, "Skipping page cache control of "
+		    "RAW device %s", avd_get_str(fileset->fs_name));
+		return (FILEBENCH_OK);
+	}
+
+	(void) memset(&ctl, 0, sizeof (ctl));
+	ctl.fcc_fileset = fileset;
+	ctl.fcc_next = fileset->fs_filelist;
+	ctl.fcc_op = op;
+	(void) pthread_mutex_init(&ctl.fcc_lock, NULL);
+
+	nthreads = MIN(MAX_PARALLOC_THREADS, MAX(fileset->fs_realfiles, 1));
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&tids[i], NULL,
+		    (void *(*)(void*))fileset_cachectl_thread, &ctl) != 0) {
+			filebench_log(LOG_ERROR,
+			    "Failed to create page cache control thread: %s",
+			    strerror(errno));
+			ctl.fcc_error = 1;
+			break;
+		}
+	}
+
+	while (i-- > 0)
+		(void) pthread_join(tids[i], NULL);
+
+	(void) pthread_mutex_destroy(&ctl.fcc_lock);
+
+	if (ctl.fcc_error)
+		return (FILEBENCH_ERROR);
+
+	filebench_log(LOG_INFO, "%s %d files of %s %s",
+	    op == FILESET_CACHE_EVICT ? "Evicted" : "Prewarmed",
+	    ctl.fcc_nfiles, fileset_entity_name(fileset),
+	    avd_get_str(fileset->fs_name));
+
+	return (FILEBENCH_OK);
+}
+
 /*
  * Searches through the master fileset list for the named fileset.
  * If found, returns pointer to same, otherwise returns NULL.
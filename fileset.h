@@ -42,6 +42,7 @@
 #define	FSE_BUSY		0x10
 #define	FSE_REUSING		0x20
 #define	FSE_THRD_WAITNG		0x40
+#define	FSE_PREALLOCATED	0x80	/* existed when manifest was written */
 
 typedef struct filesetentry {
 	struct filesetentry	*fse_next;	/* master list of entries */
@@ -76,6 +77,20 @@ typedef struct filesetentry {
 /* fileset attributes */
 #define	FILESET_IS_RAW_DEV  0x01 /* fileset is a raw device */
 #define	FILESET_IS_FILE	    0x02 /* Fileset is emulating a single file */
+#define	FILESET_FROM_MANIFEST 0x04 /* Entries were restored from manifest */
+
+/* how preallocated files get their blocks */
+#define	FILESET_PREALLOC_WRITE	   0 /* write zeroes through the page cache */
+#define	FILESET_PREALLOC_FALLOCATE 1 /* reserve blocks, write no data */
+#define	FILESET_PREALLOC_SPARSE	   2 /* only set the size (ftruncate) */
+#define	FILESET_PREALLOC_ODIRECT   3 /* write zeroes with O_DIRECT */
+
+/* alignment of prealloc buffer, sizes and offsets for O_DIRECT writes */
+#define	FILESET_PREALLOC_ALIGN	4096
+
+/* fileset wide page cache operations for fileset_cachectl() */
+#define	FILESET_CACHE_EVICT	0 /* drop the files from the page cache */
+#define	FILESET_CACHE_PREWARM	1 /* read the files into the page cache */
 
 typedef struct fileset {
 	struct fileset	*fs_next;	/* Next in list */
@@ -89,6 +104,12 @@ typedef struct fileset {
 	fbint_t		fs_constleafdirs; /* Constant version of leafdirs */
 					    /* attr */
 	avd_t		fs_preallocpercent; /* Prealloc size */
+	avd_t		fs_preallocmode; /* Prealloc method attr */
+	int		fs_constpreallocmode; /* Resolved FILESET_PREALLOC_* */
+	avd_t		fs_compress;	/* Content compress ratio attr */
+	avd_t		fs_dedupe;	/* Content dedupe ratio attr */
+	int		fs_constcompress; /* Resolved compress ratio, 0 if unset */
+	int		fs_constdedupe;	/* Resolved dedupe ratio */
 	int		fs_attrs;	/* Attributes */
 	avd_t		fs_dirwidth;	/* Explicit or mean for distribution */
 	avd_t		fs_dirdepthrv;	/* random variable for dir depth */
@@ -98,6 +119,7 @@ typedef struct fileset {
 					/* to 0 for explicit depth */
 	avd_t		fs_create;	/* Attr */
 	avd_t		fs_paralloc;	/* Attr */
+	avd_t		fs_mkdirnode;	/* NUMA node to make dirs from */
 	avd_t		fs_reuse;	/* Attr */
 	avd_t		fs_readonly;	/* Attr */
 	avd_t		fs_writeonly;	/* Attr */
@@ -143,6 +165,7 @@ typedef struct fileset {
 } fileset_t;
 
 int fileset_createsets();
+int fileset_cachectl(fileset_t *fileset, int op);
 
 void fileset_delete_all_filesets(void);
 int fileset_openfile(fb_fdesc_t *fd, fileset_t *fileset,
@@ -152,6 +175,8 @@ fileset_t *fileset_find(char *name);
 filesetentry_t *fileset_pick(fileset_t *fileset, int flags, int tid,
     int index);
 char *fileset_resolvepath(filesetentry_t *entry);
+int fileset_entrypath(fileset_t *fileset, filesetentry_t *entry,
+    char *path, int mkparent);
 int fileset_iter(int (*cmd)(fileset_t *fileset, int first));
 int fileset_print(fileset_t *fileset, int first);
 void fileset_unbusy(filesetentry_t *entry, int update_exist,
@@ -33,6 +33,7 @@
 #include "flowop.h"
 #include "stats.h"
 #include "ioprio.h"
+#include "fb_hugepage.h"
 
 static flowop_t *flowop_define_common(threadflow_t *threadflow, char *name,
     flowop_t *inherit, flowop_t **flowoplist_hdp, int instance, int type);
@@ -161,18 +162,19 @@ flowop_populate_distribution(flowop_t *flowop,  unsigned long long ll_delay)
 }
 
 /*
- * Updates flowop's latency statistics, using saved start
+ * Updates flowop's latency statistics with the supplied start
  * time and current high resolution time. Updates flowop's
  * io count and transferred bytes statistics. Also updates
  * threadflow's and flowop's cumulative read or write byte
  * and io count statistics.
  */
-void
-flowop_endop(threadflow_t *threadflow, flowop_t *flowop, int64_t bytes)
+static void
+flowop_endop_since(threadflow_t *threadflow, flowop_t *flowop,
+    hrtime_t stime, int64_t bytes)
 {
 	unsigned long long ll_delay;
 
-	ll_delay = (gethrtime() - threadflow->tf_stime);
+	ll_delay = (gethrtime() - stime);
 
 	/* setting minimum and maximum latencies for this flowop */
 	if (!flowop->fo_stats.fs_minlat || ll_delay < flowop->fo_stats.fs_minlat)
@@ -187,6 +189,7 @@ flowop_endop(threadflow_t *threadflow, flowop_t *flowop, int64_t bytes)
 	(void) ipc_mutex_lock(&controlstats_lock);
 	if ((flowop->fo_type & FLOW_TYPE_IO) ||
 	    (flowop->fo_type & FLOW_TYPE_AIO)) {
+		threadflow->tf_ioops++;
 		controlstats.fs_count++;
 		controlstats.fs_bytes += bytes;
 	}
@@ -210,6 +213,206 @@ flowop_endop(threadflow_t *threadflow, flowop_t *flowop, int64_t bytes)
 	(void) ipc_mutex_unlock(&controlstats_lock);
 }
 
+/*
+ * Updates flowop's statistics for an operation that began
+ * at the threadflow's saved start time.
+ */
+void
+flowop_endop(threadflow_t *threadflow, flowop_t *flowop, int64_t bytes)
+{
+	flowop_endop_since(threadflow, flowop, threadflow->tf_stime, bytes);
+}
+
+/*
+ * Takes an asynchronous I/O request of the given type from the
+ * threadflow's preallocated ring, stamps it with the submitting flowop
+ * and the submit time and adds it to the threadflow's in flight array.
+ * The ring is allocated on first use. Returns NULL if all
+ * THREADFLOW_MAXAIO requests are already in flight.
+ */
+aiolist_t *
+flowop_aio_get(threadflow_t *threadflow, flowop_t *flowop, int type)
+{
+	aiolist_t *aio;
+	int i;
+
+	if (threadflow->tf_aioring == NULL) {
+		threadflow->tf_aioring = calloc(THREADFLOW_MAXAIO,
+		    sizeof (aiolist_t));
+		threadflow->tf_aiopending = calloc(THREADFLOW_MAXAIO,
+		    sizeof (aiolist_t *));
+#ifdef HAVE_AIO
+		threadflow->tf_aiocbs = calloc(THREADFLOW_MAXAIO,
+		    sizeof (struct aiocb64 *));
+		if (threadflow->tf_aiocbs == NULL)
+			threadflow->tf_aioring = NULL;
+#endif
+		if ((threadflow->tf_aioring == NULL) ||
+		    (threadflow->tf_aiopending == NULL)) {
+			filebench_log(LOG_ERROR, "malloc aiolist failed");
+			filebench_shutdown(1);
+		}
+
+		for (i = 0; i < THREADFLOW_MAXAIO - 1; i++)
+			threadflow->tf_aioring[i].al_next =
+			    &threadflow->tf_aioring[i + 1];
+		threadflow->tf_aiofree = threadflow->tf_aioring;
+	}
+
+	if ((aio = threadflow->tf_aiofree) == NULL)
+		return (NULL);
+
+	threadflow->tf_aiofree = aio->al_next;
+	aio->al_next = NULL;
+	aio->al_type = type;
+	aio->al_flowop = flowop;
+	aio->al_index = threadflow->tf_aiocount++;
+	threadflow->tf_aiopending[aio->al_index] = aio;
+#ifdef HAVE_AIO
+	threadflow->tf_aiocbs[aio->al_index] =
+	    (type & AL_URING) ? NULL : &aio->al_aiocb;
+#endif
+	aio->al_stime = gethrtime();
+
+	return (aio);
+}
+
+/*
+ * Completes an asynchronous I/O request that transferred the given
+ * number of bytes: records its latency, measured from its submit time,
+ * and its bytes against the flowop that submitted it, then moves the
+ * last in flight request into its slot and returns it to the free list.
+ */
+void
+flowop_aio_done(threadflow_t *threadflow, aiolist_t *aio, int64_t bytes)
+{
+	aiolist_t *last;
+
+	flowop_endop_since(threadflow, aio->al_flowop, aio->al_stime, bytes);
+
+	last = threadflow->tf_aiopending[--threadflow->tf_aiocount];
+	last->al_index = aio->al_index;
+	threadflow->tf_aiopending[last->al_index] = last;
+#ifdef HAVE_AIO
+	threadflow->tf_aiocbs[last->al_index] =
+	    threadflow->tf_aiocbs[threadflow->tf_aiocount];
+#endif
+
+	aio->al_next = threadflow->tf_aiofree;
+	threadflow->tf_aiofree = aio;
+}
+
+/*
+ * Frees the threadflow's asynchronous I/O request ring on thread exit.
+ * Posix aio requests still in flight are cancelled, and waited for if
+ * they cannot be, since their aiocbs live in the ring. io_uring
+ * requests in flight are reaped first, as their user_data points into
+ * the ring.
+ */
+static void
+flowop_aio_fini(threadflow_t *threadflow)
+{
+#ifdef HAVE_AIO
+	const struct aiocb64 *aiocb;
+	int i;
+#endif
+
+	if (threadflow->tf_aioring == NULL)
+		return;
+
+	while (fb_uring_reap_async(TRUE) > 0)
+		;
+
+#ifdef HAVE_AIO
+	for (i = 0; i < threadflow->tf_aiocount; i++) {
+		if ((aiocb = threadflow->tf_aiocbs[i]) == NULL)
+			continue;
+		if (aio_cancel64(aiocb->aio_fildes,
+		    (struct aiocb64 *)aiocb) != AIO_NOTCANCELED)
+			continue;
+		while (aio_error64(aiocb) == EINPROGRESS)
+			(void) aio_suspend64(&aiocb, 1, NULL);
+	}
+
+	free(threadflow->tf_aiocbs);
+	threadflow->tf_aiocbs = NULL;
+#endif
+	free(threadflow->tf_aiopending);
+	free(threadflow->tf_aioring);
+	threadflow->tf_aiopending = NULL;
+	threadflow->tf_aioring = NULL;
+	threadflow->tf_aiofree = NULL;
+	threadflow->tf_aiocount = 0;
+}
+
+/*
+ * Resolves an integer attribute for flowop_resolve_attrs(): returns its
+ * value, or sets flag in fo_varattrs and returns 0 if it is a random or
+ * custom variable that must be sampled on every use.
+ */
+static fbint_t
+flowop_constint(flowop_t *flowop, avd_t avd, int flag)
+{
+	if (avd == NULL)
+		return (0);
+
+	if (!avd_is_const(avd)) {
+		flowop->fo_varattrs |= flag;
+		return (0);
+	}
+
+	return (avd_get_int(avd));
+}
+
+/*
+ * Returns flag if the boolean attribute is set, 0 otherwise.
+ */
+static int
+flowop_constbool(avd_t avd, int flag)
+{
+	return ((avd && avd_get_bool(avd)) ? flag : 0);
+}
+
+/*
+ * Resolves the attributes that the flowops look at on every execution into
+ * plain values, so that only random and custom variables are evaluated
+ * through their avds at run time. Variables can't change once the run has
+ * started, so the values hold for the life of the runtime flowop.
+ */
+static void
+flowop_resolve_attrs(flowop_t *flowop)
+{
+	flowop->fo_varattrs = 0;
+
+	if (flowop->fo_value && !avd_is_const(flowop->fo_value))
+		flowop->fo_varattrs |= FLOW_VAR_VALUE;
+
+	flowop->fo_constiosize = flowop_constint(flowop, flowop->fo_iosize,
+	    FLOW_VAR_IOSIZE);
+	flowop->fo_constiters = flowop_constint(flowop, flowop->fo_iters,
+	    FLOW_VAR_ITERS);
+	flowop->fo_constcompress = flowop_constint(flowop,
+	    flowop->fo_compress, FLOW_VAR_COMPRESS);
+	flowop->fo_constdedupe = flowop_constint(flowop, flowop->fo_dedupe,
+	    FLOW_VAR_DEDUPE);
+	flowop->fo_constiovcnt = flowop_constint(flowop, flowop->fo_iovcnt,
+	    FLOW_VAR_IOVCNT);
+	flowop->fo_constalign = flowop_constint(flowop, flowop->fo_align,
+	    FLOW_VAR_ALIGN);
+
+	flowop->fo_boolattrs =
+	    flowop_constbool(flowop->fo_random, FLOW_BOOL_RANDOM) |
+	    flowop_constbool(flowop->fo_dsync, FLOW_BOOL_DSYNC) |
+	    flowop_constbool(flowop->fo_blocking, FLOW_BOOL_BLOCKING) |
+	    flowop_constbool(flowop->fo_directio, FLOW_BOOL_DIRECTIO) |
+	    flowop_constbool(flowop->fo_rotatefd, FLOW_BOOL_ROTATEFD) |
+	    flowop_constbool(flowop->fo_noreadahead, FLOW_BOOL_NOREADAHEAD) |
+	    flowop_constbool(flowop->fo_populate, FLOW_BOOL_POPULATE) |
+	    flowop_constbool(flowop->fo_mapsync, FLOW_BOOL_MAPSYNC) |
+	    flowop_constbool(flowop->fo_samedir, FLOW_BOOL_SAMEDIR) |
+	    flowop_constbool(flowop->fo_withstat, FLOW_BOOL_WITHSTAT);
+}
+
 /*
  * Calls the flowop's initialization function, pointed to by
  * flowop->fo_init.
@@ -227,6 +430,8 @@ flowop_initflow(flowop_t *flowop)
 	if (flowop->fo_wss)
 		flowop->fo_constwss = avd_get_int(flowop->fo_wss);
 
+	flowop_resolve_attrs(flowop);
+
 	if ((*flowop->fo_init)(flowop) < 0) {
 		filebench_log(LOG_ERROR, "flowop %s-%d init failed",
 		    flowop->fo_name, flowop->fo_instance);
@@ -318,6 +523,187 @@ flowop_destruct_all_flows(threadflow_t *threadflow)
 	}
 }
 
+/*
+ * Returns the alignment of the thread's memory: a page, or the largest
+ * constant align attribute of its flowops if that is larger. Aligns
+ * that vary, or that are not powers of two, are checked against the
+ * memory on each use by flowoplib_iobufsetup().
+ */
+static size_t
+flowop_memalign(threadflow_t *threadflow)
+{
+	flowop_t *flowop;
+	size_t align = (size_t)getpagesize();
+
+	for (flowop = threadflow->tf_thrd_fops; flowop != NULL;
+	    flowop = flowop->fo_exec_next) {
+		if ((flowop->fo_align == NULL) ||
+		    (flowop->fo_varattrs & FLOW_VAR_ALIGN))
+			continue;
+		if ((flowop->fo_constalign & (flowop->fo_constalign - 1)) == 0)
+			align = MAX(align, (size_t)flowop->fo_constalign);
+	}
+
+	return (align);
+}
+
+/*
+ * Fills in the flowop_exec_t of step of the main loop to run flowop.
+ */
+static void
+flowop_compile_step(flowop_exec_t *exec, int step, flowop_t *flowop)
+{
+	flowop_exec_t *fe = &exec[step];
+
+	fe->fe_func = flowop->fo_func;
+	fe->fe_flowop = flowop;
+	fe->fe_iters = (flowop->fo_varattrs & FLOW_VAR_ITERS) ? -1 :
+	    (int)flowop->fo_constiters;
+	fe->fe_next = step + 1;
+}
+
+/*
+ * Lays out the mix block starting at *flowopp from step count on, into
+ * exec if it is not NULL: a step that picks one of the branches through
+ * an alias table over their weights, then the branches one after the
+ * other, the last step of each continuing after the block. Advances
+ * *flowopp past the block and returns the step after it, or -1 if the
+ * alias table can't be allocated.
+ */
+static int
+flowop_compile_mix(flowop_t **flowopp, flowop_exec_t *exec, int count)
+{
+	flowop_t *flowop = *flowopp;
+	flowop_exec_t *head = NULL;
+	uint64_t *weights = NULL;
+	int nbranches = flowop->fo_mixbranches;
+	int b, j, len;
+
+	if (exec) {
+		head = &exec[count];
+		weights = malloc(nbranches * sizeof (uint64_t));
+		head->fe_branch = malloc(nbranches * sizeof (int));
+		if ((weights == NULL) || (head->fe_branch == NULL)) {
+			free(weights);
+			return (-1);
+		}
+	}
+	count++;
+
+	for (b = 0; (b < nbranches) && flowop; b++) {
+		if (exec) {
+			weights[b] = flowop->fo_weight;
+			head->fe_branch[b] = count;
+		}
+		len = flowop->fo_branchlen;
+		for (j = 0; (j < len) && flowop; j++) {
+			if (exec)
+				flowop_compile_step(exec, count, flowop);
+			count++;
+			flowop = flowop->fo_exec_next;
+		}
+	}
+	*flowopp = flowop;
+
+	if (exec == NULL)
+		return (count);
+
+	/* the end of each branch is just before the start of the next */
+	head->fe_next = count;
+	for (j = 1; j < b; j++)
+		exec[head->fe_branch[j] - 1].fe_next = count;
+
+	head->fe_mix = fb_alias_alloc(weights, b);
+	free(weights);
+
+	return ((head->fe_mix == NULL) ? -1 : count);
+}
+
+/*
+ * Lays out the flowop list starting at flowop into exec, if it is not
+ * NULL, and returns the number of steps, or -1 if a mix block's alias
+ * table can't be allocated. A repeat block is laid out once, and its
+ * last step loops back to its first until the block has run fo_repeat
+ * times, so that the steps don't grow with the repeat count. Every run
+ * updates the same flowop stats.
+ */
+static int
+flowop_compile_list(flowop_t *flowop, flowop_exec_t *exec)
+{
+	int count = 0;
+	int first, repeat, len, j;
+
+	while (flowop) {
+		if (flowop->fo_mixbranches > 0) {
+			count = flowop_compile_mix(&flowop, exec, count);
+			if (count < 0)
+				return (-1);
+			continue;
+		}
+
+		first = count;
+		repeat = flowop->fo_repeat;
+		len = (repeat > 1) ? flowop->fo_repeatlen : 1;
+
+		for (j = 0; (j < len) && flowop; j++) {
+			if (exec)
+				flowop_compile_step(exec, count, flowop);
+			count++;
+			flowop = flowop->fo_exec_next;
+		}
+
+		if (exec && (repeat > 1)) {
+			exec[count - 1].fe_repeat = repeat;
+			exec[count - 1].fe_loop = first;
+		}
+	}
+
+	return (count);
+}
+
+/*
+ * Frees an array of count steps made by flowop_compile(), along with
+ * the alias tables of its mix blocks.
+ */
+static void
+flowop_free_exec(flowop_exec_t *exec, int count)
+{
+	int step;
+
+	for (step = 0; step < count; step++) {
+		fb_alias_free(exec[step].fe_mix);
+		free(exec[step].fe_branch);
+	}
+	free(exec);
+}
+
+/*
+ * Lays the runtime flowops of a thread out as a flat, process private
+ * array of flowop_exec_t for the main loop of flowop_start(), so that it
+ * steps through contiguous memory rather than following fo_exec_next
+ * through the shared memory. Returns the array and sets *countp to the
+ * number of steps, or returns NULL if the array can't be allocated.
+ */
+static flowop_exec_t *
+flowop_compile(threadflow_t *threadflow, int *countp)
+{
+	flowop_exec_t *exec;
+	int count;
+
+	count = flowop_compile_list(threadflow->tf_thrd_fops, NULL);
+
+	if ((exec = calloc(MAX(count, 1), sizeof (flowop_exec_t))) == NULL)
+		return (NULL);
+
+	if (flowop_compile_list(threadflow->tf_thrd_fops, exec) < 0) {
+		flowop_free_exec(exec, count);
+		return (NULL);
+	}
+
+	*countp = count;
+	return (exec);
+}
+
 /*
  * The final initialization and main execution loop for the
  * worker threads. Sets threadflow and flowop start times,
@@ -334,6 +720,8 @@ void
 flowop_start(threadflow_t *threadflow)
 {
 	flowop_t *flowop;
+	flowop_exec_t *exec = NULL, *fe;
+	int nexec = 0, step = 0;
 	size_t memsize;
 	int ret = FILEBENCH_OK;
 
@@ -356,16 +744,23 @@ flowop_start(threadflow_t *threadflow)
 	if (flowop_create_runtime_flowops(threadflow, &threadflow->tf_thrd_fops)
 	    != FILEBENCH_OK) {
 		(void) ipc_mutex_unlock(&filebench_shm->shm_flowop_lock);
+		(void) pthread_rwlock_unlock(
+		    &filebench_shm->shm_flowop_find_lock);
 		filebench_shutdown(1);
-		return;
+		goto out;
 	}
 	(void) ipc_mutex_unlock(&filebench_shm->shm_flowop_lock);
 
 	/* Release the find lock as reader to allow lookups */
 	(void) pthread_rwlock_unlock(&filebench_shm->shm_flowop_find_lock);
 
-	/* Set to the start of the new flowop list */
-	flowop = threadflow->tf_thrd_fops;
+	/* Lay the new flowop list out for the main loop */
+	if ((exec = flowop_compile(threadflow, &nexec)) == NULL) {
+		filebench_log(LOG_ERROR, "Out of memory for the flowops of "
+		    "thread %s", threadflow->tf_name);
+		filebench_shutdown(1);
+		goto out;
+	}
 
 #ifdef HAVE_LWPS
 	filebench_log(LOG_DEBUG_SCRIPT, "Thread %zx (%d) started",
@@ -398,6 +793,14 @@ flowop_start(threadflow_t *threadflow)
 
 	memsize = (size_t)threadflow->tf_constmemsize;
 
+	/* same numbers on every run with the same seed */
+	fb_random_seed(&threadflow->tf_rand, filebench_shm->shm_rand_seed,
+	    threadflow->tf_utid);
+	fb_random_thread(&threadflow->tf_rand);
+
+	if (threadflow->tf_hugepages == FB_HUGEPAGES_DEFAULT)
+		threadflow->tf_hugepages = filebench_shm->shm_hugepages;
+
 	/*
 	 * Alloc from ISM, which should have been created before the main process
 	 * wakes up the current process by releasing shm_run_lock.
@@ -406,13 +809,21 @@ flowop_start(threadflow_t *threadflow)
 		threadflow->tf_mem =
 		    ipc_ismmalloc(memsize);
 	} else {
-		threadflow->tf_mem =
-		    malloc(memsize);
+		/*
+		 * aligned for the flowops' align attributes, so that direct
+		 * I/O can use aligned slices, and on huge pages if the
+		 * thread or script asks for them
+		 */
+		threadflow->tf_mem = fb_hugepage_alloc(memsize,
+		    flowop_memalign(threadflow), threadflow->tf_hugepages);
 	}
 
 	(void) memset(threadflow->tf_mem, 0, memsize);
 	filebench_log(LOG_DEBUG_SCRIPT, "Thread allocated %d bytes", memsize);
 
+	/* let io_uring do fixed buffer I/O to and from tf_mem */
+	fb_uring_regbuf(threadflow->tf_mem, memsize);
+
 	/* Main filebench worker loop */
 	while (ret == FILEBENCH_OK) {
 		int i, count;
@@ -433,20 +844,27 @@ flowop_start(threadflow_t *threadflow)
 			continue;
 		}
 
-		if (flowop == NULL) {
+		if (nexec == 0) {
 			filebench_log(LOG_ERROR, "flowop_read null flowop");
-			return;
+			break;
 		}
 
+		fe = &exec[step];
+		if (fe->fe_mix)
+			fe = &exec[fe->fe_branch[fb_alias_pick(
+			    &threadflow->tf_rand, fe->fe_mix)]];
+		flowop = fe->fe_flowop;
+
 		/* Execute the flowop for fo_iters times */
-		count = (int)avd_get_int(flowop->fo_iters);
+		count = (fe->fe_iters >= 0) ? fe->fe_iters :
+		    (int)avd_get_int(flowop->fo_iters);
 		for (i = 0; i < count; i++) {
 
 			filebench_log(LOG_DEBUG_SCRIPT, "%s: executing flowop "
 			    "%s-%d", threadflow->tf_name, flowop->fo_name,
 			    flowop->fo_instance);
 
-			ret = (*flowop->fo_func)(threadflow, flowop);
+			ret = (*fe->fe_func)(threadflow, flowop);
 
 			/*
 			 * Return value FILEBENCH_ERROR means "flowop
@@ -526,16 +944,25 @@ flowop_start(threadflow_t *threadflow)
 			}
 		}
 
-		/* advance to next flowop */
-		flowop = flowop->fo_exec_next;
+		/* advance to next flowop, or rerun the repeat block it ends */
+		if (fe->fe_repeat && (++fe->fe_runs < fe->fe_repeat)) {
+			step = fe->fe_loop;
+		} else {
+			fe->fe_runs = 0;
+			step = fe->fe_next;
+		}
 
 		/* but if at end of list, start over from the beginning */
-		if (flowop == NULL) {
-			flowop = threadflow->tf_thrd_fops;
+		if (step == nexec) {
+			step = 0;
 			threadflow->tf_stats.fs_count++;
 		}
 	}
 
+out:
+	/* every exit of the thread comes here to release its state */
+	flowop_free_exec(exec, nexec);
+
 #ifdef HAVE_LWPS
 	filebench_log(LOG_DEBUG_SCRIPT, "Thread %d exiting",
 	    _lwp_self());
@@ -544,6 +971,9 @@ flowop_start(threadflow_t *threadflow)
 	/* Tell flowops to destroy locally acquired state */
 	flowop_destruct_all_flows(threadflow);
 
+	flowoplib_thread_fini(threadflow);
+	flowop_aio_fini(threadflow);
+
 	pthread_exit(&threadflow->tf_abort);
 }
 
@@ -567,6 +997,9 @@ flowop_init(int ismaster)
 			fb_lfs_newflowops();
 		fb_lfs_funcvecinit();
 		break;
+	case IO_URING_PLUG:
+		(void) fb_uring_funcvecinit();
+		break;
 	case NFS3_PLUG:
 	case NFS4_PLUG:
 	case CIFS_PLUG:
@@ -1007,7 +1440,7 @@ flowop_composite(threadflow_t *threadflow, flowop_t *flowop)
 			return (FILEBENCH_DONE);
 
 		/* Execute the flowop for fo_iters times */
-		count = (int)avd_get_int(inner_flowop->fo_iters);
+		count = (int)FLOWOP_INT(inner_flowop, iters, FLOW_VAR_ITERS);
 		for (i = 0; i < count; i++) {
 
 			filebench_log(LOG_DEBUG_SCRIPT, "%s: executing flowop "
@@ -27,12 +27,21 @@
 #define	_FB_FLOWOP_H
 
 #include "filebench.h"
+#include "fb_random.h"
+
+/* Size of the cache lines that flowop_t keeps its hot fields apart on */
+#define	FLOWOP_CACHELINE	64
 
 typedef struct flowop {
 	char		fo_name[128];	/* Name */
 	int		fo_instance;	/* Instance number */
 	struct flowop	*fo_next;	/* Next in global list */
 	struct flowop	*fo_exec_next;	/* Next in thread's or compfo's list */
+	int		fo_repeat;	/* Runs of the repeat block starting here */
+	int		fo_repeatlen;	/* Flowops in that repeat block */
+	int		fo_mixbranches;	/* Branches of the mix starting here */
+	int		fo_weight;	/* Weight of the mix branch starting here */
+	int		fo_branchlen;	/* Flowops in that mix branch */
 	struct flowop	*fo_resultnext;	/* List of flowops in result */
 	struct flowop	*fo_comp_fops;	/* List of flowops in composite fo */
 	var_t		*fo_lvar_list;	/* List of composite local vars */
@@ -46,8 +55,6 @@ typedef struct flowop {
 	fileset_t	*fo_fileset;	/* Fileset for op */
 	int		fo_fdnumber;	/* User specified file descriptor */
 	int		fo_srcfdnumber;	/* User specified src file descriptor */
-	fbint_t		fo_constvalue;	/* constant version of fo_value */
-	fbint_t		fo_constwss;	/* constant version of fo_wss */
 	avd_t		fo_iosize;	/* Size of operation */
 	avd_t		fo_wss;		/* Flow op working set size */
 	char		fo_targetname[128]; /* Target, for wakeup etc... */
@@ -65,7 +72,25 @@ typedef struct flowop {
 	avd_t		fo_rotatefd;	/* Attr */
 	avd_t		fo_fileindex;	/* Attr */
 	avd_t		fo_noreadahead; /* Attr */
-	struct flowstats	fo_stats;	/* Flow statistics */
+	avd_t		fo_compress;	/* Content compress ratio attr */
+	avd_t		fo_dedupe;	/* Content dedupe ratio attr */
+	uint64_t	fo_content_stamp; /* Content tag counter */
+	avd_t		fo_advice;	/* Page cache advice attr */
+	avd_t		fo_populate;	/* Prefault mappings attr */
+	avd_t		fo_mapsync;	/* Synchronous DAX mappings attr */
+	avd_t		fo_storemode;	/* Persistent memory store mode attr */
+	int		fo_pmemmode;	/* FB_PMEM_* version of fo_storemode */
+	avd_t		fo_iovcnt;	/* I/O vector segments attr */
+	avd_t		fo_rwflags;	/* preadv2/pwritev2 flags attr */
+	int		fo_rwflagset;	/* FB_RWF_* version of fo_rwflags */
+	avd_t		fo_samedir;	/* Rename within the directory attr */
+	avd_t		fo_bufsize;	/* getdents64 buffer size attr */
+	avd_t		fo_withstat;	/* Stat listed entries attr */
+	avd_t		fo_offset;	/* Sync range offset attr */
+	avd_t		fo_syncflags;	/* sync_file_range flags attr */
+	int		fo_syncflagset;	/* FB_SFR_* version of fo_syncflags */
+	avd_t		fo_align;	/* I/O buffer alignment attr */
+	int		fo_dioalign;	/* Direct I/O alignment of the files */
 	pthread_cond_t	fo_cv;		/* Block/wakeup cv */
 	pthread_mutex_t	fo_lock;	/* Mutex around flowop */
 	void		*fo_private;	/* Flowop private scratch pad area */
@@ -77,15 +102,65 @@ typedef struct flowop {
 #else
 	sem_t		fo_sem;		/* sem_t for posix semaphores */
 #endif /* HAVE_SYSV_SEM */
+	int		fo_grp_refs;	/* groupsync instances joined, master only */
+	int		fo_grp_active;	/* groupsync leader is syncing */
+	int		fo_grp_waiters;	/* groupsync threads on the semaphore */
+	int		fo_grp_error;	/* errno of the latest groupsync sync */
+	uint64_t	fo_grp_started;	/* groupsync syncs started */
+	uint64_t	fo_grp_done;	/* groupsync syncs completed */
 	avd_t		fo_highwater;	/* value of highwater paramter */
 	void		*fo_idp;	/* id, for sems etc */
 	hrtime_t	fo_timestamp;	/* for ratecontrol, etc... */
 	int		fo_initted;	/* Set to one if initialized */
 	int64_t		fo_tputbucket;	/* Throughput bucket, for limiter */
 	uint64_t	fo_tputlast;	/* Throughput count, for delta's */
+	double		fo_tbnext;	/* Per-thread limiter: next event due */
+	double		fo_tbinterval;	/* and ns per event, 0 until first use */
 
+	/*
+	 * Fields used on every execution of a runtime flowop. They start on
+	 * a cache line of their own, and the alignment pads flowop_t to
+	 * whole cache lines, so they share none with the names, locks and
+	 * condition variables above or with the flowops of other threads
+	 * in the neighbouring shm_flowop[] slots.
+	 */
+	struct flowstats	fo_stats	/* Flow statistics */
+	    __attribute__((aligned(FLOWOP_CACHELINE)));
+	fbint_t		fo_constvalue;	/* constant version of fo_value */
+	fbint_t		fo_constwss;	/* constant version of fo_wss */
+	fbint_t		fo_constiosize;	/* constant version of fo_iosize */
+	fbint_t		fo_constiters;	/* constant version of fo_iters */
+	fbint_t		fo_constcompress; /* constant version of fo_compress */
+	fbint_t		fo_constdedupe;	/* constant version of fo_dedupe */
+	fbint_t		fo_constiovcnt;	/* constant version of fo_iovcnt */
+	fbint_t		fo_constalign;	/* constant version of fo_align */
+	int		fo_boolattrs;	/* FLOW_BOOL_* of the boolean attrs */
+	int		fo_varattrs;	/* FLOW_VAR_* attrs sampled per use */
+	fb_randring_t	fo_offring;	/* Pregenerated random file offsets */
+	fb_randring_t	fo_memring;	/* Pregenerated random tf_mem offsets */
+	fb_randring_t	fo_sizering;	/* Pregenerated random iosizes */
 } flowop_t;
 
+/*
+ * One step of the main loop of a worker thread: a runtime flowop together
+ * with what the loop reads of it on every pass, copied out of the shared
+ * flowop_t by flowop_start(). The first step of a mix block runs no
+ * flowop, but picks the step of one of its branches to run instead. The
+ * last step of a repeat block loops back to its first, counting the
+ * runs of the block in the thread's private copy of the step.
+ */
+typedef struct flowop_exec {
+	int		(*fe_func)();	/* fo_func of the flowop */
+	flowop_t	*fe_flowop;	/* The runtime flowop */
+	int		fe_iters;	/* fo_iters, or -1 if it is random */
+	int		fe_next;	/* Step to run after this one */
+	fb_alias_t	*fe_mix;	/* Mix: alias table over the branches */
+	int		*fe_branch;	/* Mix: first step of each branch */
+	int		fe_repeat;	/* Repeat: runs of the block ending here */
+	int		fe_loop;	/* Repeat: first step of that block */
+	int		fe_runs;	/* Repeat: runs of it done so far */
+} flowop_exec_t;
+
 /* Flow Op Attrs */
 #define	FLOW_ATTR_SEQUENTIAL	0x1
 #define	FLOW_ATTR_RANDOM	0x2
@@ -98,6 +173,42 @@ typedef struct flowop {
 #define	FLOW_ATTR_WRITE		0x100
 #define FLOW_ATTR_FADV_RANDOM	0x200
 
+/*
+ * Boolean attributes, resolved into fo_boolattrs by flowop_initflow().
+ * Booleans can't come from random or custom variables, so they are always
+ * constant for a run.
+ */
+#define	FLOW_BOOL_RANDOM	0x1
+#define	FLOW_BOOL_DSYNC		0x2
+#define	FLOW_BOOL_BLOCKING	0x4
+#define	FLOW_BOOL_DIRECTIO	0x8
+#define	FLOW_BOOL_ROTATEFD	0x10
+#define	FLOW_BOOL_NOREADAHEAD	0x20
+#define	FLOW_BOOL_POPULATE	0x40
+#define	FLOW_BOOL_MAPSYNC	0x80
+#define	FLOW_BOOL_SAMEDIR	0x100
+#define	FLOW_BOOL_WITHSTAT	0x200
+
+/*
+ * Integer attributes that flowop_initflow() found to be random or custom
+ * variables, and so can't be read from their fo_const* copies.
+ */
+#define	FLOW_VAR_IOSIZE		0x1
+#define	FLOW_VAR_ITERS		0x2
+#define	FLOW_VAR_VALUE		0x4
+#define	FLOW_VAR_COMPRESS	0x8
+#define	FLOW_VAR_DEDUPE		0x10
+#define	FLOW_VAR_IOVCNT		0x20
+#define	FLOW_VAR_ALIGN		0x40
+
+/*
+ * Returns the value of integer attribute fo_<attr> of a runtime flowop: its
+ * fo_const<attr> copy, or a fresh sample if flag is set in fo_varattrs.
+ */
+#define	FLOWOP_INT(flowop, attr, flag)					\
+	(((flowop)->fo_varattrs & (flag)) ?				\
+	    avd_get_int((flowop)->fo_##attr) : (flowop)->fo_const##attr)
+
 /* Flowop Instance Numbers */
 			    /* Worker flowops have instance numbers > 0 */
 #define	FLOW_DEFINITION 0   /* Prototype definition of flowop from library */
@@ -137,10 +248,16 @@ void flowop_destruct_generic(flowop_t *flowop);
 void flowop_add_from_proto(flowop_proto_t *list, int nops);
 int flowoplib_iosetup(threadflow_t *threadflow, flowop_t *flowop,
     fbint_t *wssp, caddr_t *iobufp, fb_fdesc_t **filedescp, fbint_t iosize);
+fbint_t flowoplib_iosize(flowop_t *flowop);
 void flowoplib_flowinit(void);
+void flowoplib_thread_fini(threadflow_t *threadflow);
 void flowop_delete_all(flowop_t **threadlist);
 void flowop_endop(threadflow_t *threadflow, flowop_t *flowop, int64_t bytes);
 void flowop_beginop(threadflow_t *threadflow, flowop_t *flowop);
+aiolist_t *flowop_aio_get(threadflow_t *threadflow, flowop_t *flowop,
+    int type);
+void flowop_aio_done(threadflow_t *threadflow, aiolist_t *aio,
+    int64_t bytes);
 void flowop_destruct_all_flows(threadflow_t *threadflow);
 flowop_t *flowop_new_composite_define(char *name);
 void flowop_printall(void);
@@ -150,5 +267,14 @@ void flowop_init(int ismaster);
 /* Local file system specific */
 void fb_lfs_funcvecinit();
 void fb_lfs_newflowops();
+int fb_lfs_rwflags(int flags);
+int fb_lfs_syncflags(int flags);
+
+/* io_uring specific */
+int fb_uring_funcvecinit(void);
+void fb_uring_newflowops(void);
+void fb_uring_regbuf(caddr_t buf, size_t len);
+int fb_uring_statxv(int dirfd, char **names, int count);
+int fb_uring_reap_async(int wait);
 
 #endif	/* _FB_FLOWOP_H */
@@ -33,6 +33,10 @@
 #include <sys/sem.h>
 #include <sys/errno.h>
 #include <sys/time.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <inttypes.h>
 #include <fcntl.h>
 #include <math.h>
@@ -42,12 +46,20 @@
 #include <semaphore.h>
 #endif /* HAVE_SYSV_SEM */
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/xattr.h>
+#endif /* __linux__ */
+
 #include "filebench.h"
 #include "flowop.h"
 #include "fileset.h"
 #include "fb_random.h"
 #include "utils.h"
 #include "fsplug.h"
+#include "fb_content.h"
+#include "fb_pmem.h"
+#include "fb_hugepage.h"
 
 /*
  * These routines implement the flowops from the f language. Each
@@ -77,6 +89,9 @@ static int flowoplib_fdnum(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_print(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_write(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_read(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_rwv_init(flowop_t *flowop);
+static int flowoplib_readv(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_writev(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_block_init(flowop_t *flowop);
 static int flowoplib_block(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_wakeup(threadflow_t *threadflow, flowop_t *flowop);
@@ -87,12 +102,14 @@ static int flowoplib_sempost_init(flowop_t *flowop);
 static int flowoplib_semblock(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_semblock_init(flowop_t *flowop);
 static void flowoplib_semblock_destruct(flowop_t *flowop);
+static int flowoplib_limit_init(flowop_t *flowop);
 static int flowoplib_eventlimit(threadflow_t *, flowop_t *flowop);
 static int flowoplib_bwlimit(threadflow_t *, flowop_t *flowop);
 static int flowoplib_iopslimit(threadflow_t *, flowop_t *flowop);
 static int flowoplib_opslimit(threadflow_t *, flowop_t *flowop);
 static int flowoplib_openfile(threadflow_t *, flowop_t *flowop);
 static int flowoplib_openfile_common(threadflow_t *, flowop_t *flowop, int fd);
+static void flowoplib_munmap(threadflow_t *threadflow, int fd);
 static int flowoplib_createfile(threadflow_t *, flowop_t *flowop);
 static int flowoplib_closefile(threadflow_t *, flowop_t *flowop);
 static int flowoplib_makedir(threadflow_t *, flowop_t *flowop);
@@ -101,13 +118,37 @@ static int flowoplib_listdir(threadflow_t *, flowop_t *flowop);
 static int flowoplib_fsync(threadflow_t *, flowop_t *flowop);
 static int flowoplib_readwholefile(threadflow_t *, flowop_t *flowop);
 static int flowoplib_writewholefile(threadflow_t *, flowop_t *flowop);
+static int flowoplib_copyfile(threadflow_t *, flowop_t *flowop);
+static int flowoplib_sendfile(threadflow_t *, flowop_t *flowop);
 static int flowoplib_appendfile(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_appendfilerand(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_deletefile(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_statfile(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_renamefile(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_linkfile(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_symlinkfile(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_truncatefile(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_setattr(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_setxattr(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_getxattr(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_finishoncount(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_finishonbytes(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_fsyncset(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_fdatasync(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_syncrange_init(flowop_t *flowop);
+static int flowoplib_syncrange(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_syncfs(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_groupsync_init(flowop_t *flowop);
+static int flowoplib_groupsync(threadflow_t *threadflow, flowop_t *flowop);
+static void flowoplib_groupsync_destruct(flowop_t *flowop);
+static int flowoplib_fadvise(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_readahead(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_mmapread(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_mmapwrite(threadflow_t *threadflow, flowop_t *flowop);
+static int flowoplib_mmapreadwhole(threadflow_t *threadflow,
+    flowop_t *flowop);
+static int flowoplib_pmemstore_init(flowop_t *flowop);
+static int flowoplib_pmemstore(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_testrandvar(threadflow_t *threadflow, flowop_t *flowop);
 static int flowoplib_testrandvar_init(flowop_t *flowop);
 static void flowoplib_testrandvar_destruct(flowop_t *flowop);
@@ -117,6 +158,10 @@ static flowop_proto_t flowoplib_funcs[] = {
 	flowoplib_write, flowop_destruct_generic},
 	{FLOW_TYPE_IO, FLOW_ATTR_READ, "read", flowop_init_generic,
 	flowoplib_read, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_WRITE, "writev", flowoplib_rwv_init,
+	flowoplib_writev, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_READ, "readv", flowoplib_rwv_init,
+	flowoplib_readv, flowop_destruct_generic},
 	{FLOW_TYPE_SYNC, 0, "block", flowoplib_block_init,
 	flowoplib_block, flowop_destruct_generic},
 	{FLOW_TYPE_SYNC, 0, "wakeup", flowop_init_generic,
@@ -129,13 +174,13 @@ static flowop_proto_t flowoplib_funcs[] = {
 	flowoplib_hog, flowop_destruct_generic},
 	{FLOW_TYPE_OTHER, 0, "delay", flowop_init_generic,
 	flowoplib_delay, flowop_destruct_generic},
-	{FLOW_TYPE_OTHER, 0, "eventlimit", flowop_init_generic,
+	{FLOW_TYPE_OTHER, 0, "eventlimit", flowoplib_limit_init,
 	flowoplib_eventlimit, flowop_destruct_generic},
-	{FLOW_TYPE_OTHER, 0, "bwlimit", flowop_init_generic,
+	{FLOW_TYPE_OTHER, 0, "bwlimit", flowoplib_limit_init,
 	flowoplib_bwlimit, flowop_destruct_generic},
-	{FLOW_TYPE_OTHER, 0, "iopslimit", flowop_init_generic,
+	{FLOW_TYPE_OTHER, 0, "iopslimit", flowoplib_limit_init,
 	flowoplib_iopslimit, flowop_destruct_generic},
-	{FLOW_TYPE_OTHER, 0, "opslimit", flowop_init_generic,
+	{FLOW_TYPE_OTHER, 0, "opslimit", flowoplib_limit_init,
 	flowoplib_opslimit, flowop_destruct_generic},
 	{FLOW_TYPE_OTHER, 0, "finishoncount", flowop_init_generic,
 	flowoplib_finishoncount, flowop_destruct_generic},
@@ -157,6 +202,26 @@ static flowop_proto_t flowoplib_funcs[] = {
 	flowoplib_fsync, flowop_destruct_generic},
 	{FLOW_TYPE_IO, 0, "fsyncset", flowop_init_generic,
 	flowoplib_fsyncset, flowop_destruct_generic},
+	{FLOW_TYPE_IO, 0, "fdatasync", flowop_init_generic,
+	flowoplib_fdatasync, flowop_destruct_generic},
+	{FLOW_TYPE_IO, 0, "syncrange", flowoplib_syncrange_init,
+	flowoplib_syncrange, flowop_destruct_generic},
+	{FLOW_TYPE_IO, 0, "syncfs", flowop_init_generic,
+	flowoplib_syncfs, flowop_destruct_generic},
+	{FLOW_TYPE_IO, 0, "groupsync", flowoplib_groupsync_init,
+	flowoplib_groupsync, flowoplib_groupsync_destruct},
+	{FLOW_TYPE_IO, 0, "fadvise", flowop_init_generic,
+	flowoplib_fadvise, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_READ, "readahead", flowop_init_generic,
+	flowoplib_readahead, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_READ, "mmapread", flowop_init_generic,
+	flowoplib_mmapread, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_WRITE, "mmapwrite", flowop_init_generic,
+	flowoplib_mmapwrite, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_READ, "mmapreadwhole", flowop_init_generic,
+	flowoplib_mmapreadwhole, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_WRITE, "pmemstore", flowoplib_pmemstore_init,
+	flowoplib_pmemstore, flowop_destruct_generic},
 	{FLOW_TYPE_IO, 0, "statfile", flowop_init_generic,
 	flowoplib_statfile, flowop_destruct_generic},
 	{FLOW_TYPE_IO, FLOW_ATTR_READ, "readwholefile", flowop_init_generic,
@@ -167,8 +232,26 @@ static flowop_proto_t flowoplib_funcs[] = {
 	flowoplib_appendfilerand, flowop_destruct_generic},
 	{FLOW_TYPE_IO, 0, "deletefile", flowop_init_generic,
 	flowoplib_deletefile, flowop_destruct_generic},
+	{FLOW_TYPE_IO, 0, "renamefile", flowop_init_generic,
+	flowoplib_renamefile, flowop_destruct_generic},
+	{FLOW_TYPE_IO, 0, "linkfile", flowop_init_generic,
+	flowoplib_linkfile, flowop_destruct_generic},
+	{FLOW_TYPE_IO, 0, "symlinkfile", flowop_init_generic,
+	flowoplib_symlinkfile, flowop_destruct_generic},
+	{FLOW_TYPE_IO, 0, "truncatefile", flowop_init_generic,
+	flowoplib_truncatefile, flowop_destruct_generic},
+	{FLOW_TYPE_IO, 0, "setattr", flowop_init_generic,
+	flowoplib_setattr, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_WRITE, "setxattr", flowop_init_generic,
+	flowoplib_setxattr, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_READ, "getxattr", flowop_init_generic,
+	flowoplib_getxattr, flowop_destruct_generic},
 	{FLOW_TYPE_IO, FLOW_ATTR_WRITE, "writewholefile", flowop_init_generic,
 	flowoplib_writewholefile, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_WRITE, "copyfile", flowop_init_generic,
+	flowoplib_copyfile, flowop_destruct_generic},
+	{FLOW_TYPE_IO, FLOW_ATTR_READ, "sendfile", flowop_init_generic,
+	flowoplib_sendfile, flowop_destruct_generic},
 	{FLOW_TYPE_OTHER, 0, "print", flowop_init_generic,
 	flowoplib_print, flowop_destruct_generic},
 	/* routine to calculate mean and stddev for output from a randvar */
@@ -192,6 +275,33 @@ flowoplib_flowinit(void)
 	flowop_add_from_proto(flowoplib_funcs, nops);
 }
 
+/*
+ * Releases the per thread state that the flowops in this module set up
+ * for themselves on first use. Called by the thread on its way out.
+ */
+void
+flowoplib_thread_fini(threadflow_t *threadflow)
+{
+	int fd;
+
+	for (fd = 0; fd <= THREADFLOW_MAXFD; fd++)
+		flowoplib_munmap(threadflow, fd);
+
+	if (threadflow->tf_nullfd > 0) {
+		(void) close(threadflow->tf_sinkfd[0]);
+		(void) close(threadflow->tf_sinkfd[1]);
+		(void) close(threadflow->tf_nullfd);
+		threadflow->tf_nullfd = 0;
+	}
+
+	free(threadflow->tf_dirbuf);
+	free(threadflow->tf_dirnames);
+	threadflow->tf_dirbuf = NULL;
+	threadflow->tf_dirbuflen = 0;
+	threadflow->tf_dirnames = NULL;
+	threadflow->tf_dirnamemax = 0;
+}
+
 /*
  * Special total noop destruct
  */
@@ -211,13 +321,13 @@ flowoplib_fileattrs(flowop_t *flowop)
 {
 	int attrs = 0;
 
-	if (avd_get_bool(flowop->fo_directio))
+	if (flowop->fo_boolattrs & FLOW_BOOL_DIRECTIO)
 		attrs |= FLOW_ATTR_DIRECTIO;
 
-	if (avd_get_bool(flowop->fo_dsync))
+	if (flowop->fo_boolattrs & FLOW_BOOL_DSYNC)
 		attrs |= FLOW_ATTR_DSYNC;
 	
-	if (avd_get_bool(flowop->fo_noreadahead))
+	if (flowop->fo_boolattrs & FLOW_BOOL_NOREADAHEAD)
 		attrs |= FLOW_ATTR_FADV_RANDOM;
 
 	return (attrs);
@@ -322,7 +432,7 @@ flowoplib_fdnum(threadflow_t *threadflow, flowop_t *flowop)
 		goto retfd;
 	}
 
-	if (!avd_get_bool(flowop->fo_rotatefd)) {
+	if (!(flowop->fo_boolattrs & FLOW_BOOL_ROTATEFD)) {
 		filebench_log(LOG_DEBUG_IMPL, "picking default fd");
 		goto retfd;
 	}
@@ -409,9 +519,89 @@ flowoplib_filesetup(threadflow_t *threadflow, flowop_t *flowop,
 	return (FILEBENCH_OK);
 }
 
+/*
+ * Returns the memory alignment direct I/O needs for the file open at
+ * fdesc, as reported by statx(STATX_DIOALIGN). Where the kernel or
+ * file system does not report it, returns the page size, which is
+ * enough for devices with sectors of up to a page.
+ */
+static int
+flowoplib_dioalign(fb_fdesc_t *fdesc)
+{
+#ifdef STATX_DIOALIGN
+	struct statx stx;
+
+	if ((statx(fdesc->fd_num, "", AT_EMPTY_PATH, STATX_DIOALIGN,
+	    &stx) == 0) && (stx.stx_mask & STATX_DIOALIGN) &&
+	    (stx.stx_dio_mem_align != 0))
+		return ((int)stx.stx_dio_mem_align);
+#endif /* STATX_DIOALIGN */
+
+	return (getpagesize());
+}
+
+/*
+ * Returns the alignment of the flowop's I/O buffers: the flowop's align
+ * attribute if it has one, the direct I/O alignment of the files it
+ * accesses if it does direct I/O, and 0 (no alignment) otherwise.
+ */
+static size_t
+flowoplib_bufalign(flowop_t *flowop)
+{
+	if (flowop->fo_align)
+		return ((size_t)FLOWOP_INT(flowop, align, FLOW_VAR_ALIGN));
+
+	if (!(flowoplib_fileattrs(flowop) & FLOW_ATTR_DIRECTIO))
+		return (0);
+
+	if (flowop->fo_dioalign == 0)
+		return ((size_t)getpagesize());
+
+	return ((size_t)flowop->fo_dioalign);
+}
+
+/*
+ * Returns a buffer of at least size bytes from the thread's buffer
+ * pool, which is shared by all of the thread's flowops that don't keep
+ * generated content in a buffer of their own, or NULL if it can't be
+ * allocated. The pool is page aligned, and grows in powers of two, so
+ * that it is reallocated only a few times as larger I/Os are seen.
+ * Once it reaches a huge page it follows the thread's hugepages mode.
+ */
+static caddr_t
+flowoplib_poolbuf(threadflow_t *threadflow, size_t size, size_t align)
+{
+	size_t poolsize;
+	void *buf;
+
+	if ((threadflow->tf_iobuf != NULL) &&
+	    (threadflow->tf_iobufsize >= size) &&
+	    (((uintptr_t)threadflow->tf_iobuf & (align - 1)) == 0))
+		return (threadflow->tf_iobuf);
+
+	for (poolsize = MAX(threadflow->tf_iobufsize, 65536);
+	    poolsize < size; poolsize *= 2)
+		;
+
+	if (fb_hugepage_memalign(&buf, MAX(align, (size_t)getpagesize()),
+	    poolsize, threadflow->tf_hugepages) != 0)
+		return (NULL);
+
+	free(threadflow->tf_iobuf);
+	threadflow->tf_iobuf = buf;
+	threadflow->tf_iobufsize = poolsize;
+
+	return (threadflow->tf_iobuf);
+}
+
 /*
  * Determines the io buffer or random offset into tf_mem for
- * the IO operation. Returns FILEBENCH_ERROR on errors, FILEBENCH_OK otherwise.
+ * the IO operation. Flowops with a compress_ratio or dedupe_ratio always
+ * use their private buffer, which is filled with generated content when
+ * it is allocated and restamped for each operation. Other flowops use
+ * the thread's buffer pool when there is no tf_mem. Buffers are aligned
+ * as flowoplib_bufalign() says, which direct I/O requires.
+ * Returns FILEBENCH_ERROR on errors, FILEBENCH_OK otherwise.
  */
 static int
 flowoplib_iobufsetup(threadflow_t *threadflow, flowop_t *flowop,
@@ -419,6 +609,11 @@ flowoplib_iobufsetup(threadflow_t *threadflow, flowop_t *flowop,
 {
 	long memsize;
 	size_t memoffset;
+	size_t align;
+	size_t bufsize;
+	void *buf;
+	int compress = 0;
+	int dedupe = 1;
 
 	if (iosize == 0) {
 		filebench_log(LOG_ERROR, "zero iosize for thread %s",
@@ -426,11 +621,29 @@ flowoplib_iobufsetup(threadflow_t *threadflow, flowop_t *flowop,
 		return (FILEBENCH_ERROR);
 	}
 
-	/* If directio, we need to align buffer address by sector */
-	if (flowoplib_fileattrs(flowop) & FLOW_ATTR_DIRECTIO)
-		iosize = iosize + 512;
+	align = flowoplib_bufalign(flowop);
+	if (align & (align - 1)) {
+		filebench_log(LOG_ERROR, "flowop %s: align %llu is not a "
+		    "power of two", flowop->fo_name, (u_longlong_t)align);
+		return (FILEBENCH_ERROR);
+	}
+
+	if (flowop->fo_compress || flowop->fo_dedupe) {
+		compress = flowop->fo_compress ?
+		    (int)FLOWOP_INT(flowop, compress, FLOW_VAR_COMPRESS) : 1;
+		if (flowop->fo_dedupe)
+			dedupe = (int)FLOWOP_INT(flowop, dedupe,
+			    FLOW_VAR_DEDUPE);
+
+		if (fb_content_check(compress, dedupe) < 0) {
+			filebench_log(LOG_ERROR, "flowop %s: compress_ratio "
+			    "and dedupe_ratio must be between 1 and %d",
+			    flowop->fo_name, FB_CONTENT_MAXRATIO);
+			return (FILEBENCH_ERROR);
+		}
+	}
 
-	if ((memsize = threadflow->tf_constmemsize) != 0) {
+	if (((memsize = threadflow->tf_constmemsize) != 0) && !compress) {
 		/* use tf_mem for I/O with random offset */
 
 		if (memsize < iosize) {
@@ -440,14 +653,38 @@ flowoplib_iobufsetup(threadflow_t *threadflow, flowop_t *flowop,
 			return (FILEBENCH_ERROR);
 		}
 
-		fb_random(&memoffset, memsize, iosize, NULL);
+		/* aligned offsets will do if tf_mem is aligned as well */
+		if ((uintptr_t)threadflow->tf_mem & (MAX(align, 1) - 1)) {
+			filebench_log(LOG_ERROR, "flowop %s: align %llu is "
+			    "larger than the alignment of the thread memory",
+			    flowop->fo_name, (u_longlong_t)align);
+			return (FILEBENCH_ERROR);
+		}
+
+		if (align > 1)
+			memoffset = fb_random_ring(&flowop->fo_memring,
+			    memsize - iosize + align, align);
+		else
+			memoffset = fb_random_ring(&flowop->fo_memring,
+			    memsize, iosize);
 		*iobufp = threadflow->tf_mem + memoffset;
 
+	} else if (!compress) {
+		/* use the thread's buffer pool */
+		if ((*iobufp = flowoplib_poolbuf(threadflow, iosize,
+		    MAX(align, 1))) == NULL) {
+			filebench_log(LOG_ERROR, "flowop %s: failed to "
+			    "allocate %llu byte buffer", flowop->fo_name,
+			    (u_longlong_t)iosize);
+			return (FILEBENCH_ERROR);
+		}
+
 	} else {
 		/* use private I/O buffer */
 		if ((flowop->fo_buf != NULL) &&
-		    (flowop->fo_buf_size < iosize)) {
-			/* too small, so free up and re-allocate */
+		    ((flowop->fo_buf_size < iosize) ||
+		    (align && ((uintptr_t)flowop->fo_buf & (align - 1))))) {
+			/* too small or misaligned, so free and re-allocate */
 			free(flowop->fo_buf);
 			flowop->fo_buf = NULL;
 		}
@@ -457,17 +694,32 @@ flowoplib_iobufsetup(threadflow_t *threadflow, flowop_t *flowop,
 		 * by flowop_destruct_generic() or by this routine if more
 		 * memory is needed for the buffer.
 		 */
-		if ((flowop->fo_buf == NULL) && ((flowop->fo_buf
-		    = (char *)malloc(iosize)) == NULL))
-			return (FILEBENCH_ERROR);
+		if (flowop->fo_buf == NULL) {
+			bufsize = iosize;
+			if (align > 1)
+				bufsize = (bufsize + align - 1) & ~(align - 1);
+			if (fb_hugepage_memalign(&buf,
+			    MAX(align, sizeof (void *)), bufsize,
+			    threadflow->tf_hugepages) != 0)
+				return (FILEBENCH_ERROR);
+			flowop->fo_buf = buf;
+			flowop->fo_buf_size = bufsize;
+
+			flowop->fo_content_stamp = fb_content_seed();
+			if (fb_content_fill(flowop->fo_buf, bufsize,
+			    compress, dedupe, &flowop->fo_content_stamp) < 0) {
+				free(flowop->fo_buf);
+				flowop->fo_buf = NULL;
+				return (FILEBENCH_ERROR);
+			}
+		} else {
+			fb_content_stamp(flowop->fo_buf, iosize, dedupe,
+			    &flowop->fo_content_stamp);
+		}
 
-		flowop->fo_buf_size = iosize;
 		*iobufp = flowop->fo_buf;
 	}
 
-	if (flowoplib_fileattrs(flowop) & FLOW_ATTR_DIRECTIO)
-		*iobufp = (caddr_t)((((unsigned long)(*iobufp) + 512) / 512) * 512);
-
 	return (FILEBENCH_OK);
 }
 
@@ -486,6 +738,11 @@ flowoplib_iosetup(threadflow_t *threadflow, flowop_t *flowop,
 	    FILEBENCH_OK)
 		return (ret);
 
+	/* learn the direct I/O alignment from the first file accessed */
+	if ((flowop->fo_dioalign == 0) && (flowop->fo_align == NULL) &&
+	    (flowoplib_fileattrs(flowop) & FLOW_ATTR_DIRECTIO))
+		flowop->fo_dioalign = flowoplib_dioalign(*filedescp);
+
 	if ((ret = flowoplib_iobufsetup(threadflow, flowop, iobufp, iosize)) !=
 	    FILEBENCH_OK)
 		return (ret);
@@ -493,6 +750,20 @@ flowoplib_iosetup(threadflow_t *threadflow, flowop_t *flowop,
 	return (FILEBENCH_OK);
 }
 
+/*
+ * Returns the flowop's iosize for one operation. Constant iosizes were
+ * resolved by flowop_initflow(); random ones come from fo_sizering,
+ * which is refilled from the random variable in bulk.
+ */
+fbint_t
+flowoplib_iosize(flowop_t *flowop)
+{
+	if (!(flowop->fo_varattrs & FLOW_VAR_IOSIZE))
+		return (flowop->fo_constiosize);
+
+	return (fb_random_avdring(&flowop->fo_sizering, flowop->fo_iosize));
+}
+
 /*
  * Emulate posix read / pread. If the flowop has a fileset,
  * a file descriptor number index is fetched, otherwise a
@@ -518,13 +789,13 @@ flowoplib_read(threadflow_t *threadflow, flowop_t *flowop)
 	fb_fdesc_t *fdesc;
 	int ret;
 
-	iosize = avd_get_int(flowop->fo_iosize);
+	iosize = flowoplib_iosize(flowop);
 
 	if ((ret = flowoplib_iosetup(threadflow, flowop, &wss, &iobuf,
 	    &fdesc, iosize)) != FILEBENCH_OK)
 		return (ret);
 
-	if (avd_get_bool(flowop->fo_random)) {
+	if (flowop->fo_boolattrs & FLOW_BOOL_RANDOM) {
 		uint64_t fileoffset;
 
 		if (iosize > wss) {
@@ -535,7 +806,7 @@ flowoplib_read(threadflow_t *threadflow, flowop_t *flowop)
 		}
 
 		/* select randomly */
-		fb_random64(&fileoffset, wss, iosize, NULL);
+		fileoffset = fb_random_ring(&flowop->fo_offring, wss, iosize);
 
 		(void) flowop_beginop(threadflow, flowop);
 		if ((ret = FB_PREAD(fdesc, iobuf,
@@ -687,7 +958,7 @@ flowoplib_wakeup(threadflow_t *threadflow, flowop_t *flowop)
 static int
 flowoplib_hog(threadflow_t *threadflow, flowop_t *flowop)
 {
-	uint64_t value = avd_get_int(flowop->fo_value);
+	uint64_t value = FLOWOP_INT(flowop, value, FLOW_VAR_VALUE);
 	int i;
 
 	filebench_log(LOG_DEBUG_IMPL, "hog enter");
@@ -708,7 +979,7 @@ flowoplib_hog(threadflow_t *threadflow, flowop_t *flowop)
 static int
 flowoplib_delay(threadflow_t *threadflow, flowop_t *flowop)
 {
-	int value = avd_get_int(flowop->fo_value);
+	int value = FLOWOP_INT(flowop, value, FLOW_VAR_VALUE);
 
 	flowop_beginop(threadflow, flowop);
 	(void) sleep(value);
@@ -724,8 +995,98 @@ flowoplib_delay(threadflow_t *threadflow, flowop_t *flowop)
  * the events will be divided amoung multiple instances of an event
  * consumer, and further divided among different consumers if more than
  * one has been defined. There is no mechanism to enforce equal sharing
- * of events.
+ * of events, except in per-thread mode, where each consumer gets its
+ * own equal share of the rate.
+ */
+
+/* Most events a per-thread limiter can bank while not claiming any */
+#define	FLOWOPLIB_EVENT_DEPTH	10
+
+/*
+ * Counts the limit flowops of a run, for per-thread mode to divide the
+ * rate among.
+ */
+static int
+flowoplib_limit_init(flowop_t *flowop)
+{
+	(void) __sync_fetch_and_add(&filebench_shm->shm_eventgen_consumers, 1);
+	return (flowop_init_generic(flowop));
+}
+
+/*
+ * Per-thread mode version of claiming events. Rather than taking them
+ * from the queue the generator thread fills, each limit flowop is a
+ * token bucket of its own, refilled from the monotonic clock at an
+ * equal share of the rate: fo_tbnext is when the events claimed so far
+ * will have been earned, and claiming events ahead of the clock sleeps
+ * until then. The share is worked out on first use, by which time all
+ * the limit flowops of the run have been counted.
+ */
+static void
+flowoplib_event_pace(flowop_t *flowop, uint64_t events)
+{
+	struct timespec ts;
+	double now, floor;
+	uint64_t due;
+	fbint_t hz;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (double)ts.tv_sec * SEC2NS_FLOAT + (double)ts.tv_nsec;
+
+	if (flowop->fo_tbinterval == 0.0) {
+		/* no rate, no limit */
+		if ((hz = avd_get_int(filebench_shm->shm_eventgen_hz)) == 0)
+			return;
+		flowop->fo_tbinterval = SEC2NS_FLOAT *
+		    MAX(filebench_shm->shm_eventgen_consumers, 1) / (double)hz;
+		flowop->fo_tbnext = now;
+	}
+
+	/* time spent not claiming only banks a small burst */
+	floor = now - (FLOWOPLIB_EVENT_DEPTH * flowop->fo_tbinterval);
+	if (flowop->fo_tbnext < floor)
+		flowop->fo_tbnext = floor;
+
+	flowop->fo_tbnext += (double)events * flowop->fo_tbinterval;
+	if (flowop->fo_tbnext <= now)
+		return;
+
+	due = (uint64_t)flowop->fo_tbnext;
+	ts.tv_sec = due / 1000000000ULL;
+	ts.tv_nsec = due % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+	    NULL) == EINTR)
+		;
+}
+
+/*
+ * Blocks until the given number of events have been posted, then
+ * claims them. Returns TRUE if they were claimed, FALSE if the event
+ * generator was disabled while waiting.
  */
+static boolean_t
+flowoplib_event_claim(flowop_t *flowop, uint64_t events)
+{
+	if (filebench_shm->shm_eventgen_perthread) {
+		flowoplib_event_pace(flowop, events);
+		return (TRUE);
+	}
+
+	while (filebench_shm->shm_eventgen_enabled) {
+		(void) ipc_mutex_lock(&filebench_shm->shm_eventgen_lock);
+		if (filebench_shm->shm_eventgen_q >= events) {
+			filebench_shm->shm_eventgen_q -= events;
+			(void) ipc_mutex_unlock(
+			    &filebench_shm->shm_eventgen_lock);
+			return (TRUE);
+		}
+		(void) pthread_cond_wait(&filebench_shm->shm_eventgen_cv,
+		    &filebench_shm->shm_eventgen_lock);
+		(void) ipc_mutex_unlock(&filebench_shm->shm_eventgen_lock);
+	}
+
+	return (FALSE);
+}
 
 /*
  * Completes one invocation per posted event. If eventgen_q
@@ -747,18 +1108,7 @@ flowoplib_eventlimit(threadflow_t *threadflow, flowop_t *flowop)
 	}
 
 	flowop_beginop(threadflow, flowop);
-	while (filebench_shm->shm_eventgen_enabled) {
-		(void) ipc_mutex_lock(&filebench_shm->shm_eventgen_lock);
-		if (filebench_shm->shm_eventgen_q > 0) {
-			filebench_shm->shm_eventgen_q--;
-			(void) ipc_mutex_unlock(
-			    &filebench_shm->shm_eventgen_lock);
-			break;
-		}
-		(void) pthread_cond_wait(&filebench_shm->shm_eventgen_cv,
-		    &filebench_shm->shm_eventgen_lock);
-		(void) ipc_mutex_unlock(&filebench_shm->shm_eventgen_lock);
-	}
+	(void) flowoplib_event_claim(flowop, 1);
 	flowop_endop(threadflow, flowop, 0);
 	return (FILEBENCH_OK);
 }
@@ -828,6 +1178,10 @@ flowoplib_iopslimit(threadflow_t *threadflow, flowop_t *flowop)
 		 * and fs_wcount if looking at a single flowop.
 		 */
 		iops = flowop->fo_targets->fo_stats.fs_count;
+	} else if (filebench_shm->shm_eventgen_perthread) {
+		/* only this thread's share of the workload */
+		iops = threadflow->tf_stats.fs_rcount +
+		    threadflow->tf_stats.fs_wcount;
 	} else {
 		(void) ipc_mutex_lock(&controlstats_lock);
 		iops = (controlstats.fs_rcount +
@@ -855,20 +1209,8 @@ flowoplib_iopslimit(threadflow_t *threadflow, flowop_t *flowop)
 	events = iops;
 
 	flowop_beginop(threadflow, flowop);
-	while (filebench_shm->shm_eventgen_enabled) {
-
-		(void) ipc_mutex_lock(&filebench_shm->shm_eventgen_lock);
-		if (filebench_shm->shm_eventgen_q >= events) {
-			filebench_shm->shm_eventgen_q -= events;
-			(void) ipc_mutex_unlock(
-			    &filebench_shm->shm_eventgen_lock);
-			flowop->fo_tputbucket += events;
-			break;
-		}
-		(void) pthread_cond_wait(&filebench_shm->shm_eventgen_cv,
-		    &filebench_shm->shm_eventgen_lock);
-		(void) ipc_mutex_unlock(&filebench_shm->shm_eventgen_lock);
-	}
+	if (flowoplib_event_claim(flowop, events))
+		flowop->fo_tputbucket += events;
 	flowop_endop(threadflow, flowop, 0);
 
 	return (FILEBENCH_OK);
@@ -903,6 +1245,9 @@ flowoplib_opslimit(threadflow_t *threadflow, flowop_t *flowop)
 
 	if (flowop->fo_targets) {
 		ops = flowop->fo_targets->fo_stats.fs_count;
+	} else if (filebench_shm->shm_eventgen_perthread) {
+		/* only this thread's share of the workload */
+		ops = threadflow->tf_ioops;
 	} else {
 		(void) ipc_mutex_lock(&controlstats_lock);
 		ops = controlstats.fs_count;
@@ -929,19 +1274,8 @@ flowoplib_opslimit(threadflow_t *threadflow, flowop_t *flowop)
 	events = ops;
 
 	flowop_beginop(threadflow, flowop);
-	while (filebench_shm->shm_eventgen_enabled) {
-		(void) ipc_mutex_lock(&filebench_shm->shm_eventgen_lock);
-		if (filebench_shm->shm_eventgen_q >= events) {
-			filebench_shm->shm_eventgen_q -= events;
-			(void) ipc_mutex_unlock(
-			    &filebench_shm->shm_eventgen_lock);
-			flowop->fo_tputbucket += events;
-			break;
-		}
-		(void) pthread_cond_wait(&filebench_shm->shm_eventgen_cv,
-		    &filebench_shm->shm_eventgen_lock);
-		(void) ipc_mutex_unlock(&filebench_shm->shm_eventgen_lock);
-	}
+	if (flowoplib_event_claim(flowop, events))
+		flowop->fo_tputbucket += events;
 	flowop_endop(threadflow, flowop, 0);
 
 	return (FILEBENCH_OK);
@@ -992,6 +1326,10 @@ flowoplib_bwlimit(threadflow_t *threadflow, flowop_t *flowop)
 		 * and fs_wbytes if looking at a single flowop.
 		 */
 		bytes = flowop->fo_targets->fo_stats.fs_bytes;
+	} else if (filebench_shm->shm_eventgen_perthread) {
+		/* only this thread's share of the workload */
+		bytes = threadflow->tf_stats.fs_rbytes +
+		    threadflow->tf_stats.fs_wbytes;
 	} else {
 		(void) ipc_mutex_lock(&controlstats_lock);
 		bytes = (controlstats.fs_rbytes +
@@ -1022,19 +1360,8 @@ flowoplib_bwlimit(threadflow_t *threadflow, flowop_t *flowop)
 	    (u_longlong_t)bytes, (u_longlong_t)events);
 
 	flowop_beginop(threadflow, flowop);
-	while (filebench_shm->shm_eventgen_enabled) {
-		(void) ipc_mutex_lock(&filebench_shm->shm_eventgen_lock);
-		if (filebench_shm->shm_eventgen_q >= events) {
-			filebench_shm->shm_eventgen_q -= events;
-			(void) ipc_mutex_unlock(
-			    &filebench_shm->shm_eventgen_lock);
-			flowop->fo_tputbucket += (events * MB);
-			break;
-		}
-		(void) pthread_cond_wait(&filebench_shm->shm_eventgen_cv,
-		    &filebench_shm->shm_eventgen_lock);
-		(void) ipc_mutex_unlock(&filebench_shm->shm_eventgen_lock);
-	}
+	if (flowoplib_event_claim(flowop, events))
+		flowop->fo_tputbucket += (events * MB);
 	flowop_endop(threadflow, flowop, 0);
 
 	return (FILEBENCH_OK);
@@ -1184,7 +1511,7 @@ flowoplib_semblock_init(flowop_t *flowop)
 	sem_init(&flowop->fo_sem, 1, 0);
 #endif	/* HAVE_SYSV_SEM */
 
-	if (!(avd_get_bool(flowop->fo_blocking)))
+	if (!(flowop->fo_boolattrs & FLOW_BOOL_BLOCKING))
 		(void) ipc_mutex_unlock(&flowop->fo_lock);
 
 	return (FILEBENCH_OK);
@@ -1206,6 +1533,85 @@ flowoplib_semblock_destruct(flowop_t *flowop)
 #endif /* HAVE_SYSV_SEM */
 }
 
+/*
+ * Takes value from the flowop's System V low water semaphore, or waits
+ * value times on its posix semaphore, blocking until it can. System V
+ * waits give up after ten minutes. Returns -1 with errno set on failure.
+ */
+static int
+flowoplib_semwait(flowop_t *flowop, int value)
+{
+#ifdef HAVE_SYSV_SEM
+	struct sembuf sbuf;
+#ifdef HAVE_SEMTIMEDOP
+	struct timespec timeout;
+#endif /* HAVE_SEMTIMEDOP */
+
+	sbuf.sem_num = flowop->fo_semid_lw;
+	sbuf.sem_op = value * -1;
+	sbuf.sem_flg = 0;
+#ifdef HAVE_SEMTIMEDOP
+	timeout.tv_sec = 600;
+	timeout.tv_nsec = 0;
+	return (semtimedop(filebench_shm->shm_sys_semid, &sbuf, 1, &timeout));
+#else
+	return (semop(filebench_shm->shm_sys_semid, &sbuf, 1));
+#endif /* HAVE_SEMTIMEDOP */
+#else
+	int i;
+
+	for (i = 0; i < value; i++) {
+		if (sem_wait(&flowop->fo_sem) == -1)
+			return (-1);
+	}
+
+	return (0);
+#endif /* HAVE_SYSV_SEM */
+}
+
+/*
+ * Adds value to the flowop's System V low water semaphore, or posts its
+ * posix semaphore value times. With System V semaphores and blocking
+ * set, value is taken from its high water semaphore in the same
+ * operation, which waits at most ten minutes for that. Returns -1 with
+ * errno set on failure.
+ */
+/* ARGSUSED */
+static int
+flowoplib_semsignal(flowop_t *flowop, int value, int blocking)
+{
+#ifdef HAVE_SYSV_SEM
+	struct sembuf sbuf[2];
+#ifdef HAVE_SEMTIMEDOP
+	struct timespec timeout;
+#endif /* HAVE_SEMTIMEDOP */
+
+	sbuf[0].sem_num = flowop->fo_semid_lw;
+	sbuf[0].sem_op = (short)value;
+	sbuf[0].sem_flg = 0;
+	sbuf[1].sem_num = flowop->fo_semid_hw;
+	sbuf[1].sem_op = value * -1;
+	sbuf[1].sem_flg = 0;
+#ifdef HAVE_SEMTIMEDOP
+	timeout.tv_sec = 600;
+	timeout.tv_nsec = 0;
+	return (semtimedop(filebench_shm->shm_sys_semid, &sbuf[0],
+	    blocking + 1, &timeout));
+#else
+	return (semop(filebench_shm->shm_sys_semid, &sbuf[0], blocking + 1));
+#endif /* HAVE_SEMTIMEDOP */
+#else
+	int i;
+
+	for (i = 0; i < value; i++) {
+		if (sem_post(&flowop->fo_sem) == -1)
+			return (-1);
+	}
+
+	return (0);
+#endif /* HAVE_SYSV_SEM */
+}
+
 /*
  * Attempts to pass a System V or posix semaphore as appropriate,
  * and blocks if necessary. Returns FILEBENCH_ERROR if a set of System V
@@ -1217,8 +1623,8 @@ flowoplib_semblock(threadflow_t *threadflow, flowop_t *flowop)
 {
 
 #ifdef HAVE_SYSV_SEM
-	struct sembuf sbuf[2];
-	int value = avd_get_int(flowop->fo_value);
+	struct sembuf sbuf;
+	int value = FLOWOP_INT(flowop, value, FLOW_VAR_VALUE);
 	int sys_semid;
 	struct timespec timeout;
 
@@ -1230,47 +1636,40 @@ flowoplib_semblock(threadflow_t *threadflow, flowop_t *flowop)
 	    flowop->fo_semid_hw, value);
 
 	/* Post, decrement the increment the hw queue */
-	sbuf[0].sem_num = flowop->fo_semid_hw;
-	sbuf[0].sem_op = (short)value;
-	sbuf[0].sem_flg = 0;
-	sbuf[1].sem_num = flowop->fo_semid_lw;
-	sbuf[1].sem_op = value * -1;
-	sbuf[1].sem_flg = 0;
+	sbuf.sem_num = flowop->fo_semid_hw;
+	sbuf.sem_op = (short)value;
+	sbuf.sem_flg = 0;
 	timeout.tv_sec = 600;
 	timeout.tv_nsec = 0;
 
-	if (avd_get_bool(flowop->fo_blocking))
+	if (flowop->fo_boolattrs & FLOW_BOOL_BLOCKING)
 		(void) ipc_mutex_unlock(&flowop->fo_lock);
 
 	flowop_beginop(threadflow, flowop);
 
 #ifdef HAVE_SEMTIMEDOP
-	(void) semtimedop(sys_semid, &sbuf[0], 1, &timeout);
-	(void) semtimedop(sys_semid, &sbuf[1], 1, &timeout);
+	(void) semtimedop(sys_semid, &sbuf, 1, &timeout);
 #else
-	(void) semop(sys_semid, &sbuf[0], 1);
-	(void) semop(sys_semid, &sbuf[1], 1);
+	(void) semop(sys_semid, &sbuf, 1);
 #endif /* HAVE_SEMTIMEDOP */
+	(void) flowoplib_semwait(flowop, value);
 
-	if (avd_get_bool(flowop->fo_blocking))
+	if (flowop->fo_boolattrs & FLOW_BOOL_BLOCKING)
 		(void) ipc_mutex_lock(&flowop->fo_lock);
 
 	flowop_endop(threadflow, flowop, 0);
 
 #else
-	int value = avd_get_int(flowop->fo_value);
-	int i;
+	int value = FLOWOP_INT(flowop, value, FLOW_VAR_VALUE);
 
 	filebench_log(LOG_DEBUG_IMPL,
 	    "flow %s-%d sem blocking on posix semaphore",
 	    flowop->fo_name, flowop->fo_instance);
 
 	/* Decrement sem by value */
-	for (i = 0; i < value; i++) {
-		if (sem_wait(&flowop->fo_sem) == -1) {
-			filebench_log(LOG_ERROR, "semop wait failed");
-			return (FILEBENCH_ERROR);
-		}
+	if (flowoplib_semwait(flowop, value) == -1) {
+		filebench_log(LOG_ERROR, "semop wait failed");
+		return (FILEBENCH_ERROR);
 	}
 
 	filebench_log(LOG_DEBUG_IMPL, "flow %s-%d sem unblocking",
@@ -1337,51 +1736,26 @@ flowoplib_sempost(threadflow_t *threadflow, flowop_t *flowop)
 	flowop_beginop(threadflow, flowop);
 	/* post to the targets */
 	while (target) {
-#ifdef HAVE_SYSV_SEM
-		struct sembuf sbuf[2];
-		int sys_semid;
+		int value = (int)FLOWOP_INT(flowop, value, FLOW_VAR_VALUE);
 		int blocking;
-#else
-		int i;
-#endif /* HAVE_SYSV_SEM */
-		struct timespec timeout;
-		int value = (int)avd_get_int(flowop->fo_value);
 
 		if (target->fo_instance == FLOW_MASTER) {
 			target = target->fo_targetnext;
 			continue;
 		}
 
-#ifdef HAVE_SYSV_SEM
-
 		filebench_log(LOG_DEBUG_IMPL,
-		    "sempost flow %s-%d num %x",
+		    "sempost flow %s-%d",
 		    target->fo_name,
-		    target->fo_instance,
-		    target->fo_semid_lw);
-
-		sys_semid = filebench_shm->shm_sys_semid;
-		sbuf[0].sem_num = target->fo_semid_lw;
-		sbuf[0].sem_op = (short)value;
-		sbuf[0].sem_flg = 0;
-		sbuf[1].sem_num = target->fo_semid_hw;
-		sbuf[1].sem_op = value * -1;
-		sbuf[1].sem_flg = 0;
-		timeout.tv_sec = 600;
-		timeout.tv_nsec = 0;
-
-		if (avd_get_bool(flowop->fo_blocking))
+		    target->fo_instance);
+
+		if (flowop->fo_boolattrs & FLOW_BOOL_BLOCKING)
 			blocking = 1;
 		else
 			blocking = 0;
 
-#ifdef HAVE_SEMTIMEDOP
-		if ((semtimedop(sys_semid, &sbuf[0], blocking + 1,
-		    &timeout) == -1) && (errno && (errno != EAGAIN))) {
-#else
-		if ((semop(sys_semid, &sbuf[0], blocking + 1) == -1) &&
+		if ((flowoplib_semsignal(target, value, blocking) == -1) &&
 		    (errno && (errno != EAGAIN))) {
-#endif /* HAVE_SEMTIMEDOP */
 			filebench_log(LOG_ERROR, "semop post failed: %s",
 			    strerror(errno));
 			return (FILEBENCH_ERROR);
@@ -1390,23 +1764,6 @@ flowoplib_sempost(threadflow_t *threadflow, flowop_t *flowop)
 		filebench_log(LOG_DEBUG_IMPL,
 		    "flow %s-%d finished posting",
 		    target->fo_name, target->fo_instance);
-#else
-		filebench_log(LOG_DEBUG_IMPL,
-		    "sempost flow %s-%d to posix semaphore",
-		    target->fo_name,
-		    target->fo_instance);
-
-		/* Increment sem by value */
-		for (i = 0; i < value; i++) {
-			if (sem_post(&target->fo_sem) == -1) {
-				filebench_log(LOG_ERROR, "semop post failed");
-				return (FILEBENCH_ERROR);
-			}
-		}
-
-		filebench_log(LOG_DEBUG_IMPL, "flow %s-%d unblocking",
-		    target->fo_name, target->fo_instance);
-#endif /* HAVE_SYSV_SEM */
 
 		target = target->fo_targetnext;
 	}
@@ -1496,7 +1853,7 @@ flowoplib_openfile_common(threadflow_t *threadflow, flowop_t *flowop, int fd)
 	 * If the flowop doesn't default to persistent fd
 	 * then get unique thread ID for use by fileset_pick
 	 */
-	if (avd_get_bool(flowop->fo_rotatefd))
+	if (flowop->fo_boolattrs & FLOW_BOOL_ROTATEFD)
 		tid = threadflow->tf_utid;
 
 	if (threadflow->tf_fd[fd].fd_ptr != NULL) {
@@ -1506,6 +1863,9 @@ flowoplib_openfile_common(threadflow_t *threadflow, flowop_t *flowop, int fd)
 		return (FILEBENCH_ERROR);
 	}
 
+	/* drop any mapping left from the slot's previous file */
+	flowoplib_munmap(threadflow, fd);
+
 	if (flowop->fo_fileset->fs_attrs & FILESET_IS_RAW_DEV) {
 		int open_attrs = 0;
 		char name[MAXPATHLEN];
@@ -1515,7 +1875,7 @@ flowoplib_openfile_common(threadflow_t *threadflow, flowop_t *flowop, int fd)
 		(void) fb_strlcat(name, "/", MAXPATHLEN);
 		(void) fb_strlcat(name, fileset_name, MAXPATHLEN);
 
-		if (avd_get_bool(flowop->fo_dsync))
+		if (flowop->fo_boolattrs & FLOW_BOOL_DSYNC)
 			open_attrs |= O_SYNC;
 
 #ifdef HAVE_O_DIRECT
@@ -1622,6 +1982,9 @@ flowoplib_createfile(threadflow_t *threadflow, flowop_t *flowop)
 		return (FILEBENCH_ERROR);
 	}
 
+	/* drop any mapping left from the slot's previous file */
+	flowoplib_munmap(threadflow, fd);
+
 	if (flowop->fo_fileset == NULL) {
 		filebench_log(LOG_ERROR, "flowop NULL file");
 		return (FILEBENCH_ERROR);
@@ -1863,39 +2226,898 @@ flowoplib_fsyncset(threadflow_t *threadflow, flowop_t *flowop)
 }
 
 /*
- * Emulate close of a file.  Obtains the file descriptor index
- * from the flowop, obtains the actual file descriptor from the
- * threadflow's table, checks to be sure it is still an open
- * file, then does a close operation on it. Then sets the
- * threadflow file descriptor table entry to 0, and the file set
- * entry pointer to NULL. Returns FILEBENCH_ERROR if the file was not open,
- * FILEBENCH_OK otherwise.
+ * Returns the descriptor of the file open on the flowop's fd, for the
+ * sync flowops, or NULL after logging an error if the fd is closed or
+ * refers to a raw device.
  */
-static int
-flowoplib_closefile(threadflow_t *threadflow, flowop_t *flowop)
+static fb_fdesc_t *
+flowoplib_syncfd(threadflow_t *threadflow, flowop_t *flowop)
 {
 	filesetentry_t *file;
-	fileset_t *fileset;
 	int fd;
 
 	fd = flowoplib_fdnum(threadflow, flowop);
 
 	if (threadflow->tf_fd[fd].fd_ptr == NULL) {
 		filebench_log(LOG_ERROR,
-		    "flowop %s attempted to close an already closed fd %d",
+		    "flowop %s attempted to sync a closed fd %d",
 		    flowop->fo_name, fd);
-		return (FILEBENCH_ERROR);
+		return (NULL);
 	}
 
 	file = threadflow->tf_fse[fd];
-	fileset = file->fse_fileset;
 
-	/* Wait for it to be non-busy */
-	(void) ipc_mutex_lock(&fileset->fs_pick_lock);
-	while (file->fse_flags & FSE_BUSY) {
-		file->fse_flags |= FSE_THRD_WAITNG;
-		(void) pthread_cond_wait(&fileset->fs_thrd_wait_cv,
-		    &fileset->fs_pick_lock);
+	if ((file == NULL) ||
+	    (file->fse_fileset->fs_attrs & FILESET_IS_RAW_DEV)) {
+		filebench_log(LOG_ERROR,
+		    "flowop %s attempted to sync a RAW device",
+		    flowop->fo_name);
+		return (NULL);
+	}
+
+	return (&threadflow->tf_fd[fd]);
+}
+
+/*
+ * Emulates fdatasync of the file open on the flowop's fd. Returns
+ * FILEBENCH_ERROR if the file is not open or the fdatasync fails,
+ * FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_fdatasync(threadflow_t *threadflow, flowop_t *flowop)
+{
+	fb_fdesc_t *fdesc;
+	int ret;
+
+	if ((fdesc = flowoplib_syncfd(threadflow, flowop)) == NULL)
+		return (FILEBENCH_ERROR);
+
+	flowop_beginop(threadflow, flowop);
+	ret = FB_FDATASYNC(fdesc);
+	flowop_endop(threadflow, flowop, 0);
+
+	if (ret != 0) {
+		filebench_log(LOG_ERROR, "flowop %s: fdatasync failed: %s",
+		    flowop->fo_name, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Converts the flowop's syncflags attribute, a comma separated list of
+ * waitbefore, write and waitafter, to FB_SFR_* flags. The list must be
+ * quoted, as in syncflags="waitbefore,write,waitafter", since a bare
+ * comma ends the attribute. Without the attribute the flags are write
+ * only, which starts writeback without waiting for it, the way
+ * databases trickle out dirty data.
+ */
+static int
+flowoplib_syncrange_init(flowop_t *flowop)
+{
+	char flags[128];
+	char *flag;
+	char *last;
+
+	flowop->fo_syncflagset = FB_SFR_WRITE;
+
+	if (flowop->fo_syncflags && avd_get_str(flowop->fo_syncflags)) {
+		(void) fb_strlcpy(flags, avd_get_str(flowop->fo_syncflags),
+		    sizeof (flags));
+
+		flowop->fo_syncflagset = 0;
+		for (flag = strtok_r(flags, ", ", &last); flag != NULL;
+		    flag = strtok_r(NULL, ", ", &last)) {
+			if (!strcmp(flag, "waitbefore"))
+				flowop->fo_syncflagset |= FB_SFR_WAIT_BEFORE;
+			else if (!strcmp(flag, "write"))
+				flowop->fo_syncflagset |= FB_SFR_WRITE;
+			else if (!strcmp(flag, "waitafter"))
+				flowop->fo_syncflagset |= FB_SFR_WAIT_AFTER;
+			else {
+				filebench_log(LOG_ERROR, "flowop %s: unknown "
+				    "syncflag %s, expected waitbefore, write "
+				    "or waitafter", flowop->fo_name, flag);
+				return (-1);
+			}
+		}
+	}
+
+	return (flowop_init_generic(flowop));
+}
+
+/*
+ * Emulates sync_file_range of iosize bytes at the flowop's offset, of
+ * the file open on the flowop's fd. An iosize of 0 syncs to the end of
+ * the file. Returns FILEBENCH_ERROR if the file is not open or the
+ * sync fails, FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_syncrange(threadflow_t *threadflow, flowop_t *flowop)
+{
+	fb_fdesc_t *fdesc;
+	off64_t offset = 0;
+	off64_t len;
+	int ret;
+
+	if ((fdesc = flowoplib_syncfd(threadflow, flowop)) == NULL)
+		return (FILEBENCH_ERROR);
+
+	if (flowop->fo_offset)
+		offset = (off64_t)avd_get_int(flowop->fo_offset);
+	len = (off64_t)flowoplib_iosize(flowop);
+
+	flowop_beginop(threadflow, flowop);
+	ret = FB_SYNCRANGE(fdesc, offset, len, flowop->fo_syncflagset);
+	flowop_endop(threadflow, flowop, 0);
+
+	if (ret != 0) {
+		filebench_log(LOG_ERROR, "flowop %s: sync_file_range failed: "
+		    "%s", flowop->fo_name, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Emulates syncfs of the file system holding the file open on the
+ * flowop's fd or, without one, the flowop's fileset. Returns
+ * FILEBENCH_ERROR on errors, FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_syncfs(threadflow_t *threadflow, flowop_t *flowop)
+{
+	fb_fdesc_t *fdesc;
+	fb_fdesc_t tmpfd;
+	fileset_t *fileset;
+	char path[MAXPATHLEN];
+	int fd;
+	int ret;
+
+	fd = flowoplib_fdnum(threadflow, flowop);
+
+	if ((fd > 0) && (threadflow->tf_fd[fd].fd_ptr != NULL)) {
+		fdesc = &threadflow->tf_fd[fd];
+	} else if ((fileset = flowop->fo_fileset) != NULL) {
+		(void) fb_strlcpy(path, avd_get_str(fileset->fs_path),
+		    MAXPATHLEN);
+		if (FB_OPEN(&tmpfd, path, O_RDONLY, 0) == FILEBENCH_ERROR) {
+			filebench_log(LOG_ERROR, "flowop %s: failed to open "
+			    "%s: %s", flowop->fo_name, path, strerror(errno));
+			return (FILEBENCH_ERROR);
+		}
+		fdesc = &tmpfd;
+	} else {
+		filebench_log(LOG_ERROR, "flowop %s: syncfs needs an open fd "
+		    "or a fileset", flowop->fo_name);
+		return (FILEBENCH_ERROR);
+	}
+
+	flowop_beginop(threadflow, flowop);
+	ret = FB_SYNCFS(fdesc);
+	flowop_endop(threadflow, flowop, 0);
+
+	if (fdesc == &tmpfd)
+		(void) FB_CLOSE(&tmpfd);
+
+	if (ret != 0) {
+		filebench_log(LOG_ERROR, "flowop %s: syncfs failed: %s",
+		    flowop->fo_name, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Calls ipc_seminit() for the group's semaphore, which is allocated on
+ * first use since the group's master flowop can't be looked up yet.
+ */
+static int
+flowoplib_groupsync_init(flowop_t *flowop)
+{
+#ifdef HAVE_SYSV_SEM
+	ipc_seminit();
+#endif /* HAVE_SYSV_SEM */
+	return (flowop_init_generic(flowop));
+}
+
+/*
+ * Returns the master flowop holding the state shared by all instances
+ * of a groupsync flowop, setting up its semaphore when the first
+ * instance joins, or NULL if it can't be found.
+ */
+static flowop_t *
+flowoplib_syncgroup(threadflow_t *threadflow, flowop_t *flowop)
+{
+	flowop_t *group;
+
+	if ((group = flowop->fo_targets) != NULL)
+		return (group);
+
+	if ((group = flowop_find_one(flowop->fo_name, FLOW_MASTER)) == NULL) {
+		filebench_log(LOG_ERROR,
+		    "groupsync: could not find group %s for thread %s",
+		    flowop->fo_name, threadflow->tf_name);
+		return (NULL);
+	}
+
+	(void) ipc_mutex_lock(&group->fo_lock);
+	if (group->fo_grp_refs++ == 0) {
+#ifdef HAVE_SYSV_SEM
+		group->fo_semid_lw = ipc_semidalloc();
+#else
+		(void) sem_init(&group->fo_sem, 1, 0);
+#endif /* HAVE_SYSV_SEM */
+		group->fo_grp_active = 0;
+		group->fo_grp_waiters = 0;
+		group->fo_grp_error = 0;
+		group->fo_grp_started = 0;
+		group->fo_grp_done = 0;
+	}
+	(void) ipc_mutex_unlock(&group->fo_lock);
+
+	flowop->fo_targets = group;
+
+	return (group);
+}
+
+/*
+ * Leaves the group the instance joined, if any, releasing the group's
+ * semaphore when the last instance leaves.
+ */
+static void
+flowoplib_groupsync_destruct(flowop_t *flowop)
+{
+	flowop_t *group;
+
+	if ((group = flowop->fo_targets) == NULL)
+		return;
+
+	flowop->fo_targets = NULL;
+
+	(void) ipc_mutex_lock(&group->fo_lock);
+	if (--group->fo_grp_refs == 0) {
+#ifdef HAVE_SYSV_SEM
+		ipc_semidfree(group->fo_semid_lw);
+#else
+		(void) sem_destroy(&group->fo_sem);
+#endif /* HAVE_SYSV_SEM */
+	}
+	(void) ipc_mutex_unlock(&group->fo_lock);
+}
+
+/*
+ * Wakes up all threads blocked on the group's semaphore. Called with
+ * the group's fo_lock held.
+ */
+static void
+flowoplib_groupwake(flowop_t *group)
+{
+	if (group->fo_grp_waiters == 0)
+		return;
+
+	if (flowoplib_semsignal(group, group->fo_grp_waiters, 0) == -1)
+		filebench_log(LOG_ERROR, "groupsync post failed: %s",
+		    strerror(errno));
+
+	group->fo_grp_waiters = 0;
+}
+
+/*
+ * Emulates the group commit of a database log, where the threads that
+ * need their writes to be durable at about the same time share one
+ * fsync. The first thread to arrive becomes the leader and syncs the
+ * file open on its fd. Threads arriving while it does so wait on the
+ * group's semaphore for the next sync, which the first of them to run
+ * again performs on behalf of all. The latency of each thread's
+ * operation is the time until a sync that started after it arrived has
+ * completed. The threads are expected to write the same file, like a
+ * shared log, so that the leader's sync covers every thread's writes.
+ * With dsync set the sync is an fdatasync. Returns FILEBENCH_ERROR if
+ * the file is not open or the sync that covered this thread failed.
+ */
+static int
+flowoplib_groupsync(threadflow_t *threadflow, flowop_t *flowop)
+{
+	fb_fdesc_t *fdesc;
+	flowop_t *group;
+	uint64_t need;
+	int ret;
+	int err;
+
+	if ((fdesc = flowoplib_syncfd(threadflow, flowop)) == NULL)
+		return (FILEBENCH_ERROR);
+
+	if ((group = flowoplib_syncgroup(threadflow, flowop)) == NULL)
+		return (FILEBENCH_ERROR);
+
+	flowop_beginop(threadflow, flowop);
+	(void) ipc_mutex_lock(&group->fo_lock);
+
+	/* a sync already in progress may have missed our writes */
+	need = group->fo_grp_started + 1;
+
+	while (group->fo_grp_done < need) {
+		if (!group->fo_grp_active) {
+			group->fo_grp_active = 1;
+			group->fo_grp_started++;
+			(void) ipc_mutex_unlock(&group->fo_lock);
+
+			if (flowop->fo_boolattrs & FLOW_BOOL_DSYNC)
+				ret = FB_FDATASYNC(fdesc);
+			else
+				ret = FB_FSYNC(fdesc);
+			err = (ret != 0) ? errno : 0;
+
+			(void) ipc_mutex_lock(&group->fo_lock);
+			group->fo_grp_error = err;
+			group->fo_grp_done = group->fo_grp_started;
+			group->fo_grp_active = 0;
+			flowoplib_groupwake(group);
+			break;
+		}
+
+		group->fo_grp_waiters++;
+		(void) ipc_mutex_unlock(&group->fo_lock);
+		(void) flowoplib_semwait(group, 1);
+		(void) ipc_mutex_lock(&group->fo_lock);
+	}
+
+	/* the outcome of the latest sync, which covered our writes */
+	err = group->fo_grp_error;
+	(void) ipc_mutex_unlock(&group->fo_lock);
+	flowop_endop(threadflow, flowop, 0);
+
+	if (err != 0) {
+		filebench_log(LOG_ERROR, "flowop %s: group sync failed: %s",
+		    flowop->fo_name, strerror(err));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Converts the flowop's advice attribute to one of the FB_CACHE_*
+ * operations. Returns -1 if the advice is missing or not recognized.
+ */
+static int
+flowoplib_advice(flowop_t *flowop)
+{
+	char *advice;
+
+	if (!flowop->fo_advice ||
+	    ((advice = avd_get_str(flowop->fo_advice)) == NULL))
+		return (-1);
+
+	if (!strcmp(advice, "normal"))
+		return (FB_CACHE_NORMAL);
+	if (!strcmp(advice, "sequential"))
+		return (FB_CACHE_SEQUENTIAL);
+	if (!strcmp(advice, "random"))
+		return (FB_CACHE_RANDOM);
+	if (!strcmp(advice, "willneed"))
+		return (FB_CACHE_WILLNEED);
+	if (!strcmp(advice, "dontneed"))
+		return (FB_CACHE_DONTNEED);
+
+	return (-1);
+}
+
+/*
+ * Gives page cache advice for a whole file. The file is chosen, and
+ * opened if necessary, as for a read. The advice comes from the
+ * "advice" attribute, one of normal, sequential, random, willneed or
+ * dontneed, the latter writing back and dropping the file's cached
+ * pages. Returns FILEBENCH_ERROR on errors, FILEBENCH_NORSC if no
+ * file could be obtained, FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_fadvise(threadflow_t *threadflow, flowop_t *flowop)
+{
+	fb_fdesc_t *fdesc;
+	fbint_t wss;
+	int advice;
+	int ret;
+
+	if ((advice = flowoplib_advice(flowop)) < 0) {
+		filebench_log(LOG_ERROR, "flowop %s: advice must be one of "
+		    "normal, sequential, random, willneed or dontneed",
+		    flowop->fo_name);
+		return (FILEBENCH_ERROR);
+	}
+
+	if ((ret = flowoplib_filesetup(threadflow, flowop, &wss, &fdesc)) !=
+	    FILEBENCH_OK)
+		return (ret);
+
+	/* Measure time to advise */
+	flowop_beginop(threadflow, flowop);
+	ret = FB_CACHECTL(fdesc, advice, 0, 0);
+	flowop_endop(threadflow, flowop, 0);
+
+	if (ret < 0) {
+		filebench_log(LOG_ERROR, "flowop %s: fadvise failed: %s",
+		    flowop->fo_name, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Reads the first iosize bytes of a file into the page cache without
+ * copying them out, or the whole working set if iosize is zero. The
+ * file is chosen, and opened if necessary, as for a read. Returns
+ * FILEBENCH_ERROR on errors, FILEBENCH_NORSC if no file could be
+ * obtained, FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_readahead(threadflow_t *threadflow, flowop_t *flowop)
+{
+	fb_fdesc_t *fdesc;
+	fbint_t iosize;
+	fbint_t wss;
+	int ret;
+
+	if ((ret = flowoplib_filesetup(threadflow, flowop, &wss, &fdesc)) !=
+	    FILEBENCH_OK)
+		return (ret);
+
+	if ((iosize = flowoplib_iosize(flowop)) == 0)
+		iosize = wss;
+
+	/* Measure time to read ahead */
+	flowop_beginop(threadflow, flowop);
+	ret = FB_CACHECTL(fdesc, FB_CACHE_READAHEAD, 0, iosize);
+	flowop_endop(threadflow, flowop, ret < 0 ? 0 : iosize);
+
+	if (ret < 0) {
+		filebench_log(LOG_ERROR, "flowop %s: readahead failed: %s",
+		    flowop->fo_name, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Memory mapped I/O section. The mmap flowops map the whole file open
+ * on their fd the first time they use it, and keep the mapping in the
+ * threadflow's tf_map[] entry for that fd until the file is closed, so
+ * that only page faults and copies are measured. A mapping is made
+ * with MAP_POPULATE if the "populate" attribute is set, and with
+ * MAP_SYNC if "mapsync" is set, which on a DAX file system makes
+ * stores durable once flushed from the CPU caches. The "advice"
+ * attribute is passed to madvise() on the new mapping. Page faults
+ * taken during each operation are added to the flowop's statistics.
+ */
+
+/*
+ * Translates FB_CACHE_* operations into madvise() advice.
+ */
+static int flowoplib_madvice[] = {
+	MADV_NORMAL,		/* FB_CACHE_NORMAL */
+	MADV_SEQUENTIAL,	/* FB_CACHE_SEQUENTIAL */
+	MADV_RANDOM,		/* FB_CACHE_RANDOM */
+	MADV_WILLNEED,		/* FB_CACHE_WILLNEED */
+	MADV_DONTNEED		/* FB_CACHE_DONTNEED */
+};
+
+/*
+ * Reads the calling thread's minor and major page fault counts, which
+ * read as zero where per-thread resource usage is not available.
+ */
+static void
+flowoplib_faults(uint64_t *minfltp, uint64_t *majfltp)
+{
+#ifdef RUSAGE_THREAD
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+		*minfltp = ru.ru_minflt;
+		*majfltp = ru.ru_majflt;
+		return;
+	}
+#endif /* RUSAGE_THREAD */
+	*minfltp = 0;
+	*majfltp = 0;
+}
+
+/*
+ * Removes the mapping, if any, of the file open on fd.
+ */
+static void
+flowoplib_munmap(threadflow_t *threadflow, int fd)
+{
+	tf_mmap_t *map = &threadflow->tf_map[fd];
+
+	if (map->tm_addr == NULL)
+		return;
+
+	(void) munmap(map->tm_addr, map->tm_len);
+	map->tm_addr = NULL;
+	map->tm_offset = 0;
+}
+
+/*
+ * Determines the file descriptor to use, opens the file if necessary
+ * and maps it if it is not already mapped with the needed protection.
+ * The mapping covers the working set size, or the file's size if that
+ * is smaller, and *wssp is set to its length. Returns FILEBENCH_ERROR
+ * on errors, FILEBENCH_NORSC if no file could be obtained, and
+ * FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_mmapsetup(threadflow_t *threadflow, flowop_t *flowop, int write,
+    tf_mmap_t **mapp, fbint_t *wssp)
+{
+	fb_fdesc_t *fdesc;
+	struct stat64 sb;
+	tf_mmap_t *map;
+	caddr_t addr;
+	fbint_t wss;
+	int flags = MAP_SHARED;
+	int prot = PROT_READ;
+	int advice;
+	int ret;
+
+	if ((ret = flowoplib_filesetup(threadflow, flowop, &wss, &fdesc)) !=
+	    FILEBENCH_OK)
+		return (ret);
+
+	map = &threadflow->tf_map[fdesc - threadflow->tf_fd];
+
+	if (write)
+		prot |= PROT_WRITE;
+
+	/* a read only mapping can't be written through */
+	if ((map->tm_addr != NULL) && ((map->tm_prot & prot) != prot))
+		flowoplib_munmap(threadflow, fdesc - threadflow->tf_fd);
+
+	if (map->tm_addr == NULL) {
+		if ((FB_FSTAT(fdesc, &sb) == 0) && S_ISREG(sb.st_mode) &&
+		    (sb.st_size < wss))
+			wss = sb.st_size;
+
+		if (wss == 0) {
+			filebench_log(LOG_ERROR,
+			    "flowop %s: cannot map an empty file",
+			    flowop->fo_name);
+			return (FILEBENCH_ERROR);
+		}
+
+#ifdef MAP_POPULATE
+		if (flowop->fo_boolattrs & FLOW_BOOL_POPULATE)
+			flags |= MAP_POPULATE;
+#endif /* MAP_POPULATE */
+
+		if (flowop->fo_boolattrs & FLOW_BOOL_MAPSYNC) {
+#ifdef MAP_SYNC
+			flags = (flags & ~MAP_SHARED) |
+			    MAP_SHARED_VALIDATE | MAP_SYNC;
+#else
+			filebench_log(LOG_ERROR, "flowop %s: mapsync is "
+			    "not supported on this platform",
+			    flowop->fo_name);
+			return (FILEBENCH_ERROR);
+#endif /* MAP_SYNC */
+		}
+
+		if ((addr = mmap(NULL, (size_t)wss, prot, flags,
+		    fdesc->fd_num, 0)) == MAP_FAILED) {
+			filebench_log(LOG_ERROR, "flowop %s: mmap of %llu "
+			    "bytes failed: %s", flowop->fo_name,
+			    (u_longlong_t)wss, strerror(errno));
+			return (FILEBENCH_ERROR);
+		}
+
+		if (((advice = flowoplib_advice(flowop)) >= 0) &&
+		    (advice < sizeof (flowoplib_madvice) / sizeof (int)) &&
+		    (madvise(addr, (size_t)wss,
+		    flowoplib_madvice[advice]) != 0)) {
+			filebench_log(LOG_ERROR, "flowop %s: madvise "
+			    "failed: %s", flowop->fo_name, strerror(errno));
+		}
+
+		map->tm_addr = addr;
+		map->tm_len = (size_t)wss;
+		map->tm_prot = prot;
+		map->tm_offset = 0;
+	}
+
+	*mapp = map;
+	*wssp = MIN(wss, map->tm_len);
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Picks the offset of the next iosize bytes to access in a mapping:
+ * a random offset within the working set, or the next sequential
+ * offset, wrapping around at its end. Returns FILEBENCH_ERROR if the
+ * working set is smaller than iosize, FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_mmapoffset(flowop_t *flowop, tf_mmap_t *map, fbint_t wss,
+    fbint_t iosize, uint64_t *offsetp)
+{
+	if (iosize > wss) {
+		filebench_log(LOG_ERROR,
+		    "file size smaller than IO size for thread %s",
+		    flowop->fo_name);
+		return (FILEBENCH_ERROR);
+	}
+
+	if (flowop->fo_boolattrs & FLOW_BOOL_RANDOM) {
+		*offsetp = fb_random_ring(&flowop->fo_offring, wss, iosize);
+	} else {
+		if (map->tm_offset + iosize > wss)
+			map->tm_offset = 0;
+		*offsetp = map->tm_offset;
+		map->tm_offset += iosize;
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Copies iosize bytes out of, or into, the mapping of the flowop's
+ * file, at an offset picked by flowoplib_mmapoffset(). Writes to a
+ * mapping are flushed with msync() if dsync is set. Returns
+ * FILEBENCH_ERROR on errors, FILEBENCH_NORSC if no file could be
+ * obtained, and FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_mmapio(threadflow_t *threadflow, flowop_t *flowop, int write)
+{
+	uint64_t minflt, majflt;
+	uint64_t fileoffset;
+	tf_mmap_t *map;
+	caddr_t iobuf;
+	fbint_t iosize;
+	fbint_t wss;
+	int ret;
+
+	iosize = flowoplib_iosize(flowop);
+
+	if ((ret = flowoplib_mmapsetup(threadflow, flowop, write,
+	    &map, &wss)) != FILEBENCH_OK)
+		return (ret);
+
+	if ((ret = flowoplib_iobufsetup(threadflow, flowop, &iobuf,
+	    iosize)) != FILEBENCH_OK)
+		return (ret);
+
+	if (flowoplib_mmapoffset(flowop, map, wss, iosize, &fileoffset) !=
+	    FILEBENCH_OK)
+		return (FILEBENCH_ERROR);
+
+	flowoplib_faults(&minflt, &majflt);
+
+	flowop_beginop(threadflow, flowop);
+	if (write) {
+		(void) memcpy(map->tm_addr + fileoffset, iobuf, iosize);
+		if (flowop->fo_boolattrs & FLOW_BOOL_DSYNC) {
+			/* msync() wants a page aligned address */
+			size_t pad = fileoffset & (getpagesize() - 1);
+
+			ret = msync(map->tm_addr + fileoffset - pad,
+			    iosize + pad, MS_SYNC);
+		}
+	} else {
+		(void) memcpy(iobuf, map->tm_addr + fileoffset, iosize);
+	}
+	flowop_endop(threadflow, flowop, ret ? 0 : iosize);
+
+	flowop->fo_stats.fs_minflt -= minflt;
+	flowop->fo_stats.fs_majflt -= majflt;
+	flowoplib_faults(&minflt, &majflt);
+	flowop->fo_stats.fs_minflt += minflt;
+	flowop->fo_stats.fs_majflt += majflt;
+
+	if (ret) {
+		filebench_log(LOG_ERROR, "flowop %s: msync failed: %s",
+		    flowop->fo_name, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Emulate a read through a memory mapping of the file.
+ */
+static int
+flowoplib_mmapread(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (flowoplib_mmapio(threadflow, flowop, FALSE));
+}
+
+/*
+ * Emulate a write through a memory mapping of the file.
+ */
+static int
+flowoplib_mmapwrite(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (flowoplib_mmapio(threadflow, flowop, TRUE));
+}
+
+/*
+ * Copies the whole mapped working set of the flowop's file out, in
+ * iosize chunks, as readwholefile does with read(). Returns
+ * FILEBENCH_ERROR on errors, FILEBENCH_NORSC if no file could be
+ * obtained, and FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_mmapreadwhole(threadflow_t *threadflow, flowop_t *flowop)
+{
+	uint64_t minflt, majflt;
+	tf_mmap_t *map;
+	caddr_t iobuf;
+	fbint_t iosize;
+	fbint_t wss;
+	fbint_t off;
+	int ret;
+
+	iosize = flowoplib_iosize(flowop);
+
+	if ((ret = flowoplib_mmapsetup(threadflow, flowop, FALSE,
+	    &map, &wss)) != FILEBENCH_OK)
+		return (ret);
+
+	if ((ret = flowoplib_iobufsetup(threadflow, flowop, &iobuf,
+	    iosize)) != FILEBENCH_OK)
+		return (ret);
+
+	flowoplib_faults(&minflt, &majflt);
+
+	flowop_beginop(threadflow, flowop);
+	for (off = 0; off < wss; off += iosize)
+		(void) memcpy(iobuf, map->tm_addr + off, MIN(iosize, wss - off));
+	flowop_endop(threadflow, flowop, wss);
+
+	flowop->fo_stats.fs_minflt -= minflt;
+	flowop->fo_stats.fs_majflt -= majflt;
+	flowoplib_faults(&minflt, &majflt);
+	flowop->fo_stats.fs_minflt += minflt;
+	flowop->fo_stats.fs_majflt += majflt;
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Checks the pmemstore flowop's storemode attribute, one of auto,
+ * ntstore, clwb, clflushopt, clflush or msync, and saves it as an
+ * FB_PMEM_* mode. Returns -1 if it is unknown or the CPU doesn't
+ * support it.
+ */
+static int
+flowoplib_pmemstore_init(flowop_t *flowop)
+{
+	char *name = NULL;
+
+	if (flowop->fo_storemode)
+		name = avd_get_str(flowop->fo_storemode);
+
+	if ((flowop->fo_pmemmode = fb_pmem_mode(name)) < 0) {
+		filebench_log(LOG_ERROR, "flowop %s: storemode must be one "
+		    "of auto, ntstore, clwb, clflushopt, clflush or msync",
+		    flowop->fo_name);
+		return (-1);
+	}
+
+	if (!fb_pmem_supported(flowop->fo_pmemmode)) {
+		filebench_log(LOG_ERROR, "flowop %s: storemode %s is not "
+		    "supported by this CPU", flowop->fo_name, name);
+		return (-1);
+	}
+
+	return (flowop_init_generic(flowop));
+}
+
+/*
+ * Emulate an application persisting data on a DAX mapped file: stores
+ * iosize bytes into the mapping of the flowop's file, at an offset
+ * picked by flowoplib_mmapoffset(), and makes them persistent with the
+ * flowop's store mode, non-temporal stores or regular stores followed
+ * by cache line flushes, and a fence. Set mapsync for a MAP_SYNC
+ * mapping on real persistent memory; on other file systems the flowop
+ * runs against a plain shared mapping. The time spent flushing is also
+ * accounted separately. Returns FILEBENCH_ERROR on errors,
+ * FILEBENCH_NORSC if no file could be obtained, and FILEBENCH_OK
+ * otherwise.
+ */
+static int
+flowoplib_pmemstore(threadflow_t *threadflow, flowop_t *flowop)
+{
+	uint64_t minflt, majflt;
+	uint64_t fileoffset;
+	hrtime_t flushtime;
+	tf_mmap_t *map;
+	caddr_t iobuf;
+	fbint_t iosize;
+	fbint_t wss;
+	int mode;
+	int ret;
+
+	iosize = flowoplib_iosize(flowop);
+
+	if ((ret = flowoplib_mmapsetup(threadflow, flowop, TRUE,
+	    &map, &wss)) != FILEBENCH_OK)
+		return (ret);
+
+	if ((ret = flowoplib_iobufsetup(threadflow, flowop, &iobuf,
+	    iosize)) != FILEBENCH_OK)
+		return (ret);
+
+	if (flowoplib_mmapoffset(flowop, map, wss, iosize, &fileoffset) !=
+	    FILEBENCH_OK)
+		return (FILEBENCH_ERROR);
+
+	mode = fb_pmem_resolve(flowop->fo_pmemmode, (size_t)iosize);
+
+	flowoplib_faults(&minflt, &majflt);
+
+	flowop_beginop(threadflow, flowop);
+	fb_pmem_copy(mode, map->tm_addr + fileoffset, iobuf, (size_t)iosize);
+	flushtime = gethrtime();
+	ret = fb_pmem_flush(mode, map->tm_addr + fileoffset, (size_t)iosize);
+	flowop->fo_stats.fs_flush_lat += gethrtime() - flushtime;
+	flowop_endop(threadflow, flowop, ret ? 0 : iosize);
+
+	flowop->fo_stats.fs_minflt -= minflt;
+	flowop->fo_stats.fs_majflt -= majflt;
+	flowoplib_faults(&minflt, &majflt);
+	flowop->fo_stats.fs_minflt += minflt;
+	flowop->fo_stats.fs_majflt += majflt;
+
+	if (ret) {
+		filebench_log(LOG_ERROR, "flowop %s: msync failed: %s",
+		    flowop->fo_name, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Emulate close of a file.  Obtains the file descriptor index
+ * from the flowop, obtains the actual file descriptor from the
+ * threadflow's table, checks to be sure it is still an open
+ * file, then does a close operation on it. Then sets the
+ * threadflow file descriptor table entry to 0, and the file set
+ * entry pointer to NULL. Returns FILEBENCH_ERROR if the file was not open,
+ * FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_closefile(threadflow_t *threadflow, flowop_t *flowop)
+{
+	filesetentry_t *file;
+	fileset_t *fileset;
+	int fd;
+
+	fd = flowoplib_fdnum(threadflow, flowop);
+
+	if (threadflow->tf_fd[fd].fd_ptr == NULL) {
+		filebench_log(LOG_ERROR,
+		    "flowop %s attempted to close an already closed fd %d",
+		    flowop->fo_name, fd);
+		return (FILEBENCH_ERROR);
+	}
+
+	file = threadflow->tf_fse[fd];
+	fileset = file->fse_fileset;
+
+	/* Wait for it to be non-busy */
+	(void) ipc_mutex_lock(&fileset->fs_pick_lock);
+	while (file->fse_flags & FSE_BUSY) {
+		file->fse_flags |= FSE_THRD_WAITNG;
+		(void) pthread_cond_wait(&fileset->fs_thrd_wait_cv,
+		    &fileset->fs_pick_lock);
 	}
 
 	/* File now available, grab it for closing */
@@ -1907,6 +3129,8 @@ flowoplib_closefile(threadflow_t *threadflow, flowop_t *flowop)
 
 	(void) ipc_mutex_unlock(&fileset->fs_pick_lock);
 
+	flowoplib_munmap(threadflow, fd);
+
 	/* Measure time to close */
 	flowop_beginop(threadflow, flowop);
 	(void) FB_CLOSE(&threadflow->tf_fd[fd]);
@@ -2020,6 +3244,176 @@ flowoplib_removedir(threadflow_t *threadflow, flowop_t *flowop)
 	return (FILEBENCH_OK);
 }
 
+#ifdef __linux__
+
+#define	FLOWOPLIB_DIRBUFSIZE	32768	/* getdents64 size, as glibc's */
+
+/*
+ * Reads all entries of the directory open at dirfd into the thread's
+ * tf_dirbuf with getdents64(), bufsize bytes per call, growing the
+ * buffer as needed. Returns the number of bytes of entries read, or -1
+ * with errno set.
+ */
+static ssize_t
+flowoplib_getdents(threadflow_t *threadflow, int dirfd, size_t bufsize)
+{
+	size_t used = 0;
+	size_t len;
+	caddr_t buf;
+	long ret;
+
+	/* CONSTCOND */
+	while (1) {
+		if (threadflow->tf_dirbuflen - used < bufsize) {
+			len = MAX(threadflow->tf_dirbuflen * 2, used + bufsize);
+			if ((buf = realloc(threadflow->tf_dirbuf, len)) ==
+			    NULL) {
+				errno = ENOMEM;
+				return (-1);
+			}
+			threadflow->tf_dirbuf = buf;
+			threadflow->tf_dirbuflen = len;
+		}
+
+		ret = syscall(SYS_getdents64, dirfd,
+		    threadflow->tf_dirbuf + used, bufsize);
+		if (ret < 0)
+			return (-1);
+		if (ret == 0)
+			return (used);
+		used += ret;
+	}
+}
+
+/*
+ * Returns the amount read for the len bytes of entries in tf_dirbuf,
+ * counted as flowoplib_listdir() counts the entries readdir() returns,
+ * so that both ways of listing report the same bytes.
+ */
+static int64_t
+flowoplib_dentbytes(threadflow_t *threadflow, size_t len)
+{
+	struct dirent64 *dp;
+	int64_t bytes = 0;
+	size_t off;
+
+	for (off = 0; off < len; off += dp->d_reclen) {
+		dp = (struct dirent64 *)(threadflow->tf_dirbuf + off);
+		bytes += strlen(dp->d_name) + sizeof (struct dirent) - 1;
+	}
+
+	return (bytes);
+}
+
+/*
+ * Stats the len bytes of entries in tf_dirbuf, other than "." and "..",
+ * relative to dirfd. Uses a batch of io_uring statx requests when the
+ * io_uring plug-in is in use, and a statx() per entry otherwise.
+ * Entries removed in the meantime by other threads are not an error.
+ */
+static void
+flowoplib_statdents(threadflow_t *threadflow, int dirfd, size_t len)
+{
+	struct dirent64 *dp;
+	char **names;
+	size_t off;
+	int count = 0;
+	int i;
+#ifdef STATX_BASIC_STATS
+	struct statx stx;
+#else
+	struct stat64 sb;
+#endif
+
+	for (off = 0; off < len; off += dp->d_reclen) {
+		dp = (struct dirent64 *)(threadflow->tf_dirbuf + off);
+		if ((dp->d_name[0] == '.') && ((dp->d_name[1] == '\0') ||
+		    ((dp->d_name[1] == '.') && (dp->d_name[2] == '\0'))))
+			continue;
+
+		if (count == threadflow->tf_dirnamemax) {
+			i = MAX(threadflow->tf_dirnamemax * 2, 1024);
+			if ((names = realloc(threadflow->tf_dirnames,
+			    i * sizeof (char *))) == NULL)
+				break;
+			threadflow->tf_dirnames = names;
+			threadflow->tf_dirnamemax = i;
+		}
+		threadflow->tf_dirnames[count++] = dp->d_name;
+	}
+
+	if (fb_uring_statxv(dirfd, threadflow->tf_dirnames, count) >= 0)
+		return;
+
+	for (i = 0; i < count; i++) {
+#ifdef STATX_BASIC_STATS
+		(void) statx(dirfd, threadflow->tf_dirnames[i],
+		    AT_SYMLINK_NOFOLLOW, STATX_BASIC_STATS, &stx);
+#else
+		(void) fstatat64(dirfd, threadflow->tf_dirnames[i], &sb,
+		    AT_SYMLINK_NOFOLLOW);
+#endif
+	}
+}
+
+/*
+ * Lists a directory with raw getdents64() calls of a chosen size, and
+ * optionally stats every entry, as "ls -l" does. The time spent in the
+ * stat phase is also reported separately. Returns FILEBENCH_ERROR on
+ * errors, FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_listdir_raw(threadflow_t *threadflow, flowop_t *flowop,
+    char *path)
+{
+	size_t bufsize = FLOWOPLIB_DIRBUFSIZE;
+	hrtime_t stattime;
+	ssize_t len;
+	int dirfd;
+
+	if (flowop->fo_bufsize)
+		bufsize = (size_t)avd_get_int(flowop->fo_bufsize);
+
+	/* getdents64() needs room for at least one entry */
+	if (bufsize < sizeof (struct dirent64)) {
+		filebench_log(LOG_ERROR, "flowop %s: bufsize must be at "
+		    "least %d bytes", flowop->fo_name,
+		    (int)sizeof (struct dirent64));
+		return (FILEBENCH_ERROR);
+	}
+
+	flowop_beginop(threadflow, flowop);
+
+	if ((dirfd = open(path, O_RDONLY | O_DIRECTORY)) < 0) {
+		flowop_endop(threadflow, flowop, 0);
+		filebench_log(LOG_ERROR, "flowop %s failed to open directory "
+		    "%s: %s", flowop->fo_name, path, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	if ((len = flowoplib_getdents(threadflow, dirfd, bufsize)) < 0) {
+		(void) close(dirfd);
+		flowop_endop(threadflow, flowop, 0);
+		filebench_log(LOG_ERROR, "flowop %s failed to read directory "
+		    "%s: %s", flowop->fo_name, path, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	if (flowop->fo_boolattrs & FLOW_BOOL_WITHSTAT) {
+		stattime = gethrtime();
+		flowoplib_statdents(threadflow, dirfd, (size_t)len);
+		flowop->fo_stats.fs_stat_lat += gethrtime() - stattime;
+	}
+
+	(void) close(dirfd);
+	flowop_endop(threadflow, flowop,
+	    flowoplib_dentbytes(threadflow, (size_t)len));
+
+	return (FILEBENCH_OK);
+}
+
+#endif /* __linux__ */
+
 /*
  * Use opendir(), multiple readdir() calls, and closedir() to list the
  * contents of a directory.  Obtains the fileset name from the
@@ -2028,8 +3422,9 @@ flowoplib_removedir(threadflow_t *threadflow, flowop_t *flowop)
  * file system, a readdir() loop to access each directory entry, and
  * finally cleans up with a closedir(). The latency reported is the total
  * for all this activity, and it also reports the total number of bytes
- * in the entries as the amount "read". Returns FILEBENCH_ERROR on errors,
- * and FILEBENCH_OK on success.
+ * in the entries as the amount "read". With bufsize or withstat set, the
+ * directory is read with flowoplib_listdir_raw() instead. Returns
+ * FILEBENCH_ERROR on errors, and FILEBENCH_OK on success.
  */
 static int
 flowoplib_listdir(threadflow_t *threadflow, flowop_t *flowop)
@@ -2058,6 +3453,18 @@ flowoplib_listdir(threadflow_t *threadflow, flowop_t *flowop)
 	if ((ret = flowoplib_getdirpath(dir, full_path)) != FILEBENCH_OK)
 		return (ret);
 
+	if (flowop->fo_bufsize || (flowop->fo_boolattrs & FLOW_BOOL_WITHSTAT)) {
+#ifdef __linux__
+		ret = flowoplib_listdir_raw(threadflow, flowop, full_path);
+#else
+		filebench_log(LOG_ERROR, "flowop %s: bufsize and withstat "
+		    "are not supported on this platform", flowop->fo_name);
+		ret = FILEBENCH_ERROR;
+#endif /* __linux__ */
+		fileset_unbusy(dir, FALSE, FALSE, 0);
+		return (ret);
+	}
+
 	flowop_beginop(threadflow, flowop);
 
 	/* open the directory */
@@ -2127,59 +3534,507 @@ flowoplib_statfile(threadflow_t *threadflow, flowop_t *flowop)
 		return (FILEBENCH_ERROR);
 	}
 
-	/* can't be used with raw devices */
-	if (fileset->fs_attrs & FILESET_IS_RAW_DEV) {
-		filebench_log(LOG_ERROR,
-		    "flowop %s attempted do a statfile on a RAW device",
-		    flowop->fo_name);
+	/* can't be used with raw devices */
+	if (fileset->fs_attrs & FILESET_IS_RAW_DEV) {
+		filebench_log(LOG_ERROR,
+		    "flowop %s attempted do a statfile on a RAW device",
+		    flowop->fo_name);
+		return (FILEBENCH_ERROR);
+	}
+
+	if (file == NULL) {
+		char path[MAXPATHLEN];
+		char *pathtmp;
+		int err;
+
+		/* pick arbitrary, existing (allocated) file */
+		if ((err = flowoplib_pickfile(&file, flowop,
+		    FILESET_PICKEXISTS, 0)) != FILEBENCH_OK) {
+			filebench_log(LOG_DEBUG_SCRIPT,
+			    "Statfile flowop %s failed to pick file",
+			    flowop->fo_name);
+			return (err);
+		}
+
+		/* resolve path and do a stat on file */
+		(void) fb_strlcpy(path, avd_get_str(fileset->fs_path),
+		    MAXPATHLEN);
+		(void) fb_strlcat(path, "/", MAXPATHLEN);
+		(void) fb_strlcat(path, avd_get_str(fileset->fs_name),
+		    MAXPATHLEN);
+		pathtmp = fileset_resolvepath(file);
+		(void) fb_strlcat(path, pathtmp, MAXPATHLEN);
+		free(pathtmp);
+
+		/* stat the file */
+		flowop_beginop(threadflow, flowop);
+		if (FB_STAT(path, &statbuf) == -1)
+			filebench_log(LOG_ERROR,
+			    "statfile flowop %s failed", flowop->fo_name);
+		flowop_endop(threadflow, flowop, 0);
+
+		fileset_unbusy(file, FALSE, FALSE, 0);
+	} else {
+		/* stat specific file */
+		flowop_beginop(threadflow, flowop);
+		if (FB_FSTAT(&threadflow->tf_fd[fd], &statbuf) == -1)
+			filebench_log(LOG_ERROR,
+			    "statfile flowop %s failed", flowop->fo_name);
+		flowop_endop(threadflow, flowop, 0);
+
+	}
+
+	return (FILEBENCH_OK);
+}
+
+
+/*
+ * Metadata flowops: rename, hard and symbolic link, truncate, change
+ * mode and extended attributes. Like deletefile and statfile they work
+ * on a file open on the flowop's fd when there is one, and otherwise on
+ * files picked from the flowop's fileset. The flowops that give a file
+ * a new name take the name of a fileset entry that does not exist yet,
+ * and update the fileset's exist and noexist lists accordingly, so they
+ * can be mixed with createfile and deletefile in the same workload.
+ */
+
+#define	FLOWOPLIB_XATTRNAME	"user.filebench"
+#define	FLOWOPLIB_XATTRSIZE	64	/* default value size */
+#define	FLOWOPLIB_XATTRMAX	65536	/* largest value Linux accepts */
+
+/*
+ * Returns the fileset a metadata flowop works on, after checking that
+ * there is one and that it is not a raw device. Returns NULL and logs
+ * an error otherwise.
+ */
+static fileset_t *
+flowoplib_metafileset(flowop_t *flowop, filesetentry_t *file)
+{
+	fileset_t *fileset;
+
+	fileset = file ? file->fse_fileset : flowop->fo_fileset;
+	if (fileset == NULL) {
+		filebench_log(LOG_ERROR, "flowop %s: no fileset specified",
+		    flowop->fo_name);
+		return (NULL);
+	}
+
+	if (fileset->fs_attrs & FILESET_IS_RAW_DEV) {
+		filebench_log(LOG_ERROR,
+		    "flowop %s attempted a metadata operation on a RAW device",
+		    flowop->fo_name);
+		return (NULL);
+	}
+
+	return (fileset);
+}
+
+/*
+ * Chooses the file for a metadata flowop that changes a file in
+ * place. If the flowop's fd is open, the open file is used and its
+ * descriptor returned in fdescp. Otherwise an arbitrary existing file
+ * is picked, which the caller must release with fileset_unbusy(), and
+ * fdescp is set to NULL. In both cases the file's path is placed in
+ * path. Returns FILEBENCH_NORSC if no existing file is available,
+ * FILEBENCH_ERROR on errors and FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_metasetup(threadflow_t *threadflow, flowop_t *flowop,
+    filesetentry_t **filep, fb_fdesc_t **fdescp, char *path)
+{
+	filesetentry_t *file = NULL;
+	fileset_t *fileset;
+	int fd;
+	int err;
+
+	fd = flowoplib_fdnum(threadflow, flowop);
+
+	/* if fd specified and the file is open, use it to access file */
+	if ((fd > 0) && (threadflow->tf_fd[fd].fd_num > 0)) {
+		if ((file = threadflow->tf_fse[fd]) == NULL) {
+			filebench_log(LOG_ERROR,
+			    "flowop %s: no file open at fd = %d",
+			    flowop->fo_name, fd);
+			return (FILEBENCH_ERROR);
+		}
+	}
+
+	if ((fileset = flowoplib_metafileset(flowop, file)) == NULL)
+		return (FILEBENCH_ERROR);
+
+	if (file != NULL) {
+		*fdescp = &threadflow->tf_fd[fd];
+	} else {
+		if ((err = flowoplib_pickfile(&file, flowop,
+		    FILESET_PICKEXISTS, 0)) != FILEBENCH_OK)
+			return (err);
+		*fdescp = NULL;
+	}
+
+	*filep = file;
+	(void) fileset_entrypath(fileset, file, path, FALSE);
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Picks an existing file, and a fileset entry that does not exist yet
+ * to give it a new name, creating the latter's parent directories if
+ * needed. Both are returned busy, with their paths in srcpath and
+ * dstpath. Returns FILEBENCH_NORSC, with neither entry busy, if either
+ * kind of entry is not available.
+ */
+static int
+flowoplib_metapair(flowop_t *flowop, filesetentry_t **srcp,
+    filesetentry_t **dstp, char *srcpath, char *dstpath)
+{
+	fileset_t *fileset;
+	int err;
+
+	if ((fileset = flowoplib_metafileset(flowop, NULL)) == NULL)
+		return (FILEBENCH_ERROR);
+
+	if ((err = flowoplib_pickfile(srcp, flowop,
+	    FILESET_PICKEXISTS, 0)) != FILEBENCH_OK)
+		return (err);
+
+	if ((err = flowoplib_pickfile(dstp, flowop,
+	    FILESET_PICKNOEXIST, 0)) != FILEBENCH_OK) {
+		fileset_unbusy(*srcp, FALSE, FALSE, 0);
+		return (err);
+	}
+
+	(void) fileset_entrypath(fileset, *srcp, srcpath, FALSE);
+	if (fileset_entrypath(fileset, *dstp, dstpath, TRUE) ==
+	    FILEBENCH_ERROR) {
+		filebench_log(LOG_ERROR, "flowop %s: failed to create "
+		    "parent directory of %s", flowop->fo_name, dstpath);
+		fileset_unbusy(*srcp, FALSE, FALSE, 0);
+		fileset_unbusy(*dstp, FALSE, FALSE, 0);
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Renames an existing file of the fileset. By default the file takes
+ * the name of an entry that does not exist yet, which generally lives
+ * in another directory of the fileset, and the two entries swap their
+ * exist state. With samedir set the file is instead renamed to a
+ * temporary name next to it and back, the way files are replaced
+ * atomically, so each operation is two renames within the directory.
+ * Files open in any thread are skipped.
+ */
+static int
+flowoplib_renamefile(threadflow_t *threadflow, flowop_t *flowop)
+{
+	filesetentry_t *src, *dst;
+	fileset_t *fileset;
+	char srcpath[MAXPATHLEN];
+	char dstpath[MAXPATHLEN];
+	int samedir;
+	int ret;
+	int err;
+
+	samedir = (flowop->fo_boolattrs & FLOW_BOOL_SAMEDIR) != 0;
+	if (samedir) {
+		if ((fileset = flowoplib_metafileset(flowop, NULL)) == NULL)
+			return (FILEBENCH_ERROR);
+		if ((err = flowoplib_pickfile(&src, flowop,
+		    FILESET_PICKEXISTS, 0)) != FILEBENCH_OK)
+			return (err);
+		dst = NULL;
+		(void) fileset_entrypath(fileset, src, srcpath, FALSE);
+		(void) fb_strlcpy(dstpath, srcpath, MAXPATHLEN);
+		(void) fb_strlcat(dstpath, ".rename", MAXPATHLEN);
+	} else if ((err = flowoplib_metapair(flowop, &src, &dst,
+	    srcpath, dstpath)) != FILEBENCH_OK) {
+		return (err);
+	}
+
+	if (src->fse_open_cnt > 0) {
+		filebench_log(LOG_DEBUG_SCRIPT,
+		    "flowop %s can't rename file opened by other"
+		    " threads, open count = %d",
+		    flowop->fo_name, src->fse_open_cnt);
+		fileset_unbusy(src, FALSE, FALSE, 0);
+		if (dst != NULL)
+			fileset_unbusy(dst, FALSE, FALSE, 0);
+		return (FILEBENCH_OK);
+	}
+
+	flowop_beginop(threadflow, flowop);
+	ret = FB_RENAME(srcpath, dstpath);
+	if ((ret == 0) && samedir)
+		ret = FB_RENAME(dstpath, srcpath);
+	flowop_endop(threadflow, flowop, 0);
+
+	if (ret != 0) {
+		filebench_log(LOG_ERROR, "flowop %s: rename of %s to %s "
+		    "failed: %s", flowop->fo_name, srcpath, dstpath,
+		    strerror(errno));
+		fileset_unbusy(src, FALSE, FALSE, 0);
+		if (dst != NULL)
+			fileset_unbusy(dst, FALSE, FALSE, 0);
+		return (FILEBENCH_ERROR);
+	}
+
+	if (dst != NULL) {
+		/* the file now lives under the other entry's name */
+		fileset_unbusy(src, TRUE, FALSE, 0);
+		fileset_unbusy(dst, TRUE, TRUE, 0);
+	} else {
+		fileset_unbusy(src, FALSE, FALSE, 0);
+	}
+
+	filebench_log(LOG_DEBUG_SCRIPT, "renamed %s to %s", srcpath, dstpath);
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Common code of linkfile and symlinkfile: gives an existing file of
+ * the fileset a second name, that of an entry which does not exist
+ * yet and which exists from then on. The new name can later be removed
+ * with deletefile like any other file; a symbolic link whose target
+ * was deleted can no longer be opened.
+ */
+static int
+flowoplib_linkcommon(threadflow_t *threadflow, flowop_t *flowop,
+    int symbolic)
+{
+	filesetentry_t *src, *dst;
+	char srcpath[MAXPATHLEN];
+	char dstpath[MAXPATHLEN];
+	int ret;
+	int err;
+
+	if ((err = flowoplib_metapair(flowop, &src, &dst,
+	    srcpath, dstpath)) != FILEBENCH_OK)
+		return (err);
+
+	flowop_beginop(threadflow, flowop);
+	if (symbolic)
+		ret = FB_SYMLINK(srcpath, dstpath);
+	else
+		ret = FB_LINK(srcpath, dstpath);
+	flowop_endop(threadflow, flowop, 0);
+
+	fileset_unbusy(src, FALSE, FALSE, 0);
+
+	if (ret != 0) {
+		filebench_log(LOG_ERROR, "flowop %s: %slink of %s to %s "
+		    "failed: %s", flowop->fo_name, symbolic ? "sym" : "",
+		    dstpath, srcpath, strerror(errno));
+		fileset_unbusy(dst, FALSE, FALSE, 0);
+		return (FILEBENCH_ERROR);
+	}
+
+	fileset_unbusy(dst, TRUE, TRUE, 0);
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Creates a hard link to an existing file of the fileset.
+ */
+static int
+flowoplib_linkfile(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (flowoplib_linkcommon(threadflow, flowop, FALSE));
+}
+
+/*
+ * Creates a symbolic link to an existing file of the fileset.
+ */
+static int
+flowoplib_symlinkfile(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (flowoplib_linkcommon(threadflow, flowop, TRUE));
+}
+
+/*
+ * Truncates the file open on the flowop's fd, or an arbitrary existing
+ * file of the fileset, to iosize bytes, which defaults to 0. Picked
+ * files are opened and closed outside of the measured interval, so that
+ * only the truncate itself is timed.
+ */
+static int
+flowoplib_truncatefile(threadflow_t *threadflow, flowop_t *flowop)
+{
+	filesetentry_t *file;
+	fb_fdesc_t *fdesc;
+	fb_fdesc_t tmpfd;
+	char path[MAXPATHLEN];
+	off64_t size;
+	int ret;
+	int err;
+
+	if ((err = flowoplib_metasetup(threadflow, flowop, &file,
+	    &fdesc, path)) != FILEBENCH_OK)
+		return (err);
+
+	size = (off64_t)flowoplib_iosize(flowop);
+
+	if (fdesc == NULL) {
+		if (FB_OPEN(&tmpfd, path, O_WRONLY, 0) == FILEBENCH_ERROR) {
+			filebench_log(LOG_ERROR, "flowop %s: failed to open "
+			    "%s: %s", flowop->fo_name, path, strerror(errno));
+			fileset_unbusy(file, FALSE, FALSE, 0);
+			return (FILEBENCH_ERROR);
+		}
+
+		flowop_beginop(threadflow, flowop);
+		ret = FB_FTRUNC(&tmpfd, size);
+		flowop_endop(threadflow, flowop, 0);
+
+		(void) FB_CLOSE(&tmpfd);
+		fileset_unbusy(file, FALSE, FALSE, 0);
+	} else {
+		flowop_beginop(threadflow, flowop);
+		ret = FB_FTRUNC(fdesc, size);
+		flowop_endop(threadflow, flowop, 0);
+	}
+
+	if (ret != 0) {
+		filebench_log(LOG_ERROR, "flowop %s: truncate of %s failed: %s",
+		    flowop->fo_name, path, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Changes the mode of a file, alternately adding and removing group
+ * write permission, so that every call is a real inode update.
+ */
+static int
+flowoplib_setattr(threadflow_t *threadflow, flowop_t *flowop)
+{
+	filesetentry_t *file;
+	fb_fdesc_t *fdesc;
+	char path[MAXPATHLEN];
+	mode_t mode;
+	int ret;
+	int err;
+
+	if ((err = flowoplib_metasetup(threadflow, flowop, &file,
+	    &fdesc, path)) != FILEBENCH_OK)
+		return (err);
+
+	mode = (flowop->fo_stats.fs_count & 1) ? 0644 : 0664;
+
+	flowop_beginop(threadflow, flowop);
+	if (fdesc != NULL)
+		ret = fchmod(fdesc->fd_num, mode);
+	else
+		ret = chmod(path, mode);
+	flowop_endop(threadflow, flowop, 0);
+
+	if (fdesc == NULL)
+		fileset_unbusy(file, FALSE, FALSE, 0);
+
+	if (ret != 0) {
+		filebench_log(LOG_ERROR, "flowop %s: chmod of %s failed: %s",
+		    flowop->fo_name, path, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Common code of setxattr and getxattr. Sets, or reads back, the
+ * FLOWOPLIB_XATTRNAME extended attribute of a file, with a value of
+ * iosize bytes (FLOWOPLIB_XATTRSIZE if iosize is not set). Reading an
+ * attribute that was never set counts as a completed operation of zero
+ * bytes, so getxattr can also be used on files setxattr did not visit.
+ */
+static int
+flowoplib_xattr(threadflow_t *threadflow, flowop_t *flowop, int set)
+{
+#ifdef __linux__
+	filesetentry_t *file;
+	fb_fdesc_t *fdesc;
+	char path[MAXPATHLEN];
+	caddr_t iobuf;
+	fbint_t iosize;
+	ssize_t ret;
+	int err;
+
+	iosize = flowoplib_iosize(flowop);
+	if (iosize == 0)
+		iosize = FLOWOPLIB_XATTRSIZE;
+	if (iosize > FLOWOPLIB_XATTRMAX) {
+		filebench_log(LOG_ERROR, "flowop %s: extended attribute "
+		    "size %llu exceeds %d bytes", flowop->fo_name,
+		    (u_longlong_t)iosize, FLOWOPLIB_XATTRMAX);
 		return (FILEBENCH_ERROR);
 	}
 
-	if (file == NULL) {
-		char path[MAXPATHLEN];
-		char *pathtmp;
-		int err;
+	if ((err = flowoplib_iobufsetup(threadflow, flowop, &iobuf,
+	    iosize)) != FILEBENCH_OK)
+		return (err);
 
-		/* pick arbitrary, existing (allocated) file */
-		if ((err = flowoplib_pickfile(&file, flowop,
-		    FILESET_PICKEXISTS, 0)) != FILEBENCH_OK) {
-			filebench_log(LOG_DEBUG_SCRIPT,
-			    "Statfile flowop %s failed to pick file",
-			    flowop->fo_name);
-			return (err);
-		}
+	if ((err = flowoplib_metasetup(threadflow, flowop, &file,
+	    &fdesc, path)) != FILEBENCH_OK)
+		return (err);
 
-		/* resolve path and do a stat on file */
-		(void) fb_strlcpy(path, avd_get_str(fileset->fs_path),
-		    MAXPATHLEN);
-		(void) fb_strlcat(path, "/", MAXPATHLEN);
-		(void) fb_strlcat(path, avd_get_str(fileset->fs_name),
-		    MAXPATHLEN);
-		pathtmp = fileset_resolvepath(file);
-		(void) fb_strlcat(path, pathtmp, MAXPATHLEN);
-		free(pathtmp);
+	flowop_beginop(threadflow, flowop);
+	if (set && (fdesc != NULL))
+		ret = fsetxattr(fdesc->fd_num, FLOWOPLIB_XATTRNAME,
+		    iobuf, iosize, 0);
+	else if (set)
+		ret = setxattr(path, FLOWOPLIB_XATTRNAME, iobuf, iosize, 0);
+	else if (fdesc != NULL)
+		ret = fgetxattr(fdesc->fd_num, FLOWOPLIB_XATTRNAME,
+		    iobuf, iosize);
+	else
+		ret = getxattr(path, FLOWOPLIB_XATTRNAME, iobuf, iosize);
 
-		/* stat the file */
-		flowop_beginop(threadflow, flowop);
-		if (FB_STAT(path, &statbuf) == -1)
-			filebench_log(LOG_ERROR,
-			    "statfile flowop %s failed", flowop->fo_name);
-		flowop_endop(threadflow, flowop, 0);
+	if (set && (ret == 0))
+		ret = iosize;
+	else if (!set && (ret < 0) && (errno == ENODATA))
+		ret = 0;
+	flowop_endop(threadflow, flowop, (ret > 0) ? ret : 0);
 
+	if (fdesc == NULL)
 		fileset_unbusy(file, FALSE, FALSE, 0);
-	} else {
-		/* stat specific file */
-		flowop_beginop(threadflow, flowop);
-		if (FB_FSTAT(&threadflow->tf_fd[fd], &statbuf) == -1)
-			filebench_log(LOG_ERROR,
-			    "statfile flowop %s failed", flowop->fo_name);
-		flowop_endop(threadflow, flowop, 0);
 
+	if (ret < 0) {
+		filebench_log(LOG_ERROR, "flowop %s: %sxattr of %s failed: %s",
+		    flowop->fo_name, set ? "set" : "get", path,
+		    strerror(errno));
+		return (FILEBENCH_ERROR);
 	}
 
 	return (FILEBENCH_OK);
+#else
+	filebench_log(LOG_ERROR, "flowop %s: extended attributes are not "
+	    "supported on this platform", flowop->fo_name);
+	return (FILEBENCH_ERROR);
+#endif /* __linux__ */
+}
+
+/*
+ * Sets an extended attribute on a file.
+ */
+static int
+flowoplib_setxattr(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (flowoplib_xattr(threadflow, flowop, TRUE));
 }
 
+/*
+ * Reads an extended attribute of a file.
+ */
+static int
+flowoplib_getxattr(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (flowoplib_xattr(threadflow, flowop, FALSE));
+}
 
 /*
  * Additional reads and writes. Read and write whole files, write
@@ -2216,7 +4071,7 @@ flowoplib_readwholefile(threadflow_t *threadflow, flowop_t *flowop)
 		return (ret);
 
 	/* an I/O size of zero means read entire working set with one I/O */
-	if ((iosize = avd_get_int(flowop->fo_iosize)) == 0)
+	if ((iosize = flowoplib_iosize(flowop)) == 0)
 		iosize = wss;
 
 	/*
@@ -2276,12 +4131,12 @@ flowoplib_write(threadflow_t *threadflow, flowop_t *flowop)
 	fb_fdesc_t *fdesc;
 	int ret;
 
-	iosize = avd_get_int(flowop->fo_iosize);
+	iosize = flowoplib_iosize(flowop);
 	if ((ret = flowoplib_iosetup(threadflow, flowop, &wss, &iobuf,
 	    &fdesc, iosize)) != FILEBENCH_OK)
 		return (ret);
 
-	if (avd_get_bool(flowop->fo_random)) {
+	if (flowop->fo_boolattrs & FLOW_BOOL_RANDOM) {
 		uint64_t fileoffset;
 
 		if (wss < iosize) {
@@ -2292,7 +4147,7 @@ flowoplib_write(threadflow_t *threadflow, flowop_t *flowop)
 		}
 
 		/* select randomly */
-		fb_random64(&fileoffset, wss, iosize, NULL);
+		fileoffset = fb_random_ring(&flowop->fo_offring, wss, iosize);
 
 		flowop_beginop(threadflow, flowop);
 		if (FB_PWRITE(fdesc, iobuf,
@@ -2319,6 +4174,174 @@ flowoplib_write(threadflow_t *threadflow, flowop_t *flowop)
 	return (FILEBENCH_OK);
 }
 
+/*
+ * Maximum number of I/O vector segments of a readv or writev flowop.
+ */
+#define	FLOWOPLIB_MAXIOV	64
+
+/*
+ * Parses the readv or writev flowop's rwflags attribute, a comma
+ * separated list of nowait, hipri, dsync and sync, into FB_RWF_* flags
+ * kept in fo_rwflagset. Returns -1 if a flag is unknown.
+ */
+static int
+flowoplib_rwv_init(flowop_t *flowop)
+{
+	char flags[128];
+	char *flag;
+	char *last;
+
+	flowop->fo_rwflagset = 0;
+
+	if (flowop->fo_rwflags && avd_get_str(flowop->fo_rwflags)) {
+		(void) fb_strlcpy(flags, avd_get_str(flowop->fo_rwflags),
+		    sizeof (flags));
+
+		for (flag = strtok_r(flags, ", ", &last); flag != NULL;
+		    flag = strtok_r(NULL, ", ", &last)) {
+			if (!strcmp(flag, "nowait"))
+				flowop->fo_rwflagset |= FB_RWF_NOWAIT;
+			else if (!strcmp(flag, "hipri"))
+				flowop->fo_rwflagset |= FB_RWF_HIPRI;
+			else if (!strcmp(flag, "dsync"))
+				flowop->fo_rwflagset |= FB_RWF_DSYNC;
+			else if (!strcmp(flag, "sync"))
+				flowop->fo_rwflagset |= FB_RWF_SYNC;
+			else {
+				filebench_log(LOG_ERROR, "flowop %s: unknown "
+				    "rwflag %s, expected nowait, hipri, dsync "
+				    "or sync", flowop->fo_name, flag);
+				return (-1);
+			}
+		}
+	}
+
+	return (flowop_init_generic(flowop));
+}
+
+/*
+ * Emulate posix preadv2 / pwritev2 of fo_iosize bytes split over
+ * iovcnt segments, with the flowop's rwflags. The file is chosen and
+ * opened as for read and write, and the I/O goes to a random offset
+ * within the working set, or to the file's current position. Each
+ * segment is at its own random offset in the threadflow's memory
+ * (tf_mem); without tf_mem, or for generated content, the segments
+ * split the flowop's private buffer. A read with nowait that would
+ * block is reissued without it. Returns FILEBENCH_ERROR on errors,
+ * FILEBENCH_NORSC if no file could be obtained, FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_rwv(threadflow_t *threadflow, flowop_t *flowop, int write)
+{
+	struct iovec iov[FLOWOPLIB_MAXIOV];
+	fb_fdesc_t *fdesc;
+	uint64_t fileoffset;
+	off64_t offset = -1;
+	caddr_t iobuf;
+	fbint_t iosize;
+	fbint_t segsize;
+	fbint_t wss;
+	int flags = flowop->fo_rwflagset;
+	int iovcnt = 1;
+	int scatter;
+	int ret;
+	int i;
+
+	iosize = flowoplib_iosize(flowop);
+	if (flowop->fo_iovcnt)
+		iovcnt = (int)FLOWOP_INT(flowop, iovcnt, FLOW_VAR_IOVCNT);
+
+	if ((iovcnt < 1) || (iovcnt > FLOWOPLIB_MAXIOV) || (iosize < iovcnt)) {
+		filebench_log(LOG_ERROR, "flowop %s: iovcnt must be between "
+		    "1 and %d and at most iosize", flowop->fo_name,
+		    FLOWOPLIB_MAXIOV);
+		return (FILEBENCH_ERROR);
+	}
+
+	if ((ret = flowoplib_filesetup(threadflow, flowop, &wss, &fdesc)) !=
+	    FILEBENCH_OK)
+		return (ret);
+
+	/* the last segment also gets the remainder */
+	segsize = iosize / iovcnt;
+	scatter = threadflow->tf_constmemsize && !flowop->fo_compress &&
+	    !flowop->fo_dedupe;
+
+	if (!scatter && ((ret = flowoplib_iobufsetup(threadflow, flowop,
+	    &iobuf, iosize)) != FILEBENCH_OK))
+		return (ret);
+
+	for (i = 0; i < iovcnt; i++) {
+		fbint_t len = (i == iovcnt - 1) ?
+		    iosize - segsize * (iovcnt - 1) : segsize;
+
+		if (scatter) {
+			if ((ret = flowoplib_iobufsetup(threadflow, flowop,
+			    &iobuf, len)) != FILEBENCH_OK)
+				return (ret);
+			iov[i].iov_base = iobuf;
+		} else {
+			iov[i].iov_base = iobuf + segsize * i;
+		}
+		iov[i].iov_len = (size_t)len;
+	}
+
+	if (flowop->fo_boolattrs & FLOW_BOOL_RANDOM) {
+		if (wss < iosize) {
+			filebench_log(LOG_ERROR,
+			    "file size smaller than IO size for thread %s",
+			    flowop->fo_name);
+			return (FILEBENCH_ERROR);
+		}
+
+		fileoffset = fb_random_ring(&flowop->fo_offring, wss, iosize);
+		offset = (off64_t)fileoffset;
+	}
+
+	flowop_beginop(threadflow, flowop);
+	if (write)
+		ret = FB_PWRITEV2(fdesc, iov, iovcnt, offset, flags);
+	else
+		ret = FB_PREADV2(fdesc, iov, iovcnt, offset, flags);
+
+	if ((ret == -1) && (errno == EAGAIN) && (flags & FB_RWF_NOWAIT)) {
+		filebench_log(LOG_DEBUG_IMPL, "flowop %s: nowait I/O would "
+		    "block, reissuing", flowop->fo_name);
+		flags &= ~FB_RWF_NOWAIT;
+		if (write)
+			ret = FB_PWRITEV2(fdesc, iov, iovcnt, offset, flags);
+		else
+			ret = FB_PREADV2(fdesc, iov, iovcnt, offset, flags);
+	}
+
+	if (ret == -1) {
+		flowop_endop(threadflow, flowop, 0);
+		filebench_log(LOG_ERROR, "%s file %s failed, offset %lld: %s",
+		    write ? "writev" : "readv",
+		    avd_get_str(flowop->fo_fileset->fs_name),
+		    (long long)offset, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+	flowop_endop(threadflow, flowop, ret);
+
+	if (!write && (ret == 0))
+		(void) FB_LSEEK(fdesc, 0, SEEK_SET);
+
+	return (FILEBENCH_OK);
+}
+
+static int
+flowoplib_readv(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (flowoplib_rwv(threadflow, flowop, FALSE));
+}
+
+static int
+flowoplib_writev(threadflow_t *threadflow, flowop_t *flowop)
+{
+	return (flowoplib_rwv(threadflow, flowop, TRUE));
+}
+
 /*
  * Emulate a write of a whole file.  The size of the file
  * is taken from a filesetentry identified by fo_srcfdnumber or
@@ -2348,7 +4371,7 @@ flowoplib_writewholefile(threadflow_t *threadflow, flowop_t *flowop)
 		return (ret);
 
 	/* an I/O size of zero means write entire working set with one I/O */
-	if ((iosize = avd_get_int(flowop->fo_iosize)) == 0)
+	if ((iosize = flowoplib_iosize(flowop)) == 0)
 		iosize = wss;
 
 	/*
@@ -2398,6 +4421,279 @@ flowoplib_writewholefile(threadflow_t *threadflow, flowop_t *flowop)
 }
 
 
+/*
+ * Copies len bytes at *srcoffp in src to *dstoffp in dst without
+ * passing them through user memory, advancing both offsets. Tries
+ * copy_file_range(), which lets reflink capable file systems share the
+ * blocks instead of copying them, then sendfile(). Returns the number
+ * of bytes copied, 0 at the end of src, or -1 with errno set; an errno
+ * of EOPNOTSUPP means neither is usable for these files, and *methodp
+ * is then set so that they are not tried again.
+ */
+static ssize_t
+flowoplib_copyrange(fb_fdesc_t *src, off64_t *srcoffp, fb_fdesc_t *dst,
+    off64_t *dstoffp, size_t len, int *methodp)
+{
+	ssize_t ret;
+
+#ifdef __NR_copy_file_range
+	if (*methodp == 0) {
+		ret = syscall(__NR_copy_file_range, src->fd_num, srcoffp,
+		    dst->fd_num, dstoffp, len, 0);
+		if ((ret >= 0) || ((errno != ENOSYS) && (errno != EXDEV) &&
+		    (errno != EINVAL) && (errno != EOPNOTSUPP)))
+			return (ret);
+		*methodp = 1;
+	}
+#endif /* __NR_copy_file_range */
+
+#ifdef __linux__
+	if (*methodp == 1) {
+		/* sendfile() writes at the destination's file position */
+		if (lseek64(dst->fd_num, *dstoffp, SEEK_SET) == -1)
+			return (-1);
+		if ((ret = sendfile64(dst->fd_num, src->fd_num, srcoffp,
+		    len)) >= 0) {
+			*dstoffp += ret;
+			return (ret);
+		}
+		if ((errno != ENOSYS) && (errno != EINVAL))
+			return (-1);
+	}
+#endif /* __linux__ */
+
+	*methodp = 2;
+	errno = EOPNOTSUPP;
+	return (-1);
+}
+
+/*
+ * Emulate a copy of a whole file inside the kernel. The source is the
+ * file open on the flowop's srcfd, which must have been opened before,
+ * and the destination the file on its fd, opened if necessary. The
+ * source is copied to the start of the destination with
+ * copy_file_range() or sendfile(), iosize bytes per call, or all of it
+ * in one call if iosize is zero. Where neither works, it falls back to
+ * reading into and writing from a buffer. Returns FILEBENCH_ERROR on
+ * error, FILEBENCH_NORSC if out of files, FILEBENCH_OK on success.
+ */
+static int
+flowoplib_copyfile(threadflow_t *threadflow, flowop_t *flowop)
+{
+	int srcfd = flowop->fo_srcfdnumber;
+	fb_fdesc_t *src;
+	fb_fdesc_t *dst;
+	struct stat64 sb;
+	off64_t srcoff = 0;
+	off64_t dstoff = 0;
+	off64_t bytes = 0;
+	caddr_t iobuf = NULL;
+	fbint_t iosize;
+	fbint_t wss;
+	ssize_t ret;
+	int method = 0;
+
+	if ((srcfd == 0) || (threadflow->tf_fd[srcfd].fd_ptr == NULL)) {
+		filebench_log(LOG_ERROR, "flowop %s: srcfd %d is not open",
+		    flowop->fo_name, srcfd);
+		return (FILEBENCH_ERROR);
+	}
+	src = &threadflow->tf_fd[srcfd];
+
+	/* get the file to copy to */
+	if ((ret = flowoplib_filesetup(threadflow, flowop, &wss,
+	    &dst)) != FILEBENCH_OK)
+		return (ret);
+
+	if (FB_FSTAT(src, &sb) < 0) {
+		filebench_log(LOG_ERROR, "flowop %s: stat of srcfd %d "
+		    "failed: %s", flowop->fo_name, srcfd, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	/* an I/O size of zero means copy the entire file with one call */
+	if ((iosize = flowoplib_iosize(flowop)) == 0)
+		iosize = MAX(sb.st_size, 1);
+
+	/* Measure time to copy bytes */
+	flowop_beginop(threadflow, flowop);
+	while (srcoff < sb.st_size) {
+		size_t len = (size_t)MIN(iosize, sb.st_size - srcoff);
+
+		if (method < 2) {
+			ret = flowoplib_copyrange(src, &srcoff, dst, &dstoff,
+			    len, &method);
+		} else {
+			if ((iobuf == NULL) && (flowoplib_iobufsetup(
+			    threadflow, flowop, &iobuf, iosize) != 0)) {
+				flowop_endop(threadflow, flowop, bytes);
+				return (FILEBENCH_ERROR);
+			}
+			if ((ret = FB_PREAD(src, iobuf, len, srcoff)) > 0)
+				ret = FB_PWRITE(dst, iobuf, ret, dstoff);
+			if (ret > 0) {
+				srcoff += ret;
+				dstoff += ret;
+			}
+		}
+
+		if ((ret == -1) && (method == 2) && (errno == EOPNOTSUPP))
+			continue;
+		if (ret <= 0)
+			break;
+		bytes += ret;
+	}
+	flowop_endop(threadflow, flowop, bytes);
+
+	if (ret < 0) {
+		filebench_log(LOG_ERROR, "flowop %s: copy from fd %d to "
+		    "fd %d failed: %s", flowop->fo_name, src->fd_num,
+		    dst->fd_num, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Sets up the threadflow's sink for sendfile: a pipe whose contents
+ * are spliced into /dev/null. Returns FILEBENCH_ERROR if it can't be
+ * created, FILEBENCH_OK otherwise.
+ */
+static int
+flowoplib_sinksetup(threadflow_t *threadflow)
+{
+	int ret;
+
+	if (threadflow->tf_nullfd > 0)
+		return (FILEBENCH_OK);
+
+	if (pipe(threadflow->tf_sinkfd) < 0)
+		return (FILEBENCH_ERROR);
+
+	threadflow->tf_sinksize = PIPE_BUF;
+#ifdef F_SETPIPE_SZ
+	/* a bigger pipe means fewer sendfile/splice round trips */
+	(void) fcntl(threadflow->tf_sinkfd[1], F_SETPIPE_SZ, 1024 * 1024);
+	if ((ret = fcntl(threadflow->tf_sinkfd[1], F_GETPIPE_SZ)) > 0)
+		threadflow->tf_sinksize = ret;
+#endif /* F_SETPIPE_SZ */
+
+	if ((threadflow->tf_nullfd = open("/dev/null", O_WRONLY)) < 0) {
+		(void) close(threadflow->tf_sinkfd[0]);
+		(void) close(threadflow->tf_sinkfd[1]);
+		threadflow->tf_nullfd = 0;
+		return (FILEBENCH_ERROR);
+	}
+
+	return (FILEBENCH_OK);
+}
+
+/*
+ * Emulate a server sending a file: sends iosize bytes of the file open
+ * on the flowop's fd, or the whole working set if iosize is zero, to
+ * the thread's pipe sink with sendfile(), which in turn is emptied with
+ * splice(), so the data never enters user memory. The bytes come from
+ * a random offset, or from the file's current position. Where
+ * sendfile() is not available the file is read into a buffer instead.
+ * Returns FILEBENCH_ERROR on error, FILEBENCH_NORSC if out of files,
+ * FILEBENCH_OK on success.
+ */
+static int
+flowoplib_sendfile(threadflow_t *threadflow, flowop_t *flowop)
+{
+	fb_fdesc_t *fdesc;
+	uint64_t fileoffset;
+	off64_t offset;
+	off64_t bytes = 0;
+	fbint_t iosize;
+	fbint_t wss;
+	ssize_t ret;
+
+	if ((ret = flowoplib_filesetup(threadflow, flowop, &wss,
+	    &fdesc)) != FILEBENCH_OK)
+		return (ret);
+
+	if ((iosize = flowoplib_iosize(flowop)) == 0)
+		iosize = wss;
+
+	if (flowop->fo_boolattrs & FLOW_BOOL_RANDOM) {
+		if (wss < iosize) {
+			filebench_log(LOG_ERROR,
+			    "file size smaller than IO size for thread %s",
+			    flowop->fo_name);
+			return (FILEBENCH_ERROR);
+		}
+		fileoffset = fb_random_ring(&flowop->fo_offring, wss, iosize);
+		offset = (off64_t)fileoffset;
+	} else {
+		if ((offset = FB_LSEEK(fdesc, 0, SEEK_CUR)) == -1)
+			offset = 0;
+		if (offset + iosize > wss)
+			offset = 0;
+	}
+
+#ifdef __linux__
+	if (flowoplib_sinksetup(threadflow) != FILEBENCH_OK) {
+		filebench_log(LOG_ERROR, "flowop %s: could not set up "
+		    "sendfile sink: %s", flowop->fo_name, strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	/* Measure time to send bytes */
+	flowop_beginop(threadflow, flowop);
+	while (bytes < iosize) {
+		ssize_t sent;
+
+		/* no more than the pipe holds, as nobody else empties it */
+		if ((sent = sendfile64(threadflow->tf_sinkfd[1], fdesc->fd_num,
+		    &offset, (size_t)MIN(iosize - bytes,
+		    threadflow->tf_sinksize))) <= 0) {
+			ret = sent;
+			break;
+		}
+		bytes += sent;
+
+		for (ret = 0; sent > 0; sent -= ret) {
+			if ((ret = splice(threadflow->tf_sinkfd[0], NULL,
+			    threadflow->tf_nullfd, NULL, sent,
+			    SPLICE_F_MOVE)) <= 0) {
+				ret = -1;
+				break;
+			}
+		}
+		if (ret < 0)
+			break;
+	}
+	flowop_endop(threadflow, flowop, bytes);
+#else
+	caddr_t iobuf;
+
+	if (flowoplib_iobufsetup(threadflow, flowop, &iobuf, iosize) != 0)
+		return (FILEBENCH_ERROR);
+
+	flowop_beginop(threadflow, flowop);
+	if ((ret = FB_PREAD(fdesc, iobuf, iosize, offset)) > 0) {
+		bytes = ret;
+		offset += ret;
+	}
+	flowop_endop(threadflow, flowop, bytes);
+#endif /* __linux__ */
+
+	if (ret < 0) {
+		filebench_log(LOG_ERROR, "flowop %s: sendfile of fd %d "
+		    "failed: %s", flowop->fo_name, fdesc->fd_num,
+		    strerror(errno));
+		return (FILEBENCH_ERROR);
+	}
+
+	if (!(flowop->fo_boolattrs & FLOW_BOOL_RANDOM))
+		(void) FB_LSEEK(fdesc, offset, SEEK_SET);
+
+	return (FILEBENCH_OK);
+}
+
+
 /*
  * Emulate a fixed size append to a file. Will append data to
  * a file chosen from a fileset if the flowop's fo_fileset
@@ -2423,7 +4719,7 @@ flowoplib_appendfile(threadflow_t *threadflow, flowop_t *flowop)
 	fbint_t iosize;
 	int ret;
 
-	iosize = avd_get_int(flowop->fo_iosize);
+	iosize = flowoplib_iosize(flowop);
 	if ((ret = flowoplib_iosetup(threadflow, flowop, &wss, &iobuf,
 	    &fdesc, iosize)) != FILEBENCH_OK)
 		return (ret);
@@ -2472,13 +4768,13 @@ flowoplib_appendfilerand(threadflow_t *threadflow, flowop_t *flowop)
 	fbint_t iosize;
 	int ret = 0;
 
-	if ((iosize = avd_get_int(flowop->fo_iosize)) == 0) {
+	if ((iosize = flowoplib_iosize(flowop)) == 0) {
 		filebench_log(LOG_ERROR, "zero iosize for flowop %s",
 		    flowop->fo_name);
 		return (FILEBENCH_ERROR);
 	}
 
-	fb_random64(&appendsize, iosize, 1LL, NULL);
+	appendsize = fb_random_ring(&flowop->fo_offring, iosize, 1LL);
 
 	/* skip if attempting zero length append */
 	if (appendsize == 0) {
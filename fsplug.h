@@ -29,6 +29,7 @@
 #define	_FB_FSPLUG_H
 
 #include "filebench.h"
+#include <sys/uio.h>
 
 /*
  * Type of file system client plug-in desired.
@@ -37,7 +38,8 @@ typedef enum fb_plugin_type {
 	LOCAL_FS_PLUG = 0,
 	NFS3_PLUG,
 	NFS4_PLUG,
-	CIFS_PLUG
+	CIFS_PLUG,
+	IO_URING_PLUG
 } fb_plugin_type_t;
 
 /* universal file descriptor for both local and nfs file systems */
@@ -48,6 +50,25 @@ typedef union fb_fdesc {
 
 typedef struct aiolist aiol_t;
 
+/* Page cache control operations for fsp_cachectl */
+#define	FB_CACHE_NORMAL		0 /* default access pattern advice */
+#define	FB_CACHE_SEQUENTIAL	1 /* expect sequential access */
+#define	FB_CACHE_RANDOM		2 /* expect random access, no readahead */
+#define	FB_CACHE_WILLNEED	3 /* start reading range into the cache */
+#define	FB_CACHE_DONTNEED	4 /* write back and drop range from cache */
+#define	FB_CACHE_READAHEAD	5 /* read range into the cache */
+
+/* Per-operation flags for fsp_preadv2 and fsp_pwritev2 */
+#define	FB_RWF_NOWAIT		0x1 /* fail with EAGAIN rather than block */
+#define	FB_RWF_HIPRI		0x2 /* poll for completion */
+#define	FB_RWF_DSYNC		0x4 /* write as if opened with O_DSYNC */
+#define	FB_RWF_SYNC		0x8 /* write as if opened with O_SYNC */
+
+/* Flags for fsp_syncrange */
+#define	FB_SFR_WAIT_BEFORE	0x1 /* wait for writeback already started */
+#define	FB_SFR_WRITE		0x2 /* start writeback of dirty pages */
+#define	FB_SFR_WAIT_AFTER	0x4 /* wait for the writeback to finish */
+
 /* Functions vector for file system plug-ins */
 typedef struct fsplug_func_s {
 	char fs_name[16];
@@ -75,6 +96,15 @@ typedef struct fsplug_func_s {
 	int (*fsp_fstat)(fb_fdesc_t *, struct stat64 *);
 	int (*fsp_access)(const char *, int);
 	void (*fsp_recur_rm)(char *);
+	int (*fsp_fallocate)(fb_fdesc_t *, int, off64_t, off64_t);
+	int (*fsp_cachectl)(fb_fdesc_t *, int, off64_t, off64_t);
+	int (*fsp_preadv2)(fb_fdesc_t *, const struct iovec *, int, off64_t,
+	    int);
+	int (*fsp_pwritev2)(fb_fdesc_t *, const struct iovec *, int, off64_t,
+	    int);
+	int (*fsp_fdatasync)(fb_fdesc_t *);
+	int (*fsp_syncrange)(fb_fdesc_t *, off64_t, off64_t, int);
+	int (*fsp_syncfs)(fb_fdesc_t *);
 } fsplug_func_t;
 
 extern fsplug_func_t *fs_functions_vec;
@@ -137,10 +167,34 @@ extern fsplug_func_t *fs_functions_vec;
 #define	FB_FTRUNC(fdesc, size) \
 	(*fs_functions_vec->fsp_ftrunc)(fdesc, size)
 
+#define	FB_RENAME(old, new) \
+	(*fs_functions_vec->fsp_rename)(old, new)
+
 #define	FB_LINK(existing, new) \
 	(*fs_functions_vec->fsp_link)(existing, new)
 
 #define	FB_SYMLINK(name1, name2) \
 	(*fs_functions_vec->fsp_symlink)(name1, name2)
 
+#define	FB_FALLOCATE(fdesc, mode, offset, len) \
+	(*fs_functions_vec->fsp_fallocate)(fdesc, mode, offset, len)
+
+#define	FB_CACHECTL(fdesc, op, offset, len) \
+	(*fs_functions_vec->fsp_cachectl)(fdesc, op, offset, len)
+
+#define	FB_PREADV2(fdesc, iov, iovcnt, offset, flags) \
+	(*fs_functions_vec->fsp_preadv2)(fdesc, iov, iovcnt, offset, flags)
+
+#define	FB_PWRITEV2(fdesc, iov, iovcnt, offset, flags) \
+	(*fs_functions_vec->fsp_pwritev2)(fdesc, iov, iovcnt, offset, flags)
+
+#define	FB_FDATASYNC(fdesc) \
+	(*fs_functions_vec->fsp_fdatasync)(fdesc)
+
+#define	FB_SYNCRANGE(fdesc, offset, len, flags) \
+	(*fs_functions_vec->fsp_syncrange)(fdesc, offset, len, flags)
+
+#define	FB_SYNCFS(fdesc) \
+	(*fs_functions_vec->fsp_syncfs)(fdesc)
+
 #endif /* _FB_FSPLUG_H */
@@ -38,6 +38,7 @@
 #include <sys/shm.h>
 #include "filebench.h"
 #include "fb_cvar.h"
+#include "fb_hugepage.h"
 
 filebench_shm_t *filebench_shm = NULL;
 char shmpath[128] = "/tmp/filebench-shm-XXXXXX";
@@ -349,6 +350,8 @@ void ipc_init(void)
 	    ipc_mutexattr(IPC_MUTEX_NORMAL));
 	(void) pthread_mutex_init(&filebench_shm->shm_ism_lock,
 	    ipc_mutexattr(IPC_MUTEX_NORMAL));
+	(void) pthread_mutex_init(&filebench_shm->shm_semids_lock,
+	    ipc_mutexattr(IPC_MUTEX_NORMAL));
 	(void) ipc_mutex_lock(&filebench_shm->shm_ism_lock);
 	(void) pthread_cond_init(&filebench_shm->shm_eventgen_cv,
 	    ipc_condattr());
@@ -423,9 +426,26 @@ ipc_attach(void *shmaddr, char *shmpath)
 		return (-1);
 	}
 
+	if (filebench_shm->shm_hugepages != FB_HUGEPAGES_NONE)
+		ipc_hugepages();
+
 	return (0);
 }
 
+/*
+ * Asks for this process' mapping of the shared memory region to be
+ * backed by transparent huge pages, once "enable hugepages" is given.
+ * The region is a shared file mapping, so it can't come from the
+ * hugetlb pool, and whether it gets huge pages depends on the file
+ * system holding shmpath.
+ */
+void
+ipc_hugepages(void)
+{
+	(void) fb_hugepage_advise((caddr_t)filebench_shm,
+	    sizeof (filebench_shm_t));
+}
+
 /*
  * Returns the number of preallocated objects in the filebench_shm region
  */
@@ -773,23 +793,28 @@ ipc_cvar_heapfree(void *ptr)
 /*
  * Allocates a semid from the table of semids for pre intialized
  * semaphores. Searches for the first available semaphore, and
- * sets the entry in the table to "1" to indicate allocation.
- * Returns the allocated semid. Stops the run if all semaphores
- * are already in use.
+ * sets the entry in the table to "1" to indicate allocation,
+ * holding shm_semids_lock as the threads of every process allocate
+ * from the same table. Returns the allocated semid. Stops the run if
+ * all semaphores are already in use.
  */
 int
 ipc_semidalloc(void)
 {
 	int semid;
 
-	for (semid = 0; filebench_shm->shm_semids[semid] == 1; semid++)
+	(void) ipc_mutex_lock(&filebench_shm->shm_semids_lock);
+	for (semid = 0; (semid < FILEBENCH_NSEMS) &&
+	    (filebench_shm->shm_semids[semid] == 1); semid++)
 		;
 	if (semid == FILEBENCH_NSEMS) {
+		(void) ipc_mutex_unlock(&filebench_shm->shm_semids_lock);
 		filebench_log(LOG_ERROR,
 		    "Out of semaphores, increase system tunable limit");
 		filebench_shutdown(1);
 	}
 	filebench_shm->shm_semids[semid] = 1;
+	(void) ipc_mutex_unlock(&filebench_shm->shm_semids_lock);
 	return (semid);
 }
 
@@ -800,7 +825,9 @@ ipc_semidalloc(void)
 void
 ipc_semidfree(int semid)
 {
+	(void) ipc_mutex_lock(&filebench_shm->shm_semids_lock);
 	filebench_shm->shm_semids[semid] = 0;
+	(void) ipc_mutex_unlock(&filebench_shm->shm_semids_lock);
 }
 
 /*
@@ -808,6 +835,8 @@ ipc_semidfree(int semid)
  * allocations. Uses shmget() to create a shared memory region
  * of size "size", attaches to it using shmat(), and stores
  * the returned address of the region in filebench_shm->shm_addr.
+ * With "enable hugepages" the region comes from the hugetlb pool or,
+ * failing that, is advised to use transparent huge pages.
  * The pool is only created on the first call. The routine
  * returns 0 if successful or the pool already exists,
  * -1 otherwise.
@@ -820,6 +849,9 @@ ipc_ismcreate(size_t size)
 #else
 	int flag = 0;
 #endif /* HAVE_SHM_SHARE_MMU */
+#ifdef SHM_HUGETLB
+	size_t hsize;
+#endif
 
 	/* Already done? */
 	if (filebench_shm->shm_id != -1)
@@ -828,8 +860,26 @@ ipc_ismcreate(size_t size)
 	filebench_log(LOG_VERBOSE,
 	    "Creating %zd bytes of ISM Shared Memory...", size);
 
-	if ((filebench_shm->shm_id =
-	    shmget(0, size, IPC_CREAT | 0666)) == -1) {
+	filebench_shm->shm_ism_thp =
+	    (filebench_shm->shm_hugepages != FB_HUGEPAGES_NONE);
+
+#ifdef SHM_HUGETLB
+	/* from the hugetlb pool if it has enough pages, else THP below */
+	if (filebench_shm->shm_hugepages == FB_HUGEPAGES_TLB) {
+		hsize = fb_hugepage_size();
+		if ((filebench_shm->shm_id = shmget(0,
+		    (size + hsize - 1) & ~(hsize - 1),
+		    IPC_CREAT | SHM_HUGETLB | 0666)) != -1)
+			filebench_shm->shm_ism_thp = 0;
+		else
+			filebench_log(LOG_INFO, "Could not create ISM "
+			    "shared memory from hugetlb pages (%s)",
+			    strerror(errno));
+	}
+#endif /* SHM_HUGETLB */
+
+	if ((filebench_shm->shm_id == -1) && ((filebench_shm->shm_id =
+	    shmget(0, size, IPC_CREAT | 0666)) == -1)) {
 		filebench_log(LOG_ERROR,
 		    "Failed to create %zd bytes of ISM shared memory (ret = %d)", size, errno);
 		return (-1);
@@ -843,6 +893,9 @@ ipc_ismcreate(size_t size)
 		return (-1);
 	}
 
+	if (filebench_shm->shm_ism_thp)
+		(void) fb_hugepage_advise(filebench_shm->shm_addr, size);
+
 	filebench_shm->shm_ptr = (char *)filebench_shm->shm_addr;
 
 	filebench_log(LOG_VERBOSE,
@@ -885,6 +938,10 @@ ipc_ismattach(void)
 	    flag) == NULL)
 		return (-1);
 
+	if (filebench_shm->shm_ism_thp)
+		(void) fb_hugepage_advise(filebench_shm->shm_addr,
+		    filebench_shm->shm_required);
+
 	ism_attached = 1;
 
 	return (0);
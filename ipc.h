@@ -166,6 +166,8 @@ typedef struct filebench_shm {
 	uint64_t	shm_eventgen_q;    /* count of unclaimed events */
 	pthread_mutex_t	shm_eventgen_lock; /* lock protecting count */
 	pthread_cond_t	shm_eventgen_cv;   /* cv to wait on for more events */
+	int		shm_eventgen_perthread; /* limit flowops pace themselves */
+	int		shm_eventgen_consumers; /* limit flowops sharing the rate */
 
 	/*
 	 * System 5 semaphore state
@@ -173,6 +175,7 @@ typedef struct filebench_shm {
 	key_t		shm_semkey;
 	int		shm_sys_semid;
 	char		shm_semids[FILEBENCH_NSEMS];
+	pthread_mutex_t	shm_semids_lock; /* protects shm_semids */
 
 	/*
 	 * Misc. pointers and state
@@ -190,6 +193,8 @@ typedef struct filebench_shm {
 	hrtime_t	shm_starttime;
 	int		shm_utid;
 	int		lathist_enabled;
+	uint64_t	shm_rand_seed;	/* seeds the threads' generators */
+	uint32_t	shm_content_ids; /* fb_content_seed() ids handed out */
 	int		shm_cvar_heapsize;
 
 	/*
@@ -200,12 +205,16 @@ typedef struct filebench_shm {
 	size_t		shm_allocated;
 	caddr_t		shm_addr;
 	char		*shm_ptr;
+	int		shm_ism_thp;	/* advise THP where the pool is attached */
 
 	/*
 	 * Type of plug-in file system client to use. Defaults to
 	 * local file system, which is type "0".
 	 */
 	fb_plugin_type_t shm_filesys_type;
+	int		shm_uring_iodepth; /* io_uring async queue depth */
+	int		shm_uring_sqpoll; /* io_uring with SQ poll thread */
+	int		shm_hugepages;	/* FB_HUGEPAGES_* from enable hugepages */
 
 	/*
 	 * IPC shared memory pools allocation/deallocation control:
@@ -252,6 +261,7 @@ extern char shmpath[128];
 
 extern void ipc_init(void);
 extern int ipc_attach(void *shmaddr, char *shmpath);
+extern void ipc_hugepages(void);
 
 void *ipc_malloc(int type);
 void ipc_free(int type, char *addr);
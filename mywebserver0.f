@@ -48,36 +48,12 @@ define process name=filereader,instances=1
 {
   thread name=filereaderthread_0,memsize=10m,instances=$nthreads
   {
-    flowop openfile name=openfile1_0,filesetname=bigfileset,fd=1
-    flowop readwholefile name=readfile1_0,fd=1,iosize=$iosize
-    flowop closefile name=closefile1_0,fd=1
-   flowop openfile name=openfile2,filesetname=bigfileset,fd=1
-   flowop readwholefile name=readfile2,fd=1,iosize=$iosize
-   flowop closefile name=closefile2,fd=1
-   flowop openfile name=openfile3,filesetname=bigfileset,fd=1
-   flowop readwholefile name=readfile3,fd=1,iosize=$iosize
-   flowop closefile name=closefile3,fd=1
-   flowop openfile name=openfile4,filesetname=bigfileset,fd=1
-   flowop readwholefile name=readfile4,fd=1,iosize=$iosize
-   flowop closefile name=closefile4,fd=1
-   flowop openfile name=openfile5,filesetname=bigfileset,fd=1
-   flowop readwholefile name=readfile5,fd=1,iosize=$iosize
-   flowop closefile name=closefile5,fd=1
-   flowop openfile name=openfile6,filesetname=bigfileset,fd=1
-   flowop readwholefile name=readfile6,fd=1,iosize=$iosize
-   flowop closefile name=closefile6,fd=1
-   flowop openfile name=openfile7,filesetname=bigfileset,fd=1
-   flowop readwholefile name=readfile7,fd=1,iosize=$iosize
-   flowop closefile name=closefile7,fd=1
-   flowop openfile name=openfile8,filesetname=bigfileset,fd=1
-   flowop readwholefile name=readfile8,fd=1,iosize=$iosize#   
-   flowop closefile name=closefile8,fd=1
-   flowop openfile name=openfile9,filesetname=bigfileset,fd=1
-   flowop readwholefile name=readfile9,fd=1,iosize=$iosize
-    flowop closefile name=closefile9,fd=1
-   flowop openfile name=openfile10,filesetname=bigfileset,fd=1
-   flowop readwholefile name=readfile10,fd=1,iosize=$iosize
-    flowop closefile name=closefile10,fd=1
+    repeat 10
+    {
+      flowop openfile name=openfile1_0,filesetname=bigfileset,fd=1
+      flowop readwholefile name=readfile1_0,fd=1,iosize=$iosize
+      flowop closefile name=closefile1_0,fd=1
+    }
 #flowop appendfilerand name=appendlog,filesetname=logfiles,iosize=$meanappendsize,fd=2
   }
 }
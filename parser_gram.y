@@ -53,6 +53,7 @@
 #include "eventgen.h"
 #include "aslr.h"
 #include "multi_client_sync.h"
+#include "fb_hugepage.h"
 
 /* yacc and lex externals */
 extern FILE *yyin;
@@ -80,6 +81,8 @@ static void parser_flowop_list(cmd_t *);
 /* Define Commands */
 static void parser_proc_define(cmd_t *);
 static void parser_thread_define(cmd_t *, procflow_t *);
+static void parser_repeat_define(cmd_t *, threadflow_t *);
+static void parser_mix_define(cmd_t *, threadflow_t *);
 static void parser_flowop_define(cmd_t *, threadflow_t *, flowop_t **, int);
 static void parser_composite_flowop_define(cmd_t *);
 static void parser_file_define(cmd_t *);
@@ -89,6 +92,7 @@ static void parser_var_assign_custom(char *, cmd_t *);
 
 /* Create Commands */
 static void parser_fileset_create(cmd_t *);
+static void parser_cachectl(cmd_t *);
 
 /* Run Commands */
 static void parser_run(cmd_t *cmd);
@@ -108,6 +112,8 @@ static void parser_sleep(cmd_t *cmd);
 static void parser_sleep_variable(cmd_t *cmd);
 static void parser_version(cmd_t *cmd);
 static void parser_enable_lathist(cmd_t *cmd);
+static void parser_enable_iouring(cmd_t *cmd);
+static void parser_enable_hugepages(cmd_t *cmd);
 
 %}
 
@@ -126,16 +132,16 @@ static void parser_enable_lathist(cmd_t *cmd);
 
 %token FSC_LIST FSC_DEFINE FSC_QUIT FSC_DEBUG FSC_CREATE FSC_SLEEP FSC_SET
 %token FSC_SYSTEM FSC_EVENTGEN FSC_ECHO FSC_RUN FSC_PSRUN FSC_VERSION FSC_ENABLE
-%token FSC_DOMULTISYNC
+%token FSC_DOMULTISYNC FSC_CACHECTL
 
 %token FSV_STRING FSV_VAL_POSINT FSV_VAL_NEGINT FSV_VAL_BOOLEAN FSV_VARIABLE 
 %token FSV_WHITESTRING FSV_RANDUNI FSV_RANDTAB FSV_URAND FSV_RAND48
 
 %token FSE_FILE FSE_FILES FSE_FILESET FSE_PROC FSE_THREAD FSE_FLOWOP FSE_CVAR
-%token FSE_RAND FSE_MODE FSE_MULTI
+%token FSE_RAND FSE_MODE FSE_MULTI FSE_IOURING FSE_REPEAT FSE_MIX
 
 %token FSK_SEPLST FSK_OPENLST FSK_CLOSELST FSK_OPENPAR FSK_CLOSEPAR FSK_ASSIGN
-%token FSK_IN FSK_QUOTE
+%token FSK_IN FSK_QUOTE FSK_COLON
 
 %token FSA_SIZE FSA_PREALLOC FSA_PARALLOC FSA_PATH FSA_REUSE
 %token FSA_MEMSIZE FSA_RATE FSA_READONLY FSA_TRUSTTREE
@@ -148,6 +154,11 @@ static void parser_enable_lathist(cmd_t *cmd);
 %token FSA_CLIENT FSS_TYPE FSS_SEED FSS_GAMMA FSS_MEAN FSS_MIN FSS_SRC FSS_ROUND
 %token FSA_LVAR_ASSIGN FSA_ALLDONE FSA_FIRSTDONE FSA_TIMEOUT FSA_LATHIST
 %token FSA_NOREADAHEAD FSA_IOPRIO FSA_WRITEONLY FSA_PARAMETERS FSA_NOUSESTATS
+%token FSA_PREALLOCMODE FSA_MKDIRNODE FSA_COMPRESSRATIO FSA_DEDUPERATIO
+%token FSA_ADVICE FSA_IODEPTH FSA_SQPOLL FSA_POPULATE FSA_MAPSYNC
+%token FSA_STOREMODE FSA_IOVCNT FSA_RWFLAGS FSA_SAMEDIR FSA_BUFSIZE
+%token FSA_WITHSTAT FSA_OFFSET FSA_SYNCFLAGS FSA_ALIGN FSA_HUGEPAGES
+%token FSA_WEIGHT FSA_PERTHREAD
 
 %type <ival> FSV_VAL_POSINT FSV_VAL_NEGINT
 %type <bval> FSV_VAL_BOOLEAN
@@ -161,10 +172,12 @@ static void parser_enable_lathist(cmd_t *cmd);
 
 %type <cmd> command run_command list_command psrun_command
 %type <cmd> proc_define_command files_define_command
-%type <cmd> flowop_define_command debug_command create_command
+%type <cmd> flowop_define_command debug_command create_command cachectl_command
 %type <cmd> sleep_command set_command
 %type <cmd> system_command flowop_command
 %type <cmd> eventgen_command quit_command flowop_list thread_list
+%type <cmd> thread_flowop_list thread_flowop repeat_command
+%type <cmd> mix_command mix_branch_list mix_branch
 %type <cmd> thread echo_command
 %type <cmd> version_command enable_command multisync_command
 %type <cmd> set_variable set_random_variable set_custom_variable set_mode
@@ -175,6 +188,7 @@ static void parser_enable_lathist(cmd_t *cmd);
 %type <attr> randvar_attr_srcop attr_value
 %type <attr> comp_lvar_def comp_attr_op comp_attr_ops
 %type <attr> enable_multi_ops enable_multi_op multisync_op
+%type <attr> enable_iouring_ops enable_iouring_op
 %type <attr> cvar_attr_ops cvar_attr_op
 %type <list> whitevar_string whitevar_string_list
 %type <ival> attrs_define_thread attrs_flowop
@@ -208,6 +222,7 @@ command:
 | debug_command
 | eventgen_command
 | create_command
+| cachectl_command
 | echo_command
 | list_command
 | run_command
@@ -271,6 +286,37 @@ enable_command: FSC_ENABLE FSE_MULTI enable_multi_ops
 		YYERROR;
 
 	$$->cmd = parser_enable_lathist;
+}
+| FSC_ENABLE FSE_IOURING
+{
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+
+	$$->cmd = parser_enable_iouring;
+}
+| FSC_ENABLE FSE_IOURING enable_iouring_ops
+{
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+
+	$$->cmd = parser_enable_iouring;
+	$$->cmd_attr_list = $3;
+}
+| FSC_ENABLE FSA_HUGEPAGES
+{
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+
+	$$->cmd = parser_enable_hugepages;
+}
+| FSC_ENABLE FSA_HUGEPAGES FSK_ASSIGN attr_value
+{
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+
+	$$->cmd = parser_enable_hugepages;
+	$$->cmd_attr_list = $4;
+	$4->attr_name = FSA_HUGEPAGES;
 };
 
 multisync_command: FSC_DOMULTISYNC multisync_op
@@ -510,6 +556,18 @@ set_mode: FSC_SET FSE_MODE FSC_QUIT FSA_TIMEOUT
 	filebench_log(LOG_INFO, "Disabling CPU usage statistics");
 	filebench_shm->shm_mmode |= FILEBENCH_MODE_NOUSAGE;
 
+	$$->cmd = NULL;
+}
+| FSC_SET FSE_MODE FSA_RANDSEED FSK_ASSIGN FSV_VAL_POSINT
+{
+	$$ = alloc_cmd();
+	if (!$$)
+		YYERROR;
+
+	filebench_log(LOG_INFO, "Random number seed set to %llu",
+	    (u_longlong_t)$5);
+	filebench_shm->shm_rand_seed = $5;
+
 	$$->cmd = NULL;
 };
 
@@ -541,7 +599,84 @@ flowop_list: flowop_command
 	$$ = $1;
 };
 
-thread: FSE_THREAD t_attr_ops FSK_OPENLST flowop_list FSK_CLOSELST
+thread_flowop: flowop_command | repeat_command | mix_command;
+
+thread_flowop_list: thread_flowop
+{
+	$$ = $1;
+}| thread_flowop_list thread_flowop
+{
+	cmd_t *list = NULL;
+	cmd_t *list_end = NULL;
+
+	/* Find end of list */
+	for (list = $1; list != NULL;
+	    list = list->cmd_next)
+		list_end = list;
+
+	list_end->cmd_next = $2;
+
+	filebench_log(LOG_DEBUG_IMPL,
+	    "thread_flowop_list adding cmd %zx to list %zx", $2, $1);
+
+	$$ = $1;
+};
+
+repeat_command: FSE_REPEAT FSV_VAL_POSINT FSK_OPENLST flowop_list FSK_CLOSELST
+{
+	/* A cmd node with the flowops of the block in its cmd_list */
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+	$$->cmd_subtype = FSE_REPEAT;
+	$$->cmd_list = $4;
+	$$->cmd_qty = $2;
+}
+| FSE_REPEAT FSV_VARIABLE FSK_OPENLST flowop_list FSK_CLOSELST
+{
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+	$$->cmd_subtype = FSE_REPEAT;
+	$$->cmd_list = $4;
+	$$->cmd_tgt1 = fb_stralloc($2);
+};
+
+mix_command: FSE_MIX FSK_OPENLST mix_branch_list FSK_CLOSELST
+{
+	/* A cmd node with the branches of the block in its cmd_list */
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+	$$->cmd_subtype = FSE_MIX;
+	$$->cmd_list = $3;
+};
+
+mix_branch_list: mix_branch
+{
+	$$ = $1;
+}| mix_branch_list mix_branch
+{
+	cmd_t *list = NULL;
+	cmd_t *list_end = NULL;
+
+	/* Find end of list */
+	for (list = $1; list != NULL;
+	    list = list->cmd_next)
+		list_end = list;
+
+	list_end->cmd_next = $2;
+
+	$$ = $1;
+};
+
+mix_branch: FSA_WEIGHT FSK_ASSIGN FSV_VAL_POSINT FSK_COLON flowop_list
+{
+	/* A cmd node per branch, with its flowops and weight */
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+	$$->cmd_list = $5;
+	$$->cmd_qty = $3;
+};
+
+thread: FSE_THREAD t_attr_ops FSK_OPENLST thread_flowop_list FSK_CLOSELST
 {
 	/*
 	 * Allocate a cmd node per thread, with a
@@ -610,6 +745,22 @@ create_command: FSC_CREATE FSE_FILES
 	$$->cmd = &parser_fileset_create;
 };
 
+cachectl_command: FSC_CACHECTL FSV_STRING
+{
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+	$$->cmd = &parser_cachectl;
+	$$->cmd_tgt1 = $2;
+}
+| FSC_CACHECTL FSV_STRING FSV_STRING
+{
+	if (($$ = alloc_cmd()) == NULL)
+		YYERROR;
+	$$->cmd = &parser_cachectl;
+	$$->cmd_tgt1 = $2;
+	$$->cmd_tgt2 = $3;
+};
+
 sleep_command: FSC_SLEEP FSV_VAL_POSINT
 {
 	if (($$ = alloc_cmd()) == NULL)
@@ -1021,6 +1172,42 @@ enable_multi_op: em_attr_name FSK_ASSIGN attr_value
 	$$->attr_name = $1;
 };
 
+enable_iouring_ops: enable_iouring_op
+{
+	$$ = $1;
+}
+| enable_iouring_ops FSK_SEPLST enable_iouring_op
+{
+	attr_t *attr = NULL;
+	attr_t *list_end = NULL;
+
+	for (attr = $1; attr != NULL;
+	    attr = attr->attr_next)
+		list_end = attr; /* Find end of list */
+
+	list_end->attr_next = $3;
+
+	$$ = $1;
+};
+
+enable_iouring_op: FSA_IODEPTH FSK_ASSIGN attr_value
+{
+	$$ = $3;
+	$$->attr_name = FSA_IODEPTH;
+}
+| FSA_SQPOLL FSK_ASSIGN attr_value
+{
+	$$ = $3;
+	$$->attr_name = FSA_SQPOLL;
+}
+| FSA_SQPOLL
+{
+	if (($$ = alloc_attr()) == NULL)
+		YYERROR;
+	$$->attr_name = FSA_SQPOLL;
+	$$->attr_avd = avd_bool_alloc(TRUE);
+};
+
 multisync_op: FSA_VALUE FSK_ASSIGN attr_value
 {
 	$$ = $3;
@@ -1040,6 +1227,9 @@ attrs_define_file:
 | FSA_PATH { $$ = FSA_PATH;}
 | FSA_SIZE { $$ = FSA_SIZE;}
 | FSA_PREALLOC { $$ = FSA_PREALLOC;}
+| FSA_PREALLOCMODE { $$ = FSA_PREALLOCMODE;}
+| FSA_COMPRESSRATIO { $$ = FSA_COMPRESSRATIO;}
+| FSA_DEDUPERATIO { $$ = FSA_DEDUPERATIO;}
 | FSA_PARALLOC { $$ = FSA_PARALLOC;}
 | FSA_REUSE { $$ = FSA_REUSE;}
 | FSA_TRUSTTREE { $$ = FSA_TRUSTTREE;}
@@ -1052,6 +1242,9 @@ attrs_define_fileset:
 | FSA_ENTRIES { $$ = FSA_ENTRIES;}
 | FSA_SIZE { $$ = FSA_SIZE;}
 | FSA_PREALLOC { $$ = FSA_PREALLOC;}
+| FSA_PREALLOCMODE { $$ = FSA_PREALLOCMODE;}
+| FSA_COMPRESSRATIO { $$ = FSA_COMPRESSRATIO;}
+| FSA_DEDUPERATIO { $$ = FSA_DEDUPERATIO;}
 | FSA_PARALLOC { $$ = FSA_PARALLOC;}
 | FSA_REUSE { $$ = FSA_REUSE;}
 | FSA_TRUSTTREE { $$ = FSA_TRUSTTREE;}
@@ -1060,6 +1253,7 @@ attrs_define_fileset:
 | FSA_DIRWIDTH { $$ = FSA_DIRWIDTH;}
 | FSA_DIRDEPTHRV { $$ = FSA_DIRDEPTHRV;}
 | FSA_DIRGAMMA { $$ = FSA_DIRGAMMA;}
+| FSA_MKDIRNODE { $$ = FSA_MKDIRNODE;}
 | FSA_LEAFDIRS { $$ = FSA_LEAFDIRS;};
 
 randvar_attr_name:
@@ -1105,7 +1299,8 @@ attrs_define_thread:
 | FSA_MEMSIZE { $$ = FSA_MEMSIZE;}
 | FSA_USEISM { $$ = FSA_USEISM;}
 | FSA_INSTANCES { $$ = FSA_INSTANCES;}
-| FSA_IOPRIO { $$ = FSA_IOPRIO;};
+| FSA_IOPRIO { $$ = FSA_IOPRIO;}
+| FSA_HUGEPAGES { $$ = FSA_HUGEPAGES;};
 
 attrs_flowop:
   FSA_WSS { $$ = FSA_WSS;}
@@ -1124,10 +1319,25 @@ attrs_flowop:
 | FSA_BLOCKING { $$ = FSA_BLOCKING;}
 | FSA_HIGHWATER { $$ = FSA_HIGHWATER;}
 | FSA_IOSIZE { $$ = FSA_IOSIZE;}
+| FSA_COMPRESSRATIO { $$ = FSA_COMPRESSRATIO;}
+| FSA_DEDUPERATIO { $$ = FSA_DEDUPERATIO;}
+| FSA_ADVICE { $$ = FSA_ADVICE;}
+| FSA_POPULATE { $$ = FSA_POPULATE;}
+| FSA_MAPSYNC { $$ = FSA_MAPSYNC;}
+| FSA_STOREMODE { $$ = FSA_STOREMODE;}
+| FSA_IOVCNT { $$ = FSA_IOVCNT;}
+| FSA_RWFLAGS { $$ = FSA_RWFLAGS;}
+| FSA_SAMEDIR { $$ = FSA_SAMEDIR;}
+| FSA_BUFSIZE { $$ = FSA_BUFSIZE;}
+| FSA_WITHSTAT { $$ = FSA_WITHSTAT;}
+| FSA_OFFSET { $$ = FSA_OFFSET;}
+| FSA_SYNCFLAGS { $$ = FSA_SYNCFLAGS;}
+| FSA_ALIGN { $$ = FSA_ALIGN;}
 | FSA_NOREADAHEAD { $$ = FSA_NOREADAHEAD;};
 
 attrs_eventgen:
-  FSA_RATE { $$ = FSA_RATE;};
+  FSA_RATE { $$ = FSA_RATE;}
+| FSA_PERTHREAD { $$ = FSA_PERTHREAD;};
 
 em_attr_name:
   FSA_MASTER { $$ = FSA_MASTER;}
@@ -1269,6 +1479,12 @@ attr_value: FSV_STRING
 	if (!$$)
 		YYERROR;
 	$$->attr_avd = avd_var_alloc($1);
+} | FSA_RANDOM {
+	/* a keyword, but also a value, as in advice=random */
+	$$ = alloc_attr();
+	if (!$$)
+		YYERROR;
+	$$->attr_avd = avd_str_alloc("random");
 };
 
 var_int_val: FSV_VAL_POSINT
@@ -1589,7 +1805,6 @@ master_mode(struct fbparams *fbparams) {
 				fbparams->fscriptname);
 
 	flowop_init(1);
-	eventgen_init();
 
 	/* Initialize custom variables. */
 	ret = init_cvar_library_info(FBLIBDIR);
@@ -1794,17 +2009,23 @@ parser_list2avd(list_t *list)
 
 /*
  * Sets the event generator rate from the attribute supplied with the
- * command. If the attribute doesn't exist the routine does nothing.
+ * command, sharing it out among the limit flowops in per-thread mode if
+ * the perthread attribute is set. If the rate attribute doesn't exist
+ * the routine does nothing.
  */
 static void
 parser_eventgen(cmd_t *cmd)
 {
 	attr_t *attr;
+	boolean_t perthread = FALSE;
+
+	if ((attr = get_attr(cmd, FSA_PERTHREAD)))
+		perthread = avd_get_bool(attr->attr_avd);
 
 	/* Get the rate from attribute */
 	if ((attr = get_attr(cmd, FSA_RATE))) {
 		if (attr->attr_avd) {
-			eventgen_setrate(attr->attr_avd);
+			eventgen_setrate(attr->attr_avd, perthread);
 		}
 	}
 }
@@ -1894,7 +2115,8 @@ parser_proc_define(cmd_t *cmd)
  * (threads) with the supplied name. The default number of instances is
  * one. Two other optional attributes may be supplied, one to set the memory
  * size, stored in tf_memsize, and to select the use of Interprocess Shared
- * Memory, which sets the THREADFLOW_USEISM flag in tf_attrs. Finally
+ * Memory, which sets the THREADFLOW_USEISM flag in tf_attrs. The hugepages
+ * attribute, stored in tf_hugepages, overrides "enable hugepages". Finally
  * the routine loops through the list of inner commands, if any, which are
  * defines for flowops, and passes them one at a time to
  * parser_flowop_define() to allocate flowop entities for the threadflows.
@@ -1950,11 +2172,124 @@ parser_thread_define(cmd_t *cmd, procflow_t *procflow)
 	if (attr)
 		threadflow->tf_attrs |= THREADFLOW_USEISM;
 
+	threadflow->tf_hugepages = FB_HUGEPAGES_DEFAULT;
+	attr = get_attr(cmd, FSA_HUGEPAGES);
+	if (attr && ((threadflow->tf_hugepages =
+	    fb_hugepage_mode(attr->attr_avd)) < 0)) {
+		filebench_log(LOG_ERROR, "thread %s: hugepages must be "
+		    "true, false, hugetlb or thp", name);
+		filebench_shutdown(1);
+	}
+
 	/* create the list of flowops */
 	for (inner_cmd = cmd->cmd_list; inner_cmd;
-	    inner_cmd = inner_cmd->cmd_next)
+	    inner_cmd = inner_cmd->cmd_next) {
+		if (inner_cmd->cmd_subtype == FSE_REPEAT)
+			parser_repeat_define(inner_cmd, threadflow);
+		else if (inner_cmd->cmd_subtype == FSE_MIX)
+			parser_mix_define(inner_cmd, threadflow);
+		else
+			parser_flowop_define(inner_cmd, threadflow,
+			    &threadflow->tf_thrd_fops, FLOW_MASTER);
+	}
+}
+
+/*
+ * Defines the flowops of a "repeat N { ... }" block of a thread. They are
+ * defined once, like any other flowops of the thread, and the first of them
+ * records the repeat count and the number of flowops in the block, for
+ * flowop_start() to run the block N times in a row, looping over a single
+ * copy of its steps. N may be a variable, as in "repeat $n { ... }", whose
+ * value is taken once, when the thread is defined. All runs of the block
+ * share the same flowops, and so the same stats.
+ */
+static void
+parser_repeat_define(cmd_t *cmd, threadflow_t *threadflow)
+{
+	flowop_t *first, *last;
+	cmd_t *inner_cmd;
+	uint64_t qty = cmd->cmd_qty;
+	avd_t var;
+	int count = 0;
+
+	if (cmd->cmd_tgt1) {
+		if ((var = avd_var_alloc(cmd->cmd_tgt1)) == NULL) {
+			filebench_log(LOG_ERROR, "thread %s: unknown repeat "
+			    "count variable %s", threadflow->tf_name,
+			    cmd->cmd_tgt1);
+			filebench_shutdown(1);
+		}
+		qty = avd_get_int(var);
+	}
+
+	if ((qty == 0) || (qty > INT_MAX)) {
+		filebench_log(LOG_ERROR, "thread %s: repeat count must be "
+		    "between 1 and %d", threadflow->tf_name, INT_MAX);
+		filebench_shutdown(1);
+	}
+
+	/* The block goes after the current end of the list */
+	for (last = threadflow->tf_thrd_fops; last && last->fo_exec_next;
+	    last = last->fo_exec_next)
+		;
+
+	for (inner_cmd = cmd->cmd_list; inner_cmd;
+	    inner_cmd = inner_cmd->cmd_next) {
 		parser_flowop_define(inner_cmd, threadflow,
 		    &threadflow->tf_thrd_fops, FLOW_MASTER);
+		count++;
+	}
+
+	first = last ? last->fo_exec_next : threadflow->tf_thrd_fops;
+	first->fo_repeat = (int)qty;
+	first->fo_repeatlen = count;
+}
+
+/*
+ * Defines the flowops of a "mix { weight=W: ... }" block of a thread,
+ * branch by branch. The first flowop of each branch records its weight
+ * and its number of flowops, and the first flowop of the block the
+ * number of branches, for flowop_start() to pick one branch per pass
+ * through the block with probability proportional to its weight. Each
+ * branch has its own flowops, and so its own stats.
+ */
+static void
+parser_mix_define(cmd_t *cmd, threadflow_t *threadflow)
+{
+	flowop_t *first, *last, *mixfirst = NULL;
+	cmd_t *branch, *inner_cmd;
+	int count, nbranches = 0;
+
+	for (branch = cmd->cmd_list; branch; branch = branch->cmd_next) {
+		if ((branch->cmd_qty == 0) || (branch->cmd_qty > INT_MAX)) {
+			filebench_log(LOG_ERROR, "thread %s: mix weight must "
+			    "be between 1 and %d", threadflow->tf_name,
+			    INT_MAX);
+			filebench_shutdown(1);
+		}
+
+		/* The branch goes after the current end of the list */
+		for (last = threadflow->tf_thrd_fops;
+		    last && last->fo_exec_next; last = last->fo_exec_next)
+			;
+
+		count = 0;
+		for (inner_cmd = branch->cmd_list; inner_cmd;
+		    inner_cmd = inner_cmd->cmd_next) {
+			parser_flowop_define(inner_cmd, threadflow,
+			    &threadflow->tf_thrd_fops, FLOW_MASTER);
+			count++;
+		}
+
+		first = last ? last->fo_exec_next : threadflow->tf_thrd_fops;
+		first->fo_weight = (int)branch->cmd_qty;
+		first->fo_branchlen = count;
+		if (mixfirst == NULL)
+			mixfirst = first;
+		nbranches++;
+	}
+
+	mixfirst->fo_mixbranches = nbranches;
 }
 
 /*
@@ -2068,6 +2403,83 @@ parser_flowop_get_attrs(cmd_t *cmd, flowop_t *flowop)
 	else
 		flowop->fo_noreadahead = avd_bool_alloc(FALSE);
 
+	/* Generated write content */
+	if ((attr = get_attr(cmd, FSA_COMPRESSRATIO)))
+		flowop->fo_compress = attr->attr_avd;
+	else
+		flowop->fo_compress = NULL;
+
+	if ((attr = get_attr(cmd, FSA_DEDUPERATIO)))
+		flowop->fo_dedupe = attr->attr_avd;
+	else
+		flowop->fo_dedupe = NULL;
+
+	/* Page cache advice */
+	if ((attr = get_attr(cmd, FSA_ADVICE)))
+		flowop->fo_advice = attr->attr_avd;
+	else
+		flowop->fo_advice = NULL;
+
+	/* Memory mapped I/O */
+	if ((attr = get_attr(cmd, FSA_POPULATE)))
+		flowop->fo_populate = attr->attr_avd;
+	else
+		flowop->fo_populate = avd_bool_alloc(FALSE);
+
+	if ((attr = get_attr(cmd, FSA_MAPSYNC)))
+		flowop->fo_mapsync = attr->attr_avd;
+	else
+		flowop->fo_mapsync = avd_bool_alloc(FALSE);
+
+	if ((attr = get_attr(cmd, FSA_STOREMODE)))
+		flowop->fo_storemode = attr->attr_avd;
+	else
+		flowop->fo_storemode = NULL;
+
+	/* Vectored I/O */
+	if ((attr = get_attr(cmd, FSA_IOVCNT)))
+		flowop->fo_iovcnt = attr->attr_avd;
+	else
+		flowop->fo_iovcnt = NULL;
+
+	if ((attr = get_attr(cmd, FSA_RWFLAGS)))
+		flowop->fo_rwflags = attr->attr_avd;
+	else
+		flowop->fo_rwflags = NULL;
+
+	/* Metadata operations */
+	if ((attr = get_attr(cmd, FSA_SAMEDIR)))
+		flowop->fo_samedir = attr->attr_avd;
+	else
+		flowop->fo_samedir = avd_bool_alloc(FALSE);
+
+	/* Directory listing */
+	if ((attr = get_attr(cmd, FSA_BUFSIZE)))
+		flowop->fo_bufsize = attr->attr_avd;
+	else
+		flowop->fo_bufsize = NULL;
+
+	if ((attr = get_attr(cmd, FSA_WITHSTAT)))
+		flowop->fo_withstat = attr->attr_avd;
+	else
+		flowop->fo_withstat = avd_bool_alloc(FALSE);
+
+	/* Sync range */
+	if ((attr = get_attr(cmd, FSA_OFFSET)))
+		flowop->fo_offset = attr->attr_avd;
+	else
+		flowop->fo_offset = NULL;
+
+	if ((attr = get_attr(cmd, FSA_SYNCFLAGS)))
+		flowop->fo_syncflags = attr->attr_avd;
+	else
+		flowop->fo_syncflags = NULL;
+
+	/* I/O buffer alignment */
+	if ((attr = get_attr(cmd, FSA_ALIGN)))
+		flowop->fo_align = attr->attr_avd;
+	else
+		flowop->fo_align = NULL;
 
 }
 
@@ -2355,6 +2767,24 @@ parser_fileset_define_common(cmd_t *cmd)
 	else
 		fileset->fs_preallocpercent = avd_int_alloc(0);
 
+	attr = get_attr(cmd, FSA_PREALLOCMODE);
+	if (attr)
+		fileset->fs_preallocmode = attr->attr_avd;
+	else
+		fileset->fs_preallocmode = avd_str_alloc("write");
+
+	attr = get_attr(cmd, FSA_COMPRESSRATIO);
+	if (attr)
+		fileset->fs_compress = attr->attr_avd;
+	else
+		fileset->fs_compress = NULL;
+
+	attr = get_attr(cmd, FSA_DEDUPERATIO);
+	if (attr)
+		fileset->fs_dedupe = attr->attr_avd;
+	else
+		fileset->fs_dedupe = NULL;
+
 	attr = get_attr(cmd, FSA_PARALLOC);
 	if (attr)
 		fileset->fs_paralloc = attr->attr_avd;
@@ -2460,6 +2890,12 @@ parser_fileset_define(cmd_t *cmd)
 		fileset->fs_dirgamma = attr->attr_avd;
 	else
 		fileset->fs_dirgamma = avd_int_alloc(1500);
+
+	attr = get_attr(cmd, FSA_MKDIRNODE);
+	if (attr)
+		fileset->fs_mkdirnode = attr->attr_avd;
+	else
+		fileset->fs_mkdirnode = NULL;
 }
 
 /*
@@ -2479,6 +2915,53 @@ parser_fileset_create(cmd_t *cmd)
 	}
 }
 
+/*
+ * Evicts the files of one or all filesets from the page cache, or
+ * prewarms them, for "cachectl evict|prewarm [fileset]". The filesets
+ * are created first if that has not happened yet, so the command can be
+ * used right before "run". If errors are encountered, calls
+ * filebench_shutdown() to exit Filebench.
+ */
+static void
+parser_cachectl(cmd_t *cmd)
+{
+	fileset_t *fileset;
+	int op;
+
+	if (!strcmp(cmd->cmd_tgt1, "evict")) {
+		op = FILESET_CACHE_EVICT;
+	} else if (!strcmp(cmd->cmd_tgt1, "prewarm")) {
+		op = FILESET_CACHE_PREWARM;
+	} else {
+		filebench_log(LOG_ERROR,
+		    "cachectl: unknown operation %s, use evict or prewarm",
+		    cmd->cmd_tgt1);
+		filebench_shutdown(1);
+		return;
+	}
+
+	parser_fileset_create(cmd);
+
+	if (cmd->cmd_tgt2) {
+		if ((fileset = fileset_find(cmd->cmd_tgt2)) == NULL) {
+			filebench_log(LOG_ERROR,
+			    "cachectl: unknown fileset %s", cmd->cmd_tgt2);
+			filebench_shutdown(1);
+			return;
+		}
+
+		if (fileset_cachectl(fileset, op) != FILEBENCH_OK)
+			filebench_shutdown(1);
+		return;
+	}
+
+	for (fileset = filebench_shm->shm_filesetlist; fileset;
+	    fileset = fileset->fs_next) {
+		if (fileset_cachectl(fileset, op) != FILEBENCH_OK)
+			filebench_shutdown(1);
+	}
+}
+
 /*
  * Ends filebench run after first destoring any interprocess
  * shared memory. The call to filebench_shutdown()
@@ -2840,6 +3323,77 @@ parser_enable_lathist(cmd_t *cmd)
 	filebench_log(LOG_INFO, "Latency histogram enabled");
 }
 
+/*
+ * Switches to the io_uring file system plug-in, with a per-thread queue
+ * depth of "iodepth" (default 32) and optionally with SQ polling. Must
+ * come before the filesets are created to be used for their creation.
+ */
+static void
+parser_enable_iouring(cmd_t *cmd)
+{
+	attr_t *attr;
+	int iodepth = 32;
+
+	if ((attr = get_attr(cmd, FSA_IODEPTH)))
+		iodepth = (int)avd_get_int(attr->attr_avd);
+
+	if (iodepth < 1) {
+		filebench_log(LOG_ERROR, "enable io_uring: iodepth must be "
+		    "at least 1");
+		filebench_shutdown(1);
+	}
+
+	filebench_shm->shm_uring_iodepth = iodepth;
+	if ((attr = get_attr(cmd, FSA_SQPOLL)))
+		filebench_shm->shm_uring_sqpoll =
+		    avd_get_bool(attr->attr_avd);
+
+	if (filebench_shm->shm_filesys_type == IO_URING_PLUG)
+		return;
+
+	if (fb_uring_funcvecinit() != FILEBENCH_OK) {
+		filebench_log(LOG_ERROR,
+		    "io_uring is not supported by this build of filebench");
+		filebench_shutdown(1);
+	}
+
+	filebench_shm->shm_filesys_type = IO_URING_PLUG;
+	fb_uring_newflowops();
+
+	filebench_log(LOG_INFO, "io_uring enabled, iodepth %d%s", iodepth,
+	    filebench_shm->shm_uring_sqpoll ? ", SQ polling" : "");
+}
+
+/*
+ * Backs the memory of all threads without a hugepages attribute, and the
+ * shared memory pools, with huge pages: from the hugetlb pool, falling
+ * back to transparent huge pages, or with "= thp" transparent huge pages
+ * only. Must come before the threads are started to apply to them.
+ */
+static void
+parser_enable_hugepages(cmd_t *cmd)
+{
+	attr_t *attr;
+	int mode = FB_HUGEPAGES_TLB;
+
+	if ((attr = get_attr(cmd, FSA_HUGEPAGES)) &&
+	    ((mode = fb_hugepage_mode(attr->attr_avd)) < 0)) {
+		filebench_log(LOG_ERROR, "enable hugepages: mode must be "
+		    "true, false, hugetlb or thp");
+		filebench_shutdown(1);
+	}
+
+	filebench_shm->shm_hugepages = mode;
+	if (mode == FB_HUGEPAGES_NONE)
+		return;
+
+	ipc_hugepages();
+
+	filebench_log(LOG_INFO, "Huge pages enabled, %s",
+	    (mode == FB_HUGEPAGES_THP) ? "transparent" :
+	    "hugetlb with transparent fallback");
+}
+
 /*
  * define a random variable and initialize the distribution parameters
  */
@@ -793,6 +793,7 @@ proc_create()
 {
 	filebench_shm->shm_1st_err = 0;
 	filebench_shm->shm_f_abort = FILEBENCH_OK;
+	filebench_shm->shm_eventgen_consumers = 0;
 
 	(void) pthread_rwlock_rdlock(&filebench_shm->shm_run_lock);
 
@@ -59,6 +59,10 @@ stats_add(struct flowstats *a, struct flowstats *b)
 	a->fs_rbytes += b->fs_rbytes;
 	a->fs_wbytes += b->fs_wbytes;
 	a->fs_total_lat += b->fs_total_lat;
+	a->fs_minflt += b->fs_minflt;
+	a->fs_majflt += b->fs_majflt;
+	a->fs_flush_lat += b->fs_flush_lat;
+	a->fs_stat_lat += b->fs_stat_lat;
 
 	if (b->fs_maxlat > a->fs_maxlat)
 		a->fs_maxlat = b->fs_maxlat;
@@ -201,6 +205,30 @@ stats_snap(void)
 			flowop->fo_stats.fs_maxlat / SEC2MS_FLOAT);
 		(void) strcat(str, line);
 
+		if (flowop->fo_stats.fs_minflt || flowop->fo_stats.fs_majflt) {
+			(void) snprintf(line, sizeof(line),
+			    " %llu/%llu min/maj faults",
+			    (u_longlong_t)flowop->fo_stats.fs_minflt,
+			    (u_longlong_t)flowop->fo_stats.fs_majflt);
+			(void) strcat(str, line);
+		}
+
+		if (flowop->fo_stats.fs_flush_lat) {
+			(void) snprintf(line, sizeof(line),
+			    " %.3fms/op flush",
+			    flowop->fo_stats.fs_flush_lat /
+			    (flowop->fo_stats.fs_count * SEC2MS_FLOAT));
+			(void) strcat(str, line);
+		}
+
+		if (flowop->fo_stats.fs_stat_lat) {
+			(void) snprintf(line, sizeof(line),
+			    " %.3fms/op stat",
+			    flowop->fo_stats.fs_stat_lat /
+			    (flowop->fo_stats.fs_count * SEC2MS_FLOAT));
+			(void) strcat(str, line);
+		}
+
 		if (filebench_shm->lathist_enabled) {
 			(void) sprintf(histogram, "\t[ ");
 			for (i = 0; i < OSPROF_BUCKET_NUMBER; i++) {
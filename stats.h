@@ -49,6 +49,10 @@ struct flowstats {
 	hrtime_t	fs_total_lat;
 	unsigned long long fs_maxlat;	/* max flowop latency (nanoseconds) */
 	unsigned long long fs_minlat; /* min flowop latency (nanoseconds) */
+	uint64_t	fs_minflt;	/* Minor page faults, mmap flowops */
+	uint64_t	fs_majflt;	/* Major page faults, mmap flowops */
+	hrtime_t	fs_flush_lat;	/* Time spent flushing, pmemstore */
+	hrtime_t	fs_stat_lat;	/* Time spent in stats, listdir */
 
 	/* These two fields are used only in globalstats variable
 	 * to note the total time of statistics collection: from
@@ -27,20 +27,41 @@
 #define	_FB_THREADFLOW_H
 
 #include "filebench.h"
+#include "fb_random.h"
 
 #define	AL_READ  1
 #define	AL_WRITE 2
+#define	AL_URING 4	/* submitted through io_uring, not posix aio */
 
-#ifdef HAVE_AIO
+/*
+ * An asynchronous I/O request. Each thread preallocates a ring of
+ * THREADFLOW_MAXAIO of these on first use, and keeps the free ones on
+ * a list and the ones in flight in its tf_aiopending array.
+ */
 typedef struct aiolist {
-	int		al_type;
-	struct aiolist	*al_next;
-	struct aiolist	*al_worknext;
+	int		al_type;	/* AL_READ or AL_WRITE, maybe AL_URING */
+	int		al_index;	/* Slot in tf_aiopending */
+	struct aiolist	*al_next;	/* Next free request */
+	struct flowop	*al_flowop;	/* Flowop that submitted it */
+	hrtime_t	al_stime;	/* Submit time, for its latency */
+#ifdef HAVE_AIO
 	struct aiocb64	 al_aiocb;
-} aiolist_t;
 #endif
+} aiolist_t;
+
+/*
+ * A mapping of the file open on one of the thread's fds, made by the
+ * first mmap flowop to use the fd and torn down when it is closed.
+ */
+typedef struct tf_mmap {
+	caddr_t		tm_addr;	/* Mapped address, NULL if unmapped */
+	size_t		tm_len;		/* Length of the mapping */
+	int		tm_prot;	/* Protection it was mapped with */
+	size_t		tm_offset;	/* Next sequential offset */
+} tf_mmap_t;
 
 #define	THREADFLOW_MAXFD 128
+#define	THREADFLOW_MAXAIO 4096
 #define	THREADFLOW_USEISM 0x1
 
 typedef struct threadflow {
@@ -50,6 +71,7 @@ typedef struct threadflow {
 	int		tf_running;	/* Thread running indicator */
 	int		tf_abort;	/* Shutdown thread */
 	int		tf_utid;	/* Unique id for thread */
+	fb_rand_t	tf_rand;	/* Random number generator state */
 	struct procflow	*tf_process;	/* Back pointer to process */
 	pthread_t	tf_tid;		/* Thread id */
 	pthread_mutex_t	tf_lock;	/* Mutex around threadflow */
@@ -59,13 +81,29 @@ typedef struct threadflow {
 	caddr_t		tf_mem;		/* Private Memory */
 	avd_t		tf_memsize;	/* Private Memory size attribute */
 	fbint_t		tf_constmemsize; /* constant copy of memory size */
+	int		tf_hugepages;	/* FB_HUGEPAGES_* backing of memory */
 	fb_fdesc_t	tf_fd[THREADFLOW_MAXFD + 1]; /* Thread local fd's */
 	filesetentry_t	*tf_fse[THREADFLOW_MAXFD + 1]; /* Thread local files */
+	tf_mmap_t	tf_map[THREADFLOW_MAXFD + 1]; /* Thread local mappings */
+	int		tf_sinkfd[2];	/* Pipe that sendfile sends to */
+	int		tf_nullfd;	/* /dev/null, which empties the pipe */
+	int		tf_sinksize;	/* Capacity of the pipe */
+	caddr_t		tf_dirbuf;	/* Entries read by listdir */
+	size_t		tf_dirbuflen;	/* Size of tf_dirbuf */
+	char		**tf_dirnames;	/* Entry names listdir stats */
+	int		tf_dirnamemax;	/* Slots in tf_dirnames */
+	caddr_t		tf_iobuf;	/* I/O buffer pool, page aligned */
+	size_t		tf_iobufsize;	/* Size of tf_iobuf */
 	int		tf_fdrotor;	/* Rotating fd within set */
 	struct flowstats	tf_stats;	/* Thread statistics */
+	uint64_t	tf_ioops;	/* I/O flowops run, for opslimit */
 	hrtime_t	tf_stime;	/* Start time of current flowop: used to measure the latency of the flowop */
+	aiolist_t	*tf_aioring;	/* Preallocated async I/O requests */
+	aiolist_t	*tf_aiofree;	/* Free async I/O requests */
+	aiolist_t	**tf_aiopending; /* Async I/Os in flight */
+	int		tf_aiocount;	/* Number of async I/Os in flight */
 #ifdef HAVE_AIO
-	aiolist_t	*tf_aiolist;	/* List of async I/Os */
+	struct aiocb64	**tf_aiocbs;	/* Their aiocbs, for aio_suspend() */
 #endif
 	avd_t		tf_ioprio;	/* ioprio attribute */
 
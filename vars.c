@@ -292,6 +292,28 @@ avd_get_str(avd_t avd)
 	}
 }
 
+/*
+ * Returns FALSE if the avd is a random or custom variable, whose value
+ * changes on every evaluation, and TRUE otherwise. An avd that points to a
+ * variable of yet unknown type is resolved first.
+ */
+boolean_t
+avd_is_const(avd_t avd)
+{
+	assert(avd);
+
+	if (avd->avd_type == AVD_VARVAL_UNKNOWN)
+		set_avd_type_by_var(avd, avd->avd_val.varptr, 1);
+
+	switch (avd->avd_type) {
+	case AVD_VARVAL_RANDOM:
+	case AVD_VARVAL_CUSTOM:
+		return FALSE;
+	default:
+		return TRUE;
+	}
+}
+
 static avd_t
 avd_alloc_cmn(void)
 {
@@ -0,0 +1,39 @@
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+#
+
+set $dir=/tmp
+set $filesize=5g
+set $iosize=8k
+set $nthreads=1
+set $workingset=0
+
+define file name=largefile1,path=$dir,size=$filesize,prealloc,reuse,paralloc
+
+define process name=rand-mmapread,instances=1
+{
+  thread name=rand-thread,memsize=5m,instances=$nthreads
+  {
+    flowop mmapread name=rand-mmapread1,filename=largefile1,iosize=$iosize,random,workingset=$workingset,advice=random
+  }
+}
+
+echo "Random mmap Read Version 1.0 personality successfully loaded"